@@ -23,10 +23,11 @@ void RunBenchmark(LSMTree& db, int num_operations) {
             case 0: // Put
                 db.Put(key, value);
                 break;
-            case 1: // Get
+            case 1: { // Get
                 std::string result;
                 db.Get(key, &result);
                 break;
+            }
             case 2: // Delete
                 db.Delete(key);
                 break;
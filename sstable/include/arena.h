@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace sstable {
+
+/**
+ * @brief Arena is a bump-pointer allocator whose memory is released all at once.
+ * 
+ * Allocations are carved sequentially out of fixed-size blocks, so objects
+ * allocated together sit next to each other in memory. Individual
+ * allocations are never freed; everything goes away with the Arena.
+ * 
+ * Allocate may only be called by one thread at a time, while MemoryUsage can
+ * be read concurrently.
+ */
+class Arena {
+public:
+    Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief Allocate bytes with no alignment guarantee
+     * 
+     * @param bytes Number of bytes (must be positive)
+     * @return char* Pointer to the allocated memory
+     */
+    char* Allocate(size_t bytes);
+
+    /**
+     * @brief Allocate bytes aligned for any pointer-sized or atomic type
+     * 
+     * @param bytes Number of bytes (must be positive)
+     * @return char* Pointer to the allocated memory
+     */
+    char* AllocateAligned(size_t bytes);
+
+    /**
+     * @brief Get the number of bytes handed out so far, including padding
+     * 
+     * @return size_t The memory usage in bytes
+     */
+    size_t MemoryUsage() const { return memory_usage_.load(std::memory_order_relaxed); }
+
+private:
+    char* AllocateFallback(size_t bytes);
+    char* AllocateNewBlock(size_t block_bytes);
+
+    static constexpr size_t kBlockSize = 4096;
+
+    char* alloc_ptr_;
+    size_t alloc_bytes_remaining_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::atomic<size_t> memory_usage_;
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sstable {
+
+/**
+ * @brief BlockCache keeps recently read SSTable data blocks in memory.
+ *
+ * Blocks are keyed by the id of the table they belong to and their offset in
+ * the file. The cache is split into shards, each an independent LRU list
+ * guarded by its own mutex, so concurrent readers rarely contend. Capacity
+ * is divided evenly between the shards and counts the bytes of cached blocks.
+ *
+ * Blocks are handed out as shared pointers, so a block evicted while a reader
+ * is still decoding it stays valid until that reader drops it.
+ */
+class BlockCache {
+public:
+    /**
+     * @brief Construct a new Block Cache
+     *
+     * @param capacity Total bytes of blocks to keep across all shards
+     * @param num_shard_bits The cache is split into 2^num_shard_bits shards
+     */
+    explicit BlockCache(size_t capacity, int num_shard_bits = 4);
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    /**
+     * @brief Allocate an id that is unique for the lifetime of the process
+     *
+     * Every SSTable takes one so that its blocks never collide with those of
+     * another table, even one later written to the same path.
+     *
+     * @return uint64_t The new id
+     */
+    static uint64_t NewId();
+
+    /**
+     * @brief Look up a block, marking it as most recently used
+     *
+     * @param file_id Id of the table that owns the block
+     * @param offset Offset of the block in the table file
+     * @return std::shared_ptr<const std::string> The block, or nullptr on a miss
+     */
+    std::shared_ptr<const std::string> Lookup(uint64_t file_id, uint64_t offset);
+
+    /**
+     * @brief Insert a block, evicting least recently used blocks to make room
+     *
+     * A block larger than a whole shard is not cached.
+     *
+     * @param file_id Id of the table that owns the block
+     * @param offset Offset of the block in the table file
+     * @param block The block contents
+     */
+    void Insert(uint64_t file_id, uint64_t offset, std::shared_ptr<const std::string> block);
+
+    /**
+     * @brief Drop a block, e.g. because its table file was deleted
+     *
+     * @param file_id Id of the table that owns the block
+     * @param offset Offset of the block in the table file
+     */
+    void Erase(uint64_t file_id, uint64_t offset);
+
+    /**
+     * @brief Get the configured capacity in bytes
+     *
+     * @return size_t The capacity
+     */
+    size_t GetCapacity() const { return capacity_; }
+
+    /**
+     * @brief Get the bytes of blocks currently cached
+     *
+     * @return size_t The usage
+     */
+    size_t GetUsage() const;
+
+    /**
+     * @brief Get the number of lookups that found their block
+     *
+     * @return uint64_t The hit count
+     */
+    uint64_t GetHits() const { return hits_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Get the number of lookups that missed
+     *
+     * @return uint64_t The miss count
+     */
+    uint64_t GetMisses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    struct CacheKey {
+        uint64_t file_id;
+        uint64_t offset;
+
+        bool operator==(const CacheKey& other) const {
+            return file_id == other.file_id && offset == other.offset;
+        }
+    };
+
+    struct CacheKeyHash {
+        size_t operator()(const CacheKey& key) const;
+    };
+
+    // One LRU list; the front is the most recently used block
+    struct Shard {
+        using Entry = std::pair<CacheKey, std::shared_ptr<const std::string>>;
+
+        std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<CacheKey, std::list<Entry>::iterator, CacheKeyHash> table;
+        size_t capacity = 0;
+        size_t usage = 0;
+    };
+
+    Shard& GetShard(const CacheKey& key);
+
+    const size_t capacity_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -1,67 +1,107 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
-#include <bitset>
-#include <functional>
 #include <memory>
+#include "filter_policy.h"
 
 namespace sstable {
 
 /**
  * @brief BloomFilter is a space-efficient probabilistic data structure for membership testing.
- * 
+ *
  * It can tell you definitively if an element is not in the set, or if it might be in the set.
  * False positives are possible, but false negatives are not.
+ *
+ * The filter is blocked: bits are grouped into 64-byte blocks, one cache line each, and all
+ * probes for a key land in the same block. A key is hashed once with a 64-bit hash; the upper
+ * half picks the block and the lower half drives double hashing within it, so a lookup costs
+ * one hash and at most one cache miss. Probes are collected into a block-sized mask and
+ * compared a word at a time, which compilers turn into a few vector instructions.
  */
-class BloomFilter {
+class BloomFilter : public Filter {
 public:
     /**
      * @brief Construct a new Bloom Filter
-     * 
-     * @param size Number of bits in the filter
-     * @param num_hashes Number of hash functions to use
+     *
+     * @param size Number of bits in the filter, rounded up to whole blocks
+     * @param num_hashes Number of probes per key
      */
     BloomFilter(size_t size, size_t num_hashes);
 
     /**
      * @brief Add an element to the filter
-     * 
+     *
      * @param key The element to add
      */
     void Add(const std::string& key);
 
+    /**
+     * @brief Add an element given its Hash64
+     *
+     * @param hash Hash64 of the element
+     */
+    void AddHash(uint64_t hash);
+
     /**
      * @brief Check if an element might be in the filter
-     * 
+     *
      * @param key The element to check
      * @return true if the element might be in the filter
      * @return false if the element is definitely not in the filter
      */
-    bool MightContain(const std::string& key) const;
+    bool MightContain(const std::string& key) const override;
 
     /**
      * @brief Serialize the filter to a string
-     * 
+     *
      * @return std::string Serialized filter
      */
     std::string Serialize() const;
 
     /**
      * @brief Deserialize a filter from a string
-     * 
+     *
      * @param data Serialized filter
-     * @return std::unique_ptr<BloomFilter> Deserialized filter
+     * @return std::unique_ptr<BloomFilter> Deserialized filter, or nullptr if data is malformed
      */
     static std::unique_ptr<BloomFilter> Deserialize(const std::string& data);
 
+    /**
+     * @brief Get the number of probes that minimizes false positives
+     *
+     * @param bits_per_key Filter bits spent on each key
+     * @return size_t The number of probes
+     */
+    static size_t OptimalNumHashes(size_t bits_per_key);
+
+    /**
+     * @brief Check a key against a filter serialized by the original unblocked implementation
+     *
+     * SSTable format versions 1 and 2 store that layout; it is only ever read.
+     *
+     * @param data Serialized legacy filter
+     * @param key The element to check
+     * @return true if the element might be in the filter or data is malformed
+     * @return false if the element is definitely not in the filter
+     */
+    static bool LegacyMightContain(const std::string& data, const std::string& key);
+
 private:
-    std::vector<std::bitset<64>> bits_;
-    size_t num_hashes_;
-    std::vector<std::function<size_t(const std::string&)>> hash_functions_;
+    static constexpr size_t kBlockBits = 512;
+    static constexpr size_t kWordsPerBlock = kBlockBits / 64;
 
-    void InitializeHashFunctions();
-    size_t Hash(const std::string& key, size_t seed) const;
+    struct alignas(64) Block {
+        uint64_t words[kWordsPerBlock];
+    };
+
+    // Set the probe bits of hash in mask
+    void ProbeMask(uint64_t hash, uint64_t* mask) const;
+    size_t BlockIndex(uint64_t hash) const;
+
+    std::vector<Block> blocks_;
+    size_t num_hashes_;
 };
 
-} // namespace sstable 
\ No newline at end of file
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace sstable {
+
+/**
+ * @brief Helpers for the little-endian fixed-width and variable-length
+ * encodings used by the on-disk formats (write-ahead log, SSTables).
+ */
+
+inline void PutFixed32(std::string* dst, uint32_t value) {
+    char buf[sizeof(value)];
+    std::memcpy(buf, &value, sizeof(value));
+    dst->append(buf, sizeof(buf));
+}
+
+inline void PutFixed64(std::string* dst, uint64_t value) {
+    char buf[sizeof(value)];
+    std::memcpy(buf, &value, sizeof(value));
+    dst->append(buf, sizeof(buf));
+}
+
+inline uint32_t DecodeFixed32(const char* ptr) {
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+inline uint64_t DecodeFixed64(const char* ptr) {
+    uint64_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+// Varints store 7 bits per byte, low bits first, with the high bit set on
+// every byte but the last
+inline void PutVarint64(std::string* dst, uint64_t value) {
+    char buf[10];
+    size_t size = 0;
+    while (value >= 0x80) {
+        buf[size++] = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    buf[size++] = static_cast<char>(value);
+    dst->append(buf, size);
+}
+
+// Decode a varint from [ptr, limit); returns the byte after it, or nullptr
+// if the input is truncated or malformed
+inline const char* GetVarint64(const char* ptr, const char* limit, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift <= 63 && ptr < limit; shift += 7) {
+        const uint64_t byte = static_cast<unsigned char>(*ptr++);
+        result |= (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return ptr;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Compute the CRC-32 (IEEE) checksum of a buffer
+ *
+ * @param data Pointer to the data
+ * @param size Number of bytes
+ * @return uint32_t The checksum
+ */
+uint32_t Crc32(const char* data, size_t size);
+
+/**
+ * @brief Compute a 64-bit hash of a buffer (MurmurHash64A)
+ *
+ * The result is stored inside filter blocks, so it must never change.
+ *
+ * @param data Pointer to the data
+ * @param size Number of bytes
+ * @param seed Seed mixed into the hash
+ * @return uint64_t The hash
+ */
+uint64_t Hash64(const char* data, size_t size, uint64_t seed = 0);
+
+} // namespace sstable
\ No newline at end of file
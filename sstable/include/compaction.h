@@ -3,17 +3,53 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include "range_tombstone.h"
 #include "sstable.h"
+#include "thread_pool.h"
 
 namespace sstable {
 
+/**
+ * @brief Wrap an iterator so that it skips versions nobody can read
+ * 
+ * The newest version of every key is yielded, deletions included, unless a
+ * range tombstone hides it. Any other version is yielded only if a snapshot
+ * reads it, that is, one taken at or after the version but before the next
+ * newer version or range tombstone hiding it.
+ * 
+ * @param input Entries in key order, versions of a key newest first
+ * @param snapshots Sequence numbers of live snapshots, ascending
+ * @param range_tombstones Range tombstones hiding entries of input
+ * @param drop_deletions Whether nothing older than input lies below it, so
+ *        a newest version that is a deletion can be dropped once no
+ *        snapshot older than it is live
+ * @return std::unique_ptr<Iterator> The filtered iterator, which owns input
+ */
+std::unique_ptr<Iterator> NewVersionFilterIterator(std::unique_ptr<Iterator> input,
+                                                   std::vector<uint64_t> snapshots,
+                                                   std::vector<RangeTombstone> range_tombstones = {},
+                                                   bool drop_deletions = false);
+
 /**
  * @brief Compaction manages the process of merging SSTables to maintain efficiency.
  * 
  * Compaction is responsible for:
  * 1. Selecting SSTables to compact
- * 2. Merging SSTables while removing duplicate keys and tombstones
+ * 2. Merging SSTables while removing duplicate keys
  * 3. Creating new SSTables at the appropriate level
+ * 
+ * Inputs are merged as a stream: a heap over one iterator per input table
+ * yields entries in key order, and each surviving entry is appended to the
+ * output through a TableBuilder. Memory use is one data block per input plus
+ * the output's index and filter, independent of the size of the inputs.
+ * 
+ * Of the versions of a key, the one with the highest sequence number is
+ * kept unless a range tombstone of the inputs hides it. An older version is
+ * only kept if one of the snapshots passed in still reads it, so without
+ * snapshots every key is written once. Deletions, point or range, are
+ * carried into the outputs so they keep hiding older entries in other
+ * tables; a bottommost compaction, below which nothing older lies, drops
+ * those no snapshot needs.
  */
 class Compaction {
 public:
@@ -21,19 +57,94 @@ public:
      * @brief Construct a new Compaction object
      * 
      * @param base_path Base directory for SSTable files
+     * @param table_options Layout of the SSTables written by compactions
+     * @param target_file_size Size at which CompactToLevel starts a new output file
+     * @param max_subcompactions Number of key ranges CompactToLevel may merge in parallel
      */
-    explicit Compaction(const std::string& base_path);
+    explicit Compaction(const std::string& base_path,
+                        const TableOptions& table_options = TableOptions(),
+                        size_t target_file_size = kDefaultTargetFileSize,
+                        size_t max_subcompactions = 1);
 
     /**
      * @brief Compact a set of SSTables
      * 
-     * @param input_tables SSTables to compact
+     * When several inputs hold the same key, the version with the highest
+     * sequence number wins; among equal ones, the table latest in input_tables.
+     * 
+     * @param input_tables SSTables to compact, oldest first
      * @param output_level Level for the new SSTable
+     * @param snapshots Sequence numbers of live snapshots, ascending
+     * @param bottommost Whether no other table holds entries older than the
+     *        inputs' in their key range, so deletions can be dropped
      * @return std::unique_ptr<SSTable> The new compacted SSTable
      */
     std::unique_ptr<SSTable> Compact(
         const std::vector<std::unique_ptr<SSTable>>& input_tables,
-        int output_level);
+        int output_level,
+        const std::vector<uint64_t>& snapshots = {},
+        bool bottommost = false);
+
+    /**
+     * @brief Compact a set of SSTables that are shared with concurrent readers
+     * 
+     * Safe to call from several threads at once as long as the calls write
+     * to different output levels.
+     * 
+     * @param input_tables SSTables to compact, oldest first
+     * @param output_level Level for the new SSTable
+     * @param snapshots Sequence numbers of live snapshots, ascending
+     * @param bottommost Whether no other table holds entries older than the
+     *        inputs' in their key range, so deletions can be dropped
+     * @return std::unique_ptr<SSTable> The new compacted SSTable
+     */
+    std::unique_ptr<SSTable> Compact(
+        const std::vector<std::shared_ptr<SSTable>>& input_tables,
+        int output_level,
+        const std::vector<uint64_t>& snapshots = {},
+        bool bottommost = false);
+
+    /**
+     * @brief Merge SSTables into a level, splitting the output by size
+     * 
+     * A new output file is started once the current one reaches the target
+     * file size, so the outputs are sorted and have disjoint key ranges.
+     * When several inputs hold the same key, the version with the highest
+     * sequence number wins; among equal ones, the table latest in input_tables.
+     * 
+     * Inputs of at least two target file sizes are split into up to
+     * max_subcompactions key ranges at data block boundaries. The ranges are
+     * merged in parallel, the calling thread taking the first one, and their
+     * outputs returned together. If any range fails, the outputs of the
+     * others are discarded and the error is rethrown.
+     * 
+     * @param input_tables SSTables to compact, oldest first
+     * @param output_level Level for the new SSTables
+     * @param snapshots Sequence numbers of live snapshots, ascending
+     * @param bottommost Whether no other table holds entries older than the
+     *        inputs' in their key range, so deletions can be dropped
+     * @return std::vector<std::unique_ptr<SSTable>> The new SSTables in key
+     *         order; empty if the inputs hold no entries
+     */
+    std::vector<std::unique_ptr<SSTable>> CompactToLevel(
+        const std::vector<std::shared_ptr<SSTable>>& input_tables,
+        int output_level,
+        const std::vector<uint64_t>& snapshots = {},
+        bool bottommost = false);
+
+    /**
+     * @brief Find the SSTables whose key range overlaps [smallest_key, largest_key]
+     * 
+     * @param tables SSTables to search
+     * @param smallest_key Start of the range (inclusive)
+     * @param largest_key End of the range (inclusive)
+     * @return std::vector<std::shared_ptr<SSTable>> The overlapping SSTables, in
+     *         their order in tables
+     */
+    static std::vector<std::shared_ptr<SSTable>> GetOverlappingTables(
+        const std::vector<std::shared_ptr<SSTable>>& tables,
+        const std::string& smallest_key,
+        const std::string& largest_key);
 
     /**
      * @brief Check if compaction is needed for a set of SSTables
@@ -46,6 +157,17 @@ public:
     bool ShouldCompact(const std::vector<std::unique_ptr<SSTable>>& tables,
                       int level) const;
 
+    /**
+     * @brief Get how urgently a level needs compaction
+     * 
+     * @param tables SSTables in the level
+     * @param level The level to score
+     * @return double Ratio of the level's size to its maximum size;
+     *         values above 1 mean compaction is needed
+     */
+    static double GetCompactionScore(const std::vector<std::shared_ptr<SSTable>>& tables,
+                                     int level);
+
     /**
      * @brief Get the maximum size for SSTables at a given level
      * 
@@ -54,20 +176,39 @@ public:
      */
     static size_t GetMaxSizeForLevel(int level);
 
-private:
-    struct KeyValue {
-        std::string key;
-        std::string value;
-        bool is_tombstone;
-        size_t sequence_number;
-    };
-
-    std::vector<KeyValue> MergeTables(
-        const std::vector<std::unique_ptr<SSTable>>& tables);
-    void RemoveDuplicates(std::vector<KeyValue>* entries);
+    /**
+     * @brief Generate a unique file path for a new SSTable at a given level
+     * 
+     * @param level The level the SSTable will belong to
+     * @return std::string Path inside the level's directory
+     */
     std::string GenerateOutputPath(int level) const;
 
+    static constexpr size_t kDefaultTargetFileSize = 2 * 1024 * 1024; // 2MB
+
+private:
+    // Merges the entries in [*start_key, *end_key); nullptr leaves a side unbounded
+    std::vector<std::unique_ptr<SSTable>> CompactTables(
+        const std::vector<const SSTable*>& input_tables,
+        int output_level,
+        size_t max_file_size,
+        const std::vector<uint64_t>& snapshots,
+        bool bottommost,
+        const std::string* start_key = nullptr,
+        const std::string* end_key = nullptr);
+    std::vector<std::string> PickSubcompactionSplits(
+        const std::vector<const SSTable*>& input_tables) const;
+    std::unique_ptr<SSTable> CompactToSingleTable(
+        const std::vector<const SSTable*>& input_tables,
+        int output_level,
+        const std::vector<uint64_t>& snapshots,
+        bool bottommost);
+
     std::string base_path_;
+    TableOptions table_options_;
+    size_t target_file_size_;
+    size_t max_subcompactions_;
+    std::unique_ptr<ThreadPool> subcompaction_pool_; // nullptr without subcompactions
     static constexpr size_t kBaseLevelSize = 2 * 1024 * 1024; // 2MB
     static constexpr double kLevelSizeMultiplier = 10.0;
 };
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "options.h"
+#include "sstable.h"
+
+namespace sstable {
+
+/**
+ * @brief SSTables of an LSMTree by level: level 0 oldest first, other
+ * levels in key order.
+ */
+using LevelTables = std::map<int, std::vector<std::shared_ptr<SSTable>>>;
+
+/**
+ * @brief A compaction chosen by a CompactionStrategy.
+ */
+struct CompactionJob {
+    int level = 0;          // Level the compaction was picked for
+    int output_level = 0;   // Level the outputs are written to
+    std::vector<std::shared_ptr<SSTable>> inputs; // From level and output_level, oldest first
+    bool split_output = false; // Cut outputs at Options::target_file_size
+};
+
+/**
+ * @brief CompactionStrategy decides which SSTables to merge next.
+ *
+ * A job owns its level and output level until it is installed; a strategy
+ * never picks a job touching a busy level. The outputs of a job replace its
+ * inputs: sorted levels keep them in key order, and level-0 outputs take the
+ * place of the oldest level-0 input, so runs stay ordered by age.
+ *
+ * The tree calls a strategy under its lock, one call at a time, so
+ * strategies may keep state between calls without synchronization.
+ */
+class CompactionStrategy {
+public:
+    virtual ~CompactionStrategy() = default;
+
+    /**
+     * @brief Get the name of the strategy
+     *
+     * @return const char* The name
+     */
+    virtual const char* Name() const = 0;
+
+    /**
+     * @brief Choose the next compaction
+     *
+     * @param levels The current SSTables of the tree
+     * @param busy_levels Levels owned by running jobs
+     * @param job Output parameter for the chosen compaction
+     * @return true if a compaction was chosen
+     * @return false if nothing needs compacting
+     */
+    virtual bool PickCompaction(const LevelTables& levels,
+                                const std::set<int>& busy_levels,
+                                CompactionJob* job) = 0;
+};
+
+/**
+ * @brief Create the leveled strategy
+ *
+ * Levels are scored by size against Compaction::GetMaxSizeForLevel, most
+ * urgent first. All of level 0, or one file of a deeper level chosen
+ * round-robin through the key space, is merged with the overlapping files
+ * of the next level.
+ *
+ * @return std::unique_ptr<CompactionStrategy> The strategy
+ */
+std::unique_ptr<CompactionStrategy> NewLeveledCompactionStrategy();
+
+/**
+ * @brief Create the universal (size-tiered) strategy
+ *
+ * Every SSTable in level 0 is one sorted run. Runs adjacent in age are
+ * merged into a single run that stays in level 0, so each byte is rewritten
+ * roughly once per size tier instead of once per level, at the cost of
+ * probing more runs per read.
+ *
+ * @param options Compaction triggers
+ * @return std::unique_ptr<CompactionStrategy> The strategy
+ */
+std::unique_ptr<CompactionStrategy> NewUniversalCompactionStrategy(
+    const UniversalCompactionOptions& options);
+
+/**
+ * @brief Create the strategy selected by Options::compaction_style
+ *
+ * @param options Tree options
+ * @return std::unique_ptr<CompactionStrategy> The strategy
+ */
+std::unique_ptr<CompactionStrategy> NewCompactionStrategy(const Options& options);
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace sstable {
+
+/**
+ * @brief Compressor encodes and decodes the data blocks of an SSTable.
+ *
+ * Like a FilterPolicy, the name of the compressor is stored in every table
+ * it writes, and blocks are decoded with the compressor of that name, so
+ * names of custom compressors must never change. Implementations must be
+ * safe to call from several threads at once.
+ */
+class Compressor {
+public:
+    virtual ~Compressor() = default;
+
+    /**
+     * @brief Get the name identifying the compressed format
+     *
+     * @return const char* The name
+     */
+    virtual const char* Name() const = 0;
+
+    /**
+     * @brief Compress a block
+     *
+     * @param input The raw block
+     * @param output Replaced with the compressed block
+     * @return true on success
+     * @return false if the input cannot be compressed; it is then stored raw
+     */
+    virtual bool Compress(std::string_view input, std::string* output) const = 0;
+
+    /**
+     * @brief Restore a block written by Compress
+     *
+     * @param input The compressed block
+     * @param output Replaced with the raw block
+     * @return true on success
+     * @return false if input is malformed
+     */
+    virtual bool Uncompress(std::string_view input, std::string* output) const = 0;
+};
+
+/**
+ * @brief Create the built-in LZ77 compressor
+ *
+ * It finds repeats through a single-entry hash table of 4-byte sequences and
+ * encodes them as LZ4-style tokens, favouring speed over ratio. It is always
+ * available.
+ *
+ * @return std::shared_ptr<const Compressor> The compressor
+ */
+std::shared_ptr<const Compressor> NewLZCompressor();
+
+/**
+ * @brief Create a compressor backed by the LZ4 library
+ *
+ * @return std::shared_ptr<const Compressor> The compressor, or nullptr if
+ *         LZ4 was not found when the library was built
+ */
+std::shared_ptr<const Compressor> NewLZ4Compressor();
+
+/**
+ * @brief Create a compressor backed by the zstd library
+ *
+ * Zstd trades speed for a better ratio than the LZ codecs, which suits the
+ * deep levels that hold most of the data and are rarely rewritten.
+ *
+ * @param level Zstd compression level; higher is smaller and slower
+ * @return std::shared_ptr<const Compressor> The compressor, or nullptr if
+ *         zstd was not found when the library was built
+ */
+std::shared_ptr<const Compressor> NewZstdCompressor(int level = 3);
+
+/**
+ * @brief Find a built-in compressor by name
+ *
+ * @param name Name stored in a table
+ * @return const Compressor* The compressor, or nullptr if the name is not
+ *         built in or its library is not available
+ */
+const Compressor* FindBuiltinCompressor(const std::string& name);
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sstable {
+
+/**
+ * @brief A loaded SSTable filter answering approximate membership queries.
+ *
+ * MightContain never returns false for a key the filter was built from; it
+ * may return true for keys that were not, at a rate set by the policy.
+ */
+class Filter {
+public:
+    virtual ~Filter() = default;
+
+    /**
+     * @brief Check if an element might be in the filter
+     *
+     * @param key The element to check
+     * @return true if the element might be in the filter
+     * @return false if the element is definitely not in the filter
+     */
+    virtual bool MightContain(const std::string& key) const = 0;
+};
+
+/**
+ * @brief FilterPolicy builds the filter block of an SSTable and loads it back.
+ *
+ * The name of the policy is stored in every table it writes, so a table is
+ * always read with the policy that built it, whatever the current options
+ * say. Names of custom policies must therefore never change.
+ */
+class FilterPolicy {
+public:
+    virtual ~FilterPolicy() = default;
+
+    /**
+     * @brief Get the name identifying the filter format
+     *
+     * @return const char* The name
+     */
+    virtual const char* Name() const = 0;
+
+    /**
+     * @brief Build a filter over a set of keys
+     *
+     * Keys are passed as their Hash64, so a table builder only holds eight
+     * bytes per key until the filter is written.
+     *
+     * @param key_hashes Hash64 of every key of the table; duplicates are allowed
+     * @return std::string The serialized filter
+     */
+    virtual std::string CreateFilter(const std::vector<uint64_t>& key_hashes) const = 0;
+
+    /**
+     * @brief Load a filter built by CreateFilter
+     *
+     * @param data The serialized filter
+     * @return std::unique_ptr<Filter> The filter, or nullptr if data is malformed
+     */
+    virtual std::unique_ptr<Filter> LoadFilter(const std::string& data) const = 0;
+};
+
+/**
+ * @brief Create a policy writing cache-line-blocked bloom filters
+ *
+ * @param bits_per_key Filter bits spent per key; 10 gives roughly a 1% false positive rate
+ * @return std::shared_ptr<const FilterPolicy> The policy
+ */
+std::shared_ptr<const FilterPolicy> NewBloomFilterPolicy(size_t bits_per_key);
+
+/**
+ * @brief Create a policy writing XOR filters with 8-bit fingerprints
+ *
+ * XOR filters are static: they take about 9.9 bits per key for a 0.4% false
+ * positive rate, roughly 30% less memory than a bloom filter with the same
+ * rate, but cost more to build.
+ *
+ * @return std::shared_ptr<const FilterPolicy> The policy
+ */
+std::shared_ptr<const FilterPolicy> NewXorFilterPolicy();
+
+/**
+ * @brief Find a built-in policy by name
+ *
+ * @param name Name stored in a table
+ * @return const FilterPolicy* The policy, or nullptr if the name is not built in
+ */
+const FilterPolicy* FindBuiltinFilterPolicy(const std::string& name);
+
+} // namespace sstable
\ No newline at end of file
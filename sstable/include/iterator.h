@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+
+namespace sstable {
+
+// Sequence numbers order writes; reading at this one sees every write
+constexpr uint64_t kMaxSequenceNumber = std::numeric_limits<uint64_t>::max();
+
+// Kind of write an entry records. A deletion hides older versions of its
+// key and carries an empty value, so empty values stay ordinary values.
+enum class ValueType : uint8_t {
+    kDeletion = 0,
+    kValue = 1,
+};
+
+/**
+ * @brief Iterator walks the entries of a sorted source in key order.
+ *
+ * A source may hold several versions of a key, one per write, ordered from
+ * the highest sequence number to the lowest.
+ *
+ * Key() and Value() are only valid while the iterator stays on the entry;
+ * any call that moves the iterator may invalidate them. Iterators are not
+ * thread-safe, and the source must outlive them.
+ */
+class Iterator {
+public:
+    virtual ~Iterator() = default;
+
+    /**
+     * @brief Check if the iterator is positioned at an entry
+     *
+     * @return true if Key() and Value() may be called
+     */
+    virtual bool Valid() const = 0;
+
+    /**
+     * @brief Position the iterator at the first entry of the source
+     */
+    virtual void SeekToFirst() = 0;
+
+    /**
+     * @brief Position the iterator at the first entry with a key at or after target
+     *
+     * @param target The key to seek to
+     */
+    virtual void Seek(const std::string& target) = 0;
+
+    /**
+     * @brief Move to the next entry; requires Valid()
+     */
+    virtual void Next() = 0;
+
+    /**
+     * @brief Get the key of the current entry; requires Valid()
+     *
+     * @return std::string_view The key
+     */
+    virtual std::string_view Key() const = 0;
+
+    /**
+     * @brief Get the value of the current entry; requires Valid()
+     *
+     * @return std::string_view The value
+     */
+    virtual std::string_view Value() const = 0;
+
+    /**
+     * @brief Get the sequence number of the current entry; requires Valid()
+     *
+     * @return uint64_t The sequence number of the write that produced the
+     *         entry, or 0 for sources written before sequence numbers existed
+     */
+    virtual uint64_t Sequence() const = 0;
+
+    /**
+     * @brief Get whether the current entry is a value or a deletion; requires Valid()
+     *
+     * @return ValueType The type of the entry
+     */
+    virtual ValueType Type() const = 0;
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -5,19 +5,122 @@
 #include <memory>
 #include <map>
 #include <mutex>
+#include <deque>
+#include <set>
+#include <thread>
+#include <condition_variable>
 #include "memtable.h"
 #include "sstable.h"
 #include "compaction.h"
+#include "compaction_strategy.h"
+#include "options.h"
+#include "wal.h"
+#include "write_batch.h"
+#include "version_edit.h"
+#include "thread_pool.h"
 
 namespace sstable {
 
+/**
+ * @brief Description of one SSTable in the tree
+ */
+struct TableMetadata {
+    std::string path;
+    std::string smallest_key;
+    std::string largest_key;
+    size_t size;
+};
+
+/**
+ * @brief A point-in-time view of an LSMTree
+ *
+ * Reads through a snapshot see every write that completed before it was
+ * taken and none made afterwards. Snapshots are created by
+ * LSMTree::GetSnapshot and must be released with LSMTree::ReleaseSnapshot.
+ */
+class Snapshot {
+public:
+    /**
+     * @brief Get the sequence number of the last write the snapshot sees
+     *
+     * @return uint64_t The sequence number
+     */
+    uint64_t GetSequenceNumber() const { return sequence_; }
+
+private:
+    friend class LSMTree;
+
+    explicit Snapshot(uint64_t sequence) : sequence_(sequence) {}
+    ~Snapshot() = default;
+
+    const uint64_t sequence_;
+};
+
 /**
  * @brief LSMTree implements a Log-Structured Merge Tree storage engine.
  * 
  * The LSM Tree consists of:
  * 1. An in-memory MemTable for recent writes
- * 2. Multiple levels of SSTables on disk
- * 3. A compaction manager to maintain efficiency
+ * 2. A write-ahead log that makes MemTable contents durable
+ * 3. Multiple levels of SSTables on disk
+ * 4. A compaction manager to maintain efficiency
+ *
+ * Every update is a WriteBatch, applied atomically. Concurrent writers are
+ * group-committed: the writer at the head of the queue appends the batches
+ * of every waiting writer to the log as a single record with one write and
+ * sync, applies them to the MemTable in log order, then wakes the others.
+ *
+ * A full MemTable is switched into a bounded queue of immutable MemTables
+ * that a background thread flushes to level-0 SSTables. Reads consult every
+ * queued MemTable, and writers only stall when the queue is full.
+ *
+ * Compactions are chosen by the CompactionStrategy selected with
+ * Options::compaction_style. Level-0 files may overlap; every other level is
+ * a sorted run of files with disjoint key ranges, so a key lives in at most
+ * one file per level. With leveled compaction (the default), a compaction
+ * from level N merges level-N inputs (all of level 0, or one file chosen
+ * round-robin through the key space) with only the level-N+1 files they
+ * overlap, and writes size-bounded outputs back into level N+1. With
+ * universal compaction, every level-0 file is a sorted run, and runs of
+ * similar size are merged into larger runs that stay in level 0. A point
+ * lookup binary-searches each sorted level for its single candidate file,
+ * and only probes level-0 files whose key range covers the key.
+ *
+ * Every write is stamped with a sequence number, one higher than the last,
+ * and stored with it in the MemTable and the SSTables. A key may therefore
+ * have several versions; reads take the newest one at or below the sequence
+ * number they read at. Snapshots pin a sequence number, and flushes and
+ * compactions keep exactly the versions that the latest state or a live
+ * snapshot reads, so long-running readers never block writers.
+ *
+ * Deletions are stored as typed tombstones, so an empty value is an ordinary
+ * value. DeleteRange writes one range tombstone instead of a tombstone per
+ * key. Range tombstones stay in memory with the MemTable or SSTable holding
+ * them and are consulted by every read, whatever the key range of their
+ * source. Compactions drop the entries they hide, and a compaction with
+ * nothing older outside its inputs drops deletions no snapshot needs.
+ *
+ * The set of SSTables is recorded in a MANIFEST file, a log of edits each
+ * flush and compaction appends before publishing its tables. Opening the
+ * tree replays it to restore every table into its level, rather than
+ * listing directories. Write-ahead logs are only deleted once the tables
+ * holding their writes are synced and recorded, and compaction inputs once
+ * their synced outputs are. The directory is synced whenever a table, a
+ * synced log or a rewritten MANIFEST appears in it, so none of them can
+ * vanish in a crash after being relied on.
+ *
+ * Compactions are scheduled on a thread pool by level score. Jobs that touch
+ * disjoint levels run concurrently; each one merges without holding the tree
+ * lock and installs its output atomically. Readers probe a snapshot of the
+ * SSTable list outside the lock, and replaced files are deleted once the
+ * last reader releases them.
+ *
+ * Tables are opened lazily, so a missing or damaged table may only be found
+ * by the first read that needs it. Reads report that the same way as a
+ * corrupt block: Get, MultiGet, GetRange and iterators throw
+ * std::runtime_error instead of skipping the table, which could let older
+ * versions of its keys through. The next read that needs the table tries
+ * to open it again.
  */
 class LSMTree {
 public:
@@ -30,6 +133,30 @@ public:
     explicit LSMTree(const std::string& base_path,
                     size_t memtable_size = 64 * 1024 * 1024); // Default 64MB
 
+    /**
+     * @brief Construct a new LSMTree object with explicit options
+     * 
+     * The SSTables and their levels are restored from the MANIFEST in
+     * base_path without reading the tables, which load on first use unless
+     * Options::table_warmup_threads asks for them up front. Any write-ahead
+     * logs left in base_path are replayed into the MemTable. A directory
+     * written before the MANIFEST existed is scanned for tables once. Tables
+     * on disk that the MANIFEST does not list, left behind by a crash in the
+     * middle of a flush or compaction, are deleted.
+     * 
+     * @param base_path Directory where SSTables and logs will be stored
+     * @param options Tuning and durability options
+     */
+    LSMTree(const std::string& base_path, const Options& options);
+
+    /**
+     * @brief Stop the background flush and compaction threads
+     * 
+     * Running compactions are allowed to finish. MemTables that have not
+     * been flushed yet remain recoverable from their write-ahead logs.
+     */
+    ~LSMTree();
+
     /**
      * @brief Insert a key-value pair
      * 
@@ -44,10 +171,37 @@ public:
      * 
      * @param key The key to look up
      * @param value Output parameter for the value
+     * @param snapshot Snapshot to read at, or nullptr for the latest state
      * @return true if the key was found
      * @return false if the key was not found
+     * @throws std::runtime_error if an SSTable that may hold the key cannot be
+     *         opened or read, or is corrupt; older tables are not searched in
+     *         its place
      */
-    bool Get(const std::string& key, std::string* value);
+    bool Get(const std::string& key, std::string* value,
+             const Snapshot* snapshot = nullptr);
+
+    /**
+     * @brief Get the values associated with many keys
+     * 
+     * Equivalent to calling Get for every key at the same point in time, but
+     * the tree lock is taken once, the MemTables are probed once, and each
+     * SSTable is probed once with every key that may fall in it, in key
+     * order, so keys sharing a data block share its read. With
+     * Options::max_multiget_threads above 1, the tables of a sorted level
+     * are probed in parallel.
+     * 
+     * @param keys The keys to look up, in any order; duplicates are allowed
+     * @param values Output parameter; (*values)[i] is the value of keys[i]
+     *        if it was found, and empty otherwise
+     * @param snapshot Snapshot to read at, or nullptr for the latest state
+     * @return std::vector<bool> Whether each key was found
+     * @throws std::runtime_error if an SSTable that may hold one of the keys
+     *         cannot be opened or read, or is corrupt
+     */
+    std::vector<bool> MultiGet(const std::vector<std::string>& keys,
+                               std::vector<std::string>* values,
+                               const Snapshot* snapshot = nullptr);
 
     /**
      * @brief Delete a key
@@ -57,46 +211,209 @@ public:
      */
     bool Delete(const std::string& key);
 
+    /**
+     * @brief Delete every key in [begin_key, end_key)
+     * 
+     * The range is recorded as a single range tombstone whatever the number
+     * of keys it covers, so the call costs the same as one Delete. Reads
+     * skip the keys it hides from then on, and compactions drop them from
+     * the SSTables they rewrite. Keys written afterwards are not affected.
+     * 
+     * @param begin_key Start of the range (inclusive)
+     * @param end_key End of the range (exclusive); an empty range deletes nothing
+     * @return true if the deletion was successful
+     */
+    bool DeleteRange(const std::string& begin_key, const std::string& end_key);
+
+    /**
+     * @brief Apply a batch of updates atomically
+     * 
+     * The batch goes through the writer queue once, is logged as a single
+     * record, and takes a contiguous range of sequence numbers. Its
+     * operations become visible to readers together, after it has been
+     * applied in full. Put, Delete and DeleteRange are batches of one.
+     * 
+     * If the write-ahead log cannot be written or synced, this write and
+     * every later one fail, since records appended after a torn one would
+     * be lost on recovery; the tree must be reopened.
+     * 
+     * @param batch The updates to apply, in order
+     * @return true if the batch was logged and applied
+     */
+    bool Write(const WriteBatch& batch);
+
     /**
      * @brief Get all key-value pairs in a range
      * 
+     * Only the newest value of each key is returned, and deleted keys are
+     * left out.
+     * 
      * @param start_key Start of the range (inclusive)
      * @param end_key End of the range (inclusive)
+     * @param snapshot Snapshot to read at, or nullptr for the latest state
      * @return std::vector<std::pair<std::string, std::string>> Vector of key-value pairs
+     * @throws std::runtime_error if an SSTable overlapping the range cannot be
+     *         opened or read, or is corrupt; no partial result is returned
      */
     std::vector<std::pair<std::string, std::string>> GetRange(
         const std::string& start_key,
-        const std::string& end_key);
+        const std::string& end_key,
+        const Snapshot* snapshot = nullptr);
+
+    /**
+     * @brief Create an iterator over the whole tree in key order
+     * 
+     * Sources are merged lazily, so positioning the iterator reads at most
+     * one block per level-0 file and per sorted level, and each step only
+     * touches the sources at the current key. Only the newest value of each
+     * key is yielded, and deleted keys are skipped.
+     * 
+     * The iterator reads the MemTables and SSTables that were live when it
+     * was created and keeps them alive until it is destroyed, so flushes and
+     * compactions do not disturb it. It sees the tree as of its creation, or
+     * as of the snapshot if one is given; later writes are never seen.
+     * 
+     * @param snapshot Snapshot to read at, or nullptr for the current state
+     * @return std::unique_ptr<Iterator> An unpositioned iterator; the tree must outlive it
+     * @throws std::runtime_error if a level-0 SSTable cannot be opened. Seeking
+     *         and stepping the iterator throw the same way when a table they
+     *         reach cannot be opened or read, or is corrupt.
+     */
+    std::unique_ptr<Iterator> NewIterator(const Snapshot* snapshot = nullptr);
+
+    /**
+     * @brief Take a snapshot of the current state
+     * 
+     * Reads through the snapshot take no locks beyond those of ordinary
+     * reads. While it is held, compactions keep the versions it reads, so
+     * long-lived snapshots retain space.
+     * 
+     * @return const Snapshot* The snapshot, owned by the tree until released
+     */
+    const Snapshot* GetSnapshot();
+
+    /**
+     * @brief Release a snapshot taken by GetSnapshot
+     * 
+     * @param snapshot The snapshot; it must not be used afterwards
+     */
+    void ReleaseSnapshot(const Snapshot* snapshot);
 
     /**
      * @brief Flush the current MemTable to disk
      * 
-     * This is called automatically when the MemTable is full,
-     * but can also be called manually.
+     * Switches out the current MemTable and blocks until every queued
+     * MemTable has been written by the background flush thread. Flushes
+     * happen automatically when the MemTable is full, but this can also be
+     * called manually.
      */
     void FlushMemTable();
 
     /**
-     * @brief Perform compaction if needed
+     * @brief Schedule compaction of every level that needs it
      * 
-     * This is called automatically after flushing the MemTable,
-     * but can also be called manually.
+     * This is called automatically after flushing the MemTable and after
+     * each compaction, but can also be called manually. Returns without
+     * waiting for the scheduled jobs.
      */
     void MaybeCompact();
 
+    /**
+     * @brief Block until no compaction is running or scheduled
+     */
+    void WaitForCompactions();
+
+    /**
+     * @brief Describe the SSTables of a level
+     * 
+     * @param level The level to describe
+     * @return std::vector<TableMetadata> The tables, oldest first for level 0
+     *         and in key order for other levels
+     */
+    std::vector<TableMetadata> GetLevelMetadata(int level) const;
+
 private:
+    struct Writer;
+
+    // A MemTable waiting to be flushed, with the logs that back it
+    struct ImmutableMemTable {
+        std::shared_ptr<MemTable> memtable;
+        std::vector<std::string> logs;
+    };
+
+    // A null batch asks for the MemTable to be switched out
+    bool WriteImpl(const WriteBatch* batch);
+    bool ApplyBatch(const WriteBatch& batch);
+    bool MakeRoomForWrite(std::unique_lock<std::mutex>* lock,
+                          size_t write_size, bool force);
+    void RecoverLogs();
+    // Start a new log for memtable_; false if its directory entry could not be synced
+    bool NewLog();
     void LoadExistingSSTables();
+    void ReplayManifest(const std::string& manifest_path);
+    void ScanLegacyTables();
+    void WarmUpTables();
+    void RemoveOrphanedTables();
+    void WriteManifestSnapshot();
+    // Append an edit to the MANIFEST; tables are only published once it is durable
+    bool LogEdit(VersionEdit* edit);
+    FileMetaData DescribeTable(const SSTable& table) const;
+    std::string ResolveTablePath(const std::string& path) const;
+    // Iterator over the sources that may hold keys in [*start_key, *end_key];
+    // nullptr leaves a side unbounded
+    std::unique_ptr<Iterator> NewRangeIterator(const std::string* start_key,
+                                               const std::string* end_key,
+                                               const Snapshot* snapshot);
+    std::vector<uint64_t> LiveSnapshots() const;
     void AddSSTable(std::unique_ptr<SSTable> table);
     void RemoveSSTable(const std::string& path);
-    bool CheckMemTableFull();
+    // Index the range tombstones of every table again; mutex_ must be held
+    void RebuildTableTombstones();
+    bool CheckMemTableFull(size_t write_size) const;
     void SwitchMemTable();
+    std::unique_ptr<SSTable> BuildLevel0Table(const MemTable& memtable,
+                                              const std::vector<uint64_t>& snapshots) const;
+    void BackgroundFlush();
+    void MaybeScheduleCompaction();
+    bool IsBottommost(const CompactionJob& job) const;
+    void BackgroundCompaction(CompactionJob job, const std::vector<uint64_t>& snapshots,
+                              bool bottommost);
+    bool InstallCompaction(const CompactionJob& job,
+                           std::vector<std::unique_ptr<SSTable>> outputs);
 
     std::string base_path_;
-    std::unique_ptr<MemTable> memtable_;
-    std::unique_ptr<MemTable> immutable_memtable_;
-    std::map<int, std::vector<std::unique_ptr<SSTable>>> levels_;
+    Options options_;
+    // Shared with iterators that still read it after a switch
+    std::shared_ptr<MemTable> memtable_;
+    std::deque<ImmutableMemTable> immutable_memtables_; // Oldest first
+    std::unique_ptr<WriteAheadLog> wal_;
+    uint64_t next_log_number_;
+    std::vector<std::string> memtable_logs_;   // Logs backing memtable_
+    std::unique_ptr<WriteAheadLog> manifest_;  // Edits to the set of SSTables
+    uint64_t log_number_;                      // Older logs only hold flushed writes
+    uint64_t last_sequence_;                   // Sequence of the last applied write
+    std::multiset<uint64_t> snapshots_;        // Sequences of live snapshots
+    std::deque<Writer*> writers_;
+    // Level 0 oldest first; other levels sorted by key with disjoint ranges
+    LevelTables levels_;
+    // Range tombstones of every table in levels_, replaced whenever they
+    // change so readers can keep using the one they copied; nullptr if none
+    std::shared_ptr<const FragmentedRangeTombstones> table_tombstones_;
     std::unique_ptr<Compaction> compaction_;
+    std::unique_ptr<CompactionStrategy> compaction_strategy_;
     mutable std::mutex mutex_;
+
+    std::thread flush_thread_;
+    std::condition_variable flush_cv_;          // Signals queued MemTables
+    std::condition_variable flush_done_cv_;     // Signals finished flushes
+    bool shutting_down_;
+    bool background_error_;
+
+    std::set<int> compacting_levels_;           // Levels owned by running jobs
+    size_t pending_compactions_;
+    std::condition_variable compaction_done_cv_;
+    std::unique_ptr<ThreadPool> compaction_pool_;
+    std::unique_ptr<ThreadPool> multiget_pool_; // nullptr unless MultiGet runs in parallel
 };
 
 } // namespace sstable 
\ No newline at end of file
@@ -5,6 +5,13 @@
 #include <vector>
 #include <map>
 #include <mutex>
+#include <atomic>
+#include <string_view>
+#include "arena.h"
+#include "prefix_extractor.h"
+#include "iterator.h"
+#include "range_tombstone.h"
+#include "write_batch.h"
 
 namespace sstable {
 
@@ -16,6 +23,24 @@ class SkipList;
  * 
  * The MemTable uses a skip list for efficient insertion and lookup operations. When the MemTable
  * reaches a certain size threshold, it is flushed to disk as an SSTable.
+ * 
+ * Writers are serialized by an internal mutex; reads never take a lock.
+ * Apply inserts a whole WriteBatch under one acquisition of the mutex.
+ * 
+ * Skip list nodes, keys and values are allocated from an Arena owned by the
+ * MemTable and released in one shot when it is destroyed after a flush. The
+ * reported size is the Arena's memory usage, so it includes node overhead.
+ * 
+ * Writes may carry a sequence number. Each sequence number adds a new
+ * version of the key, so readers can look up the key as of an older write;
+ * rewriting a key with the same sequence number replaces that version.
+ * Deletions are versions of type ValueType::kDeletion, so a key can hold an
+ * empty value. Range tombstones are kept in a second skip list in the same
+ * Arena and are not applied by Get or the iterator; the LSMTree combines
+ * them with the entries of every source.
+ * 
+ * With a prefix extractor, the prefix of every written key is also added to a
+ * small bloom filter so that prefix scans can skip the MemTable entirely.
  */
 class MemTable {
 public:
@@ -23,36 +48,99 @@ public:
      * @brief Construct a new MemTable object
      * 
      * @param max_size Maximum size in bytes before the MemTable is flushed
+     * @param prefix_extractor Extractor of the prefixes to track, or nullptr
      */
-    explicit MemTable(size_t max_size = 64 * 1024 * 1024); // Default 64MB
+    explicit MemTable(size_t max_size = 64 * 1024 * 1024, // Default 64MB
+                      std::shared_ptr<const PrefixExtractor> prefix_extractor = nullptr);
+    ~MemTable();
 
     /**
      * @brief Insert a key-value pair into the MemTable
      * 
      * @param key The key to insert
      * @param value The value to insert
+     * @param sequence Sequence number of the write
      * @return true if the insertion was successful
      * @return false if the MemTable is full
      */
-    bool Put(const std::string& key, const std::string& value);
+    bool Put(const std::string& key, const std::string& value, uint64_t sequence = 0);
 
     /**
      * @brief Get the value associated with a key
      * 
      * @param key The key to look up
      * @param value Output parameter for the value
+     * @param sequence Only writes with a sequence number up to this one are
+     *        considered; the newest of them is returned
      * @return true if the key was found
-     * @return false if the key was not found
+     * @return false if the key was not found or its newest version is a deletion
      */
-    bool Get(const std::string& key, std::string* value) const;
+    bool Get(const std::string& key, std::string* value,
+             uint64_t sequence = kMaxSequenceNumber) const;
+
+    /**
+     * @brief Find the newest version of a key, deletions included
+     * 
+     * @param key The key to look up
+     * @param sequence Only writes with a sequence number up to this one are considered
+     * @param value Output parameter for the value, empty for a deletion
+     * @param type Output parameter for the type of the version
+     * @param found_sequence Output parameter for the sequence number of the version
+     * @return true if a version was found
+     * @return false if there is no version of the key at or below sequence
+     */
+    bool Find(const std::string& key, uint64_t sequence, std::string* value,
+              ValueType* type, uint64_t* found_sequence) const;
 
     /**
      * @brief Delete a key from the MemTable
      * 
      * @param key The key to delete
+     * @param sequence Sequence number of the write
      * @return true if the deletion was successful
      */
-    bool Delete(const std::string& key);
+    bool Delete(const std::string& key, uint64_t sequence = 0);
+
+    /**
+     * @brief Delete every key in [begin, end) written before sequence
+     * 
+     * @param begin Start of the range (inclusive)
+     * @param end End of the range (exclusive)
+     * @param sequence Sequence number of the write; it only hides versions
+     *        with a lower one
+     * @return true if the range tombstone was recorded
+     * @return false if the MemTable is full
+     */
+    bool DeleteRange(const std::string& begin, const std::string& end,
+                     uint64_t sequence = 0);
+
+    /**
+     * @brief Apply every operation of a batch under a single lock acquisition
+     * 
+     * @param batch The operations to apply
+     * @param sequence Sequence number of the first operation; the others
+     *        follow in order
+     * @return true if every operation was applied
+     * @return false if the MemTable is full or the batch is malformed
+     */
+    bool Apply(const WriteBatch& batch, uint64_t sequence);
+
+    /**
+     * @brief Get the range tombstones written to the MemTable
+     * 
+     * @return std::vector<RangeTombstone> The tombstones ordered by start key
+     */
+    std::vector<RangeTombstone> GetRangeTombstones() const;
+
+    /**
+     * @brief Find the newest range tombstone covering a key, without copying
+     *        the tombstones out
+     * 
+     * @param key The key to look up
+     * @param sequence Sequence number the reader reads at
+     * @return uint64_t Same as MaxCoveringSequence over GetRangeTombstones()
+     */
+    uint64_t MaxCoveringSequence(std::string_view key, uint64_t sequence) const;
 
     /**
      * @brief Check if the MemTable is full
@@ -61,25 +149,71 @@ public:
      */
     bool IsFull() const;
 
+    /**
+     * @brief Check if the MemTable holds no entries
+     * 
+     * @return true if nothing has been written, range tombstones included
+     */
+    bool IsEmpty() const;
+
     /**
      * @brief Get the current size of the MemTable in bytes
      * 
-     * @return size_t The current size
+     * @return size_t Bytes allocated from the Arena
      */
     size_t GetSize() const;
 
     /**
      * @brief Get all key-value pairs in the MemTable
      * 
+     * Only the newest version of each key is returned, and keys whose newest
+     * version is a deletion are left out, so an empty value is always a
+     * value. Range tombstones are not applied; use NewIterator to see every
+     * version with its type.
+     * 
      * @return std::vector<std::pair<std::string, std::string>> Vector of key-value pairs
      */
     std::vector<std::pair<std::string, std::string>> GetAllEntries() const;
 
+    /**
+     * @brief Create an iterator over the entries in key order
+     * 
+     * Deletions show up as entries of type ValueType::kDeletion, and every
+     * version of a key is visited, newest first. Range tombstones are not
+     * applied. The iterator needs no lock and may run concurrently with writers.
+     * 
+     * @return std::unique_ptr<Iterator> An unpositioned iterator; the MemTable must outlive it
+     */
+    std::unique_ptr<Iterator> NewIterator() const;
+
+    /**
+     * @brief Check if any key with a prefix might have been written
+     * 
+     * @param prefix A prefix produced by the MemTable's prefix extractor
+     * @return true if such a key might exist or no prefixes are tracked
+     * @return false if no key with the prefix was written
+     */
+    bool PrefixMayMatch(std::string_view prefix) const;
+
 private:
+    static constexpr size_t kPrefixBloomWords = 1024; // 64K bits
+
+    bool HasRoomFor(size_t key_size, size_t value_size) const;
+    // Writers below must hold write_mutex_
+    bool AddEntry(const std::string& key, const std::string& value,
+                  uint64_t sequence, ValueType type);
+    bool AddRangeTombstone(const std::string& begin, const std::string& end,
+                           uint64_t sequence);
+    void AddPrefix(const std::string& key);
+
+    Arena arena_; // Must outlive skip_list_
     std::unique_ptr<SkipList> skip_list_;
+    std::unique_ptr<SkipList> range_tombstones_; // Start key -> end key
     size_t max_size_;
-    size_t current_size_;
-    mutable std::mutex mutex_;
+    std::shared_ptr<const PrefixExtractor> prefix_extractor_;
+    // Bits are set by the writer and read without a lock
+    std::unique_ptr<std::atomic<uint64_t>[]> prefix_bloom_;
+    std::mutex write_mutex_; // Serializes writers; readers are lock-free
 };
 
 } // namespace sstable 
\ No newline at end of file
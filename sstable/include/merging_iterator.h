@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "iterator.h"
+
+namespace sstable {
+
+/**
+ * @brief Create an iterator over the union of several sorted sources
+ *
+ * Children are merged lazily through a heap, so positioning the result costs
+ * one Seek per child and each Next only advances one child. Every entry of
+ * every child is yielded: keys ascend, versions of a key go from the highest
+ * sequence number to the lowest, and equal versions from the newest child to
+ * the oldest. Callers pick the versions they need, so deletions and older
+ * versions are yielded like any other entry.
+ *
+ * @param children Sources ordered oldest first
+ * @return std::unique_ptr<Iterator> The merged iterator, which owns the children
+ */
+std::unique_ptr<Iterator> NewMergingIterator(std::vector<std::unique_ptr<Iterator>> children);
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+
+namespace sstable {
+
+class BlockCache;
+class TableCache;
+class Compressor;
+class FilterPolicy;
+class PrefixExtractor;
+
+/**
+ * @brief When the write-ahead log forces appended records to stable storage.
+ */
+enum class WalSyncMode {
+    kEveryWrite,  // fsync before acknowledging each (group-committed) write
+    kInterval,    // fsync from a background thread every wal_sync_interval
+    kNone,        // leave syncing to the operating system
+};
+
+/**
+ * @brief How an LSMTree organizes SSTables and picks compactions.
+ */
+enum class CompactionStyle {
+    kLeveled,    // disjoint, size-bounded files per level; lowest read and space amplification
+    kUniversal,  // size-tiered sorted runs in level 0; lowest write amplification
+};
+
+/**
+ * @brief Triggers of universal (size-tiered) compaction.
+ *
+ * Every flush adds a sorted run, and a compaction merges a group of runs
+ * adjacent in age into one. Checks run in order: space amplification, then
+ * size ratio, then the run count.
+ */
+struct UniversalCompactionOptions {
+    // Number of sorted runs at which compaction starts
+    size_t sorted_run_trigger = 4;
+
+    // A run joins the newer runs being merged when its size is at most
+    // their combined size plus this percentage
+    size_t size_ratio = 1;
+
+    // Smallest and largest number of runs merged by a size ratio compaction
+    size_t min_merge_width = 2;
+    size_t max_merge_width = static_cast<size_t>(-1);
+
+    // Merge every run once the newer runs take more than this percentage of
+    // the size of the oldest one
+    size_t max_size_amplification_percent = 200;
+};
+
+/**
+ * @brief Options controlling how SSTable files are laid out.
+ */
+struct TableOptions {
+    // Target uncompressed size of a data block; the sparse index holds one
+    // key per block
+    size_t block_size = 4 * 1024; // Default 4KB
+
+    // Bloom filter bits spent per key when no filter policy is set; 10 gives
+    // roughly a 1% false positive rate. 0 writes tables without a filter.
+    size_t bloom_bits_per_key = 10;
+
+    // Filter written into new tables; nullptr uses a bloom filter with
+    // bloom_bits_per_key
+    std::shared_ptr<const FilterPolicy> filter_policy;
+
+    // Overrides filter_policy for tables written to particular levels, e.g.
+    // a more compact filter for the deep levels that hold most of the data.
+    // A nullptr entry writes that level without a filter.
+    std::map<int, std::shared_ptr<const FilterPolicy>> level_filter_policies;
+
+    // When set, the prefix of every key is added to table filters and
+    // MemTable prefix filters, letting scans bounded to one prefix skip
+    // tables and MemTables that hold none of its keys
+    std::shared_ptr<const PrefixExtractor> prefix_extractor;
+
+    // Codec applied to every data block of new tables; nullptr stores blocks
+    // raw. NewLZCompressor() is always available, NewLZ4Compressor() and
+    // NewZstdCompressor() when their libraries were found at build time.
+    std::shared_ptr<const Compressor> compressor;
+
+    // Overrides compressor for tables written to particular levels, e.g. a
+    // fast codec near the top of the tree and a stronger one for the deep
+    // levels. A nullptr entry writes that level uncompressed.
+    std::map<int, std::shared_ptr<const Compressor>> level_compressors;
+
+    // A compressed block is only kept if it is at least this percentage
+    // smaller than the raw block; otherwise the raw block is stored
+    size_t min_compression_savings_percent = 12;
+
+    // Cache for data blocks, shared by every table opened with these
+    // options; nullptr disables caching
+    std::shared_ptr<BlockCache> block_cache;
+
+    // Bounds the number of open table files; nullptr gives every table its
+    // own descriptor for its whole lifetime
+    std::shared_ptr<TableCache> table_cache;
+
+    // Map each table file into memory once and decode lookups straight from
+    // the mapping instead of reading through a stream. The block cache is
+    // bypassed since mapped pages are already cached by the OS, except for
+    // compressed blocks, whose uncompressed copies are cached.
+    bool use_mmap_reads = false;
+};
+
+/**
+ * @brief Options controlling the behaviour of an LSMTree.
+ */
+struct Options {
+    // Maximum size of the MemTable in bytes before it is switched out
+    size_t memtable_size = 64 * 1024 * 1024; // Default 64MB
+
+    // Number of full MemTables that may wait for the background flush
+    // before writers are stalled
+    size_t max_immutable_memtables = 2;
+
+    // Number of threads running compactions; jobs on disjoint levels run
+    // concurrently
+    size_t max_background_compactions = 4;
+
+    // Durability of the write-ahead log
+    WalSyncMode wal_sync_mode = WalSyncMode::kEveryWrite;
+
+    // Sync period used when wal_sync_mode is kInterval
+    std::chrono::milliseconds wal_sync_interval{100};
+
+    // Capacity of the block cache created when table_options.block_cache is
+    // not set; 0 disables caching
+    size_t block_cache_size = 8 * 1024 * 1024; // Default 8MB
+
+    // Size of the table cache created when table_options.table_cache is not
+    // set
+    size_t max_open_files = 1000;
+
+    // Compaction policy, chosen when the tree is opened
+    CompactionStyle compaction_style = CompactionStyle::kLeveled;
+
+    // Triggers used when compaction_style is kUniversal
+    UniversalCompactionOptions universal_compaction;
+
+    // Number of key ranges a large leveled compaction is split into and
+    // merged in parallel; 1 merges every compaction on a single thread
+    size_t max_subcompactions = 1;
+
+    // Number of threads probing the SSTables of a sorted level in parallel
+    // during MultiGet, each table with its own share of the keys; 1 probes
+    // every table on the calling thread
+    size_t max_multiget_threads = 1;
+
+    // Tables listed in the MANIFEST are opened lazily, on their first
+    // lookup or scan. A non-zero value instead loads them all when the tree
+    // is opened, this many in parallel, so first reads do not pay for it.
+    size_t table_warmup_threads = 0;
+
+    // Size at which a leveled compaction starts a new output file; levels
+    // above 0 are made of files of about this size with disjoint key ranges
+    size_t target_file_size = 2 * 1024 * 1024; // Default 2MB
+
+    // Layout of SSTables written by flushes and compactions
+    TableOptions table_options;
+};
+
+} // namespace sstable
\ No newline at end of file
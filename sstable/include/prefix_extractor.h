@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+namespace sstable {
+
+/**
+ * @brief PrefixExtractor maps a key to the prefix that scans are bounded by.
+ *
+ * When set in TableOptions, the prefix of every key is added to the table
+ * filter and to a small filter kept by each MemTable, so a scan whose bounds
+ * share a prefix can skip MemTables and tables that hold no key with it.
+ *
+ * Transform must return a prefix of the key such that every key starting
+ * with Transform(key) maps to that same prefix. Both built-in extractors
+ * satisfy this; it is what makes skipping a table for a scan safe.
+ */
+class PrefixExtractor {
+public:
+    virtual ~PrefixExtractor() = default;
+
+    /**
+     * @brief Get the name identifying the extractor and its parameters
+     *
+     * Stored in every table, so a filter is only used for prefixes when it
+     * was built by the same extractor.
+     *
+     * @return const char* The name
+     */
+    virtual const char* Name() const = 0;
+
+    /**
+     * @brief Check whether a key has a prefix
+     *
+     * @param key The key
+     * @return true if Transform may be called on the key
+     */
+    virtual bool InDomain(std::string_view key) const = 0;
+
+    /**
+     * @brief Extract the prefix of a key in the domain
+     *
+     * @param key The key
+     * @return std::string_view The prefix, pointing into key
+     */
+    virtual std::string_view Transform(std::string_view key) const = 0;
+};
+
+/**
+ * @brief Create an extractor returning the first length bytes of a key
+ *
+ * Keys shorter than length are outside its domain.
+ *
+ * @param length Prefix length in bytes
+ * @return std::shared_ptr<const PrefixExtractor> The extractor
+ */
+std::shared_ptr<const PrefixExtractor> NewFixedPrefixExtractor(size_t length);
+
+/**
+ * @brief Create an extractor returning a key up to and including the first delimiter
+ *
+ * With '/' the prefix of "tenant/entity/id" is "tenant/". Keys without the
+ * delimiter are outside its domain.
+ *
+ * @param delimiter The delimiter character
+ * @return std::shared_ptr<const PrefixExtractor> The extractor
+ */
+std::shared_ptr<const PrefixExtractor> NewDelimitedPrefixExtractor(char delimiter);
+
+/**
+ * @brief Find the prefix shared by every key of a scan
+ *
+ * @param extractor The prefix extractor
+ * @param start_key Start of the range (inclusive)
+ * @param end_key End of the range (inclusive)
+ * @param prefix Output parameter for the prefix
+ * @return true if every key in [start_key, end_key] has the prefix *prefix
+ */
+bool GetScanPrefix(const PrefixExtractor& extractor,
+                   std::string_view start_key,
+                   std::string_view end_key,
+                   std::string_view* prefix);
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace sstable {
+
+/**
+ * @brief RandomAccessFile is a read-only file descriptor read with pread.
+ *
+ * Positional reads carry their own offset, so any number of threads can read
+ * through one RandomAccessFile at the same time without synchronization.
+ */
+class RandomAccessFile {
+public:
+    /**
+     * @brief Open a file for reading
+     *
+     * @param path Path to the file
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    explicit RandomAccessFile(const std::string& path);
+    ~RandomAccessFile();
+
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+    /**
+     * @brief Read exactly size bytes starting at offset
+     *
+     * @param offset Position in the file
+     * @param size Number of bytes to read
+     * @param contents Output parameter for the bytes read
+     * @return true if all bytes were read
+     * @return false on an I/O error or if the file is too short
+     */
+    bool Read(uint64_t offset, size_t size, std::string* contents) const;
+
+    /**
+     * @brief Get the path of the file
+     *
+     * @return std::string The file path
+     */
+    std::string GetPath() const { return path_; }
+
+private:
+    std::string path_;
+    int fd_;
+};
+
+/**
+ * @brief Force a file, or the entries of a directory, to stable storage
+ *
+ * A new file only survives a crash once both its contents and the directory
+ * entry naming it are synced.
+ *
+ * @param path Path to the file or directory
+ * @return true if the sync succeeded
+ */
+bool SyncPath(const std::string& path);
+
+} // namespace sstable
\ No newline at end of file
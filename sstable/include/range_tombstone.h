@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sstable {
+
+/**
+ * @brief A deletion of every key in [begin, end) written before it.
+ *
+ * A range tombstone hides the versions of the keys in its range whose
+ * sequence number is lower than its own. Range tombstones are kept apart
+ * from point entries, in memory, by the MemTable and the SSTable that hold
+ * them. The free functions below scan a list linearly; the LSMTree indexes
+ * the tombstones of all its SSTables with FragmentedRangeTombstones instead.
+ */
+struct RangeTombstone {
+    std::string begin; // Inclusive
+    std::string end;   // Exclusive
+    uint64_t sequence;
+
+    /**
+     * @brief Check if a key lies in the range
+     *
+     * @param key The key to check
+     * @return true if begin <= key < end
+     */
+    bool Contains(std::string_view key) const { return begin <= key && key < end; }
+};
+
+/**
+ * @brief Find the newest range tombstone covering a key that a reader sees
+ *
+ * @param tombstones Range tombstones in any order
+ * @param key The key to look up
+ * @param sequence Sequence number the reader reads at
+ * @return uint64_t The highest sequence number at or below sequence of a
+ *         tombstone containing key, or 0 if there is none; versions of key
+ *         below it are deleted
+ */
+uint64_t MaxCoveringSequence(const std::vector<RangeTombstone>& tombstones,
+                             std::string_view key, uint64_t sequence);
+
+/**
+ * @brief Find the oldest range tombstone that deletes a version of a key
+ *
+ * @param tombstones Range tombstones in any order
+ * @param key The key of the version
+ * @param sequence Sequence number of the version
+ * @return uint64_t The lowest sequence number above sequence of a tombstone
+ *         containing key, or kMaxSequenceNumber if the version is not deleted
+ */
+uint64_t NextCoveringSequence(const std::vector<RangeTombstone>& tombstones,
+                              std::string_view key, uint64_t sequence);
+
+/**
+ * @brief An immutable index answering MaxCoveringSequence by binary search
+ *
+ * The tombstones are cut into fragments at every begin and end key, so the
+ * fragments are disjoint and sorted, and every key of a fragment is covered
+ * by the same tombstones. Each fragment keeps their sequence numbers,
+ * highest first.
+ */
+class FragmentedRangeTombstones {
+public:
+    /**
+     * @brief Build the index
+     *
+     * @param tombstones Range tombstones in any order
+     */
+    explicit FragmentedRangeTombstones(const std::vector<RangeTombstone>& tombstones);
+
+    /**
+     * @brief Find the newest range tombstone covering a key that a reader sees
+     *
+     * @param key The key to look up
+     * @param sequence Sequence number the reader reads at
+     * @return uint64_t Same as the free MaxCoveringSequence over the
+     *         tombstones the index was built from
+     */
+    uint64_t MaxCoveringSequence(std::string_view key, uint64_t sequence) const;
+
+    /**
+     * @brief Check if the index holds no tombstone
+     *
+     * @return true if it was built from an empty list, or only from empty ranges
+     */
+    bool IsEmpty() const { return fragments_.empty(); }
+
+private:
+    struct Fragment {
+        std::string begin; // Inclusive
+        std::string end;   // Exclusive
+        std::vector<uint64_t> sequences; // Highest first
+    };
+
+    std::vector<Fragment> fragments_; // Sorted by key, disjoint
+};
+
+} // namespace sstable
\ No newline at end of file
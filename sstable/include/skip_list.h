@@ -1,47 +1,100 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <random>
 #include <vector>
+#include <atomic>
+#include "arena.h"
+#include "iterator.h"
 
 namespace sstable {
 
 /**
  * @brief SkipList is a probabilistic data structure that allows for efficient
  * search, insertion, and deletion operations in O(log n) time.
- * 
+ *
  * The SkipList is used by the MemTable to store key-value pairs in sorted order.
+ *
+ * Thread safety: writes (Insert, Delete) require external synchronization, but
+ * reads (Get, GetAllEntries, iterators) need no lock and may run concurrently with a
+ * writer. Forward links are published with release stores and followed with
+ * acquire loads, and nodes are never freed before the Arena itself, so a
+ * reader never observes a partially linked or reclaimed node.
+ *
+ * Each node, its tower of forward links and its key are laid out in one
+ * contiguous Arena allocation, and values are copied into the Arena as well.
+ *
+ * Every node carries a sequence number and a ValueType, and a key may have
+ * one node per sequence number. Versions of a key are ordered from the highest sequence
+ * number to the lowest, so the newest one is found first.
  */
 class SkipList {
 public:
     /**
-     * @brief Construct a new Skip List
+     * @brief Construct a new Skip List that owns its memory
      */
     SkipList();
 
+    /**
+     * @brief Construct a new Skip List that allocates from an external Arena
+     *
+     * @param arena Arena that must outlive the SkipList
+     */
+    explicit SkipList(Arena* arena);
+
+    SkipList(const SkipList&) = delete;
+    SkipList& operator=(const SkipList&) = delete;
+
     /**
      * @brief Insert a key-value pair
-     * 
+     *
+     * A version with the same key and sequence number is overwritten in
+     * place; otherwise a new version is added.
+     *
      * @param key The key to insert
      * @param value The value to insert
+     * @param sequence Sequence number of the version
+     * @param type Whether the version is a value or a deletion
      * @return true if the insertion was successful
      */
-    bool Insert(const std::string& key, const std::string& value);
+    bool Insert(const std::string& key, const std::string& value, uint64_t sequence = 0,
+                ValueType type = ValueType::kValue);
 
     /**
      * @brief Get the value associated with a key
-     * 
+     *
      * @param key The key to look up
      * @param value Output parameter for the value
+     * @param sequence Only versions with a sequence number up to this one are
+     *        considered; the newest of them is returned
      * @return true if the key was found
-     * @return false if the key was not found
+     * @return false if the key was not found or its newest version is a deletion
+     */
+    bool Get(const std::string& key, std::string* value,
+             uint64_t sequence = kMaxSequenceNumber) const;
+
+    /**
+     * @brief Find the newest version of a key, deletions included
+     *
+     * @param key The key to look up
+     * @param sequence Only versions with a sequence number up to this one are considered
+     * @param value Output parameter for the value
+     * @param type Output parameter for the type of the version
+     * @param found_sequence Output parameter for the sequence number of the version
+     * @return true if a version was found
+     * @return false if there is no version of the key at or below sequence
      */
-    bool Get(const std::string& key, std::string* value) const;
+    bool Find(const std::string& key, uint64_t sequence, std::string* value,
+              ValueType* type, uint64_t* found_sequence) const;
 
     /**
-     * @brief Delete a key
-     * 
+     * @brief Delete the newest version of a key
+     *
+     * The node is unlinked but its memory is kept until the Arena is
+     * released, so concurrent readers positioned on it stay valid.
+     *
      * @param key The key to delete
      * @return true if the deletion was successful
      */
@@ -49,33 +102,63 @@ public:
 
     /**
      * @brief Get all key-value pairs in sorted order
-     * 
+     *
+     * Every version of a key is returned, newest first. The pairs carry no
+     * ValueType, so a deletion looks like an empty value; NewIterator tells
+     * them apart.
+     *
      * @return std::vector<std::pair<std::string, std::string>> Vector of key-value pairs
      */
     std::vector<std::pair<std::string, std::string>> GetAllEntries() const;
 
-private:
-    struct Node {
-        std::string key;
-        std::string value;
-        std::vector<std::shared_ptr<Node>> forward;
+    /**
+     * @brief Create an iterator over the entries in key order
+     *
+     * The iterator may run concurrently with a writer: it sees keys inserted
+     * after its creation only if they land ahead of its position, and each
+     * entry shows the value it had when the iterator reached it.
+     *
+     * @return std::unique_ptr<Iterator> An unpositioned iterator; the SkipList must outlive it
+     */
+    std::unique_ptr<Iterator> NewIterator() const;
+
+    /**
+     * @brief Check whether any key has been inserted
+     *
+     * @return true if the list has no nodes
+     */
+    bool IsEmpty() const;
 
-        Node(const std::string& k, const std::string& v, int level)
-            : key(k), value(v), forward(level + 1) {}
-    };
+    /**
+     * @brief Estimate the Arena bytes one Insert of a new key will consume
+     *
+     * @param key_size Size of the key in bytes
+     * @param value_size Size of the value in bytes
+     * @return size_t Approximate bytes for the node, its key and its value
+     */
+    static size_t EstimateEntrySize(size_t key_size, size_t value_size);
+
+private:
+    // Variable-height node: the tower of forward links and the key bytes
+    // are allocated inline after the node itself
+    struct Node;
+    class ListIterator;
 
-    static constexpr int kMaxLevel = 16;
-    static constexpr float kProbability = 0.5;
+    static constexpr int kMaxLevel = 12;
+    static constexpr unsigned kBranching = 4; // 1 in 4 nodes grows a level
 
     int RandomLevel();
-    std::shared_ptr<Node> FindGreaterOrEqual(
-        const std::string& key,
-        std::vector<std::shared_ptr<Node>>* prev) const;
+    int GetMaxLevel() const { return max_level_.load(std::memory_order_relaxed); }
+    Node* NewNode(std::string_view key, uint64_t sequence, const char* value, int height);
+    const char* NewValue(std::string_view value, ValueType type);
+    // First node at or after (key, sequence) in list order
+    Node* FindGreaterOrEqual(std::string_view key, uint64_t sequence, Node** prev) const;
 
-    std::shared_ptr<Node> head_;
-    int max_level_;
+    std::unique_ptr<Arena> owned_arena_;
+    Arena* arena_;
+    Node* head_;
+    std::atomic<int> max_level_; // Height of the tallest tower
     std::mt19937 rng_;
-    std::uniform_real_distribution<float> dist_;
 };
 
-} // namespace sstable 
\ No newline at end of file
+} // namespace sstable
\ No newline at end of file
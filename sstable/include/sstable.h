@@ -1,62 +1,233 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <fstream>
 #include <map>
+#include <atomic>
 #include <mutex>
 #include "bloom_filter.h"
+#include "compression.h"
+#include "filter_policy.h"
+#include "prefix_extractor.h"
+#include "block_cache.h"
+#include "random_access_file.h"
+#include "table_cache.h"
+#include "iterator.h"
+#include "options.h"
+#include "range_tombstone.h"
+#include "version_edit.h"
 
 namespace sstable {
 
+/**
+ * @brief One key of a batched lookup and the newest version found for it
+ */
+struct KeyLookup {
+    const std::string* key;
+    std::string value;          // Empty for a deletion
+    ValueType type = ValueType::kValue;
+    uint64_t found_sequence = 0;
+    bool found = false;
+};
+
 /**
  * @brief SSTable (Sorted String Table) is an immutable file that stores sorted key-value pairs.
  * 
  * SSTables are created when MemTables are flushed to disk. They support efficient point lookups
- * and range scans. Each SSTable includes a bloom filter for quick existence checks.
+ * and range scans. Each SSTable includes a filter for quick existence checks.
+ * 
+ * Entries are grouped into data blocks of roughly TableOptions::block_size bytes, followed
+ * by a filter block, a properties block, an index block holding the last key of every data
+ * block, and a fixed-size footer that locates them. Opening a table reads only the footer,
+ * index, filter and properties. New files use format version 6, whose filter block is built
+ * by the FilterPolicy chosen for the table's level (a cache-line-blocked bloom filter by
+ * default) and whose properties record the policy name. Every entry carries the sequence
+ * number of the write that produced it and whether it is a value or a deletion, and a
+ * table may hold several versions of a key, newest first. Data blocks may be compressed by
+ * the Compressor chosen for the level, named in the properties; a trailer byte on each
+ * block tells whether it is. Range tombstones are stored in the properties and kept in
+ * memory while the table is open. Version 5 files (no block trailers), version 4 files
+ * (untyped entries), version 3 files (no sequence numbers), version 2 files (same layout,
+ * original bloom filter) and version 1 files (one flat run of entries followed by the
+ * filter) can still be opened; entries of versions before 5 with empty values read as
+ * deletions.
+ * 
+ * Data blocks are looked up in TableOptions::block_cache before the file is read, and
+ * are cached uncompressed. The index and filter stay decoded in memory for the lifetime
+ * of the table.
+ * 
+ * A table opened from its MANIFEST description is loaded lazily: nothing is read until
+ * the first lookup or scan, which reads the footer, index, filter and properties once.
+ * Its key range, size, level, sequence bounds and range tombstones are known from the
+ * description, so planning reads and compactions never loads it.
+ * 
+ * On a block cache miss the block is read with pread, through a descriptor the table
+ * keeps open or borrows from TableOptions::table_cache, so concurrent lookups on one
+ * table never take a lock. With TableOptions::use_mmap_reads the file is instead mapped
+ * once when the table is opened, and data blocks are decoded in place from the mapping.
+ * The mapping is advised for random access, as point lookups touch one block; scans
+ * ask for the blocks ahead of them to be read in the background instead. A file whose
+ * size differs from the one the table was described with is refused before it is
+ * mapped, since touching the mapping past the end of the file would crash the process.
+ * 
+ * A lookup or scan never reports a key as absent because its block could not be read:
+ * I/O errors and corrupt blocks or entries raise std::runtime_error, so callers do not
+ * mistake an unreadable table for one without the key.
  */
 class SSTable {
 public:
     /**
      * @brief Construct a new SSTable from a MemTable
      * 
+     * The file is written with a TableBuilder; larger outputs such as
+     * compactions use the builder directly and open the finished file.
+     * 
      * @param path Directory where the SSTable file will be stored
-     * @param entries Vector of key-value pairs to store
+     * @param entries Vector of key-value pairs to store, sorted by key. Every
+     *        entry is stored as a value, an empty one included; tables holding
+     *        deletions are written with a TableBuilder
      * @param level The level in the LSM tree where this SSTable belongs
      */
     SSTable(const std::string& path,
             const std::vector<std::pair<std::string, std::string>>& entries,
-            int level);
+            int level,
+            const TableOptions& options = TableOptions());
 
     /**
      * @brief Load an existing SSTable from disk
      * 
+     * The level is read from the file's properties; files written before
+     * the level was recorded load at level 0.
+     * 
      * @param path Path to the SSTable file
+     * @param options Options used for reads, such as the block cache
      */
-    explicit SSTable(const std::string& path);
+    explicit SSTable(const std::string& path, const TableOptions& options = TableOptions());
+
+    /**
+     * @brief Open an SSTable described by the MANIFEST without reading it
+     * 
+     * The file is only read by Load, which the first lookup or scan calls.
+     * 
+     * @param path Path to the SSTable file
+     * @param metadata Description recorded when the table was written
+     * @param options Options used for reads, such as the block cache
+     */
+    SSTable(const std::string& path, const FileMetaData& metadata,
+            const TableOptions& options = TableOptions());
+
+    /**
+     * @brief Destroy the SSTable, deleting its file if it was marked obsolete
+     */
+    ~SSTable();
+
+    /**
+     * @brief Read the footer, index, filter and properties if not done yet
+     * 
+     * Safe to call from several threads; the file is read once.
+     * 
+     * @throws std::runtime_error if the file is missing or malformed
+     */
+    void Load() const;
+
+    /**
+     * @brief Check if the index and filter are in memory
+     * 
+     * @return true if lookups no longer need to read them
+     */
+    bool IsLoaded() const { return loaded_.load(std::memory_order_acquire); }
 
     /**
      * @brief Get the value associated with a key
      * 
      * @param key The key to look up
      * @param value Output parameter for the value
+     * @param sequence Only versions with a sequence number up to this one are
+     *        considered; the newest of them is returned
      * @return true if the key was found
-     * @return false if the key was not found
+     * @return false if the key was not found or its newest version is a deletion
+     * @throws std::runtime_error if the table cannot be read or is corrupt
+     */
+    bool Get(const std::string& key, std::string* value,
+             uint64_t sequence = kMaxSequenceNumber) const;
+
+    /**
+     * @brief Find the newest version of a key, deletions included
+     * 
+     * Range tombstones are not applied; see GetRangeTombstones.
+     * 
+     * @param key The key to look up
+     * @param sequence Only versions with a sequence number up to this one are considered
+     * @param value Output parameter for the value, empty for a deletion
+     * @param type Output parameter for the type of the version
+     * @param found_sequence Output parameter for the sequence number of the version
+     * @return true if a version was found
+     * @return false if the table holds no version of the key at or below sequence
+     * @throws std::runtime_error if the table cannot be read or is corrupt
+     */
+    bool Find(const std::string& key, uint64_t sequence, std::string* value,
+              ValueType* type, uint64_t* found_sequence) const;
+
+    /**
+     * @brief Find the newest version of many keys, deletions included
+     * 
+     * Every key is checked against the filter first. The remaining keys are
+     * probed in order, so keys falling in the same data block share a single
+     * read and a single pass over the block. Lookups that are already found
+     * are skipped, and those the table holds no version of are left as they
+     * are. Range tombstones are not applied.
+     * 
+     * @param lookups Lookups of distinct keys, sorted by key
+     * @param sequence Only versions with a sequence number up to this one are considered
+     * @throws std::runtime_error if the table cannot be read or is corrupt; lookups
+     *         resolved before the failure keep their result
      */
-    bool Get(const std::string& key, std::string* value) const;
+    void MultiFind(const std::vector<KeyLookup*>& lookups, uint64_t sequence) const;
 
     /**
      * @brief Get all key-value pairs in a range
      * 
+     * Only the newest version of each key is returned, and keys whose newest
+     * version is a deletion are left out. Range tombstones are not applied.
+     * 
      * @param start_key Start of the range (inclusive)
      * @param end_key End of the range (inclusive)
      * @return std::vector<std::pair<std::string, std::string>> Vector of key-value pairs
+     * @throws std::runtime_error if the table cannot be read or is corrupt
      */
     std::vector<std::pair<std::string, std::string>> GetRange(
         const std::string& start_key,
         const std::string& end_key) const;
 
+    /**
+     * @brief Create an iterator over the entries of this SSTable
+     * 
+     * The iterator reads one data block at a time and holds only that block,
+     * so a full scan uses constant memory whatever the size of the table. It
+     * throws std::runtime_error if a block cannot be read or is corrupt. The SSTable must
+     * outlive the iterator.
+     * 
+     * @param fill_cache Whether blocks read from the file are added to the
+     *        block cache; bulk scans such as compactions pass false. On a
+     *        mapped table, such a scan reads ahead from its first block, and
+     *        any other from the first block it steps into.
+     * @return std::unique_ptr<Iterator> An unpositioned iterator
+     */
+    std::unique_ptr<Iterator> NewIterator(bool fill_cache = true) const;
+
+    /**
+     * @brief Check if any key with a prefix might be in this SSTable
+     * 
+     * @param prefix A prefix produced by TableOptions::prefix_extractor
+     * @return true if such a key might exist, or the filter holds no prefixes
+     *         of the current extractor
+     * @return false if the table holds no key with the prefix
+     */
+    bool PrefixMayMatch(std::string_view prefix) const;
+
     /**
      * @brief Get the file path of this SSTable
      * 
@@ -81,37 +252,145 @@ public:
     /**
      * @brief Get the smallest key in this SSTable
      * 
-     * @return std::string The smallest key
+     * @return const std::string& The smallest key
      */
-    std::string GetSmallestKey() const { return smallest_key_; }
+    const std::string& GetSmallestKey() const { return smallest_key_; }
 
     /**
      * @brief Get the largest key in this SSTable
      * 
-     * @return std::string The largest key
+     * @return const std::string& The largest key
      */
-    std::string GetLargestKey() const { return largest_key_; }
+    const std::string& GetLargestKey() const { return largest_key_; }
+
+    /**
+     * @brief Get the highest sequence number of any entry in this SSTable
+     * 
+     * @return uint64_t The sequence number; 0 for files written before
+     *         sequence numbers were recorded
+     */
+    uint64_t GetLargestSequence() const { return largest_sequence_; }
+
+    /**
+     * @brief Get the lowest sequence number of any entry in this SSTable
+     * 
+     * @return uint64_t The sequence number; 0 for files written before it
+     *         was recorded
+     */
+    uint64_t GetSmallestSequence() const { return smallest_sequence_; }
+
+    /**
+     * @brief Get the range tombstones stored in this SSTable
+     * 
+     * They may delete keys in other tables, and lie outside
+     * [GetSmallestKey(), GetLargestKey()].
+     * 
+     * @return const std::vector<RangeTombstone>& The range tombstones
+     */
+    const std::vector<RangeTombstone>& GetRangeTombstones() const { return range_tombstones_; }
+
+    /**
+     * @brief Mark the file for deletion once the last reference is released
+     * 
+     * Used when a compaction replaces this SSTable while readers may still
+     * be probing it.
+     */
+    void MarkObsolete() { obsolete_ = true; }
+
+    /**
+     * @brief Get the on-disk format version of this SSTable
+     * 
+     * @return uint32_t The format version
+     */
+    uint32_t GetFormatVersion() const {
+        Load();
+        return format_version_;
+    }
+
+    /**
+     * @brief Get the number of entries in the in-memory index
+     * 
+     * One per data block for version 2 files, one per key for version 1 files.
+     * 
+     * @return size_t The number of index entries
+     */
+    size_t GetIndexSize() const {
+        Load();
+        return index_.size();
+    }
+
+    /**
+     * @brief Get the last key of every data block, in order
+     * 
+     * The keys split the table into ranges of about one block each, which
+     * makes them natural split points for dividing work by key range.
+     * 
+     * @return std::vector<std::string> The index keys
+     */
+    std::vector<std::string> GetIndexKeys() const;
 
 private:
+    // Location of a data block; for version 1 files every entry is its own block
     struct IndexEntry {
-        std::string key;
-        uint32_t offset;
-        uint32_t size;
+        std::string key; // Last key in the block
+        uint64_t offset;
+        uint64_t size;
     };
 
-    void WriteToDisk(const std::vector<std::pair<std::string, std::string>>& entries);
-    void ReadFromDisk();
-    void BuildIndex();
-    bool BinarySearch(const std::string& key, std::string* value) const;
+    class TableIterator;
+
+    // With read_metadata false, the key range, level, sequence bounds and
+    // range tombstones are already set and are left untouched
+    void ReadFromDisk(bool read_metadata);
+    void ReadLegacyIndex(std::ifstream& file, uint64_t num_entries, bool read_metadata);
+    void ReadBlockIndex(std::ifstream& file, bool read_metadata);
+    bool ReadBlock(std::ifstream& file, uint64_t offset, uint64_t size,
+                   std::string* contents) const;
+    // Points *contents at the block; *holder keeps a copied block alive and
+    // stays empty when the block lives in the mapping. Throws
+    // std::runtime_error if the block cannot be read or is corrupt.
+    void ReadDataBlock(const IndexEntry& entry,
+                       std::shared_ptr<const std::string>* holder,
+                       std::string_view* contents,
+                       bool fill_cache = true) const;
+    // Throws unless the entries of block ended exactly at pos
+    void CheckBlockEnd(std::string_view block, size_t pos) const;
+    std::shared_ptr<RandomAccessFile> GetFile() const;
+    void OpenForReads();
+    void MapFile();
+    // Ask the kernel to read size bytes of the mapping from offset in the
+    // background; returns the end of the advised range
+    uint64_t ReadAhead(uint64_t offset, uint64_t size) const;
+    const FilterPolicy* FindFilterPolicy(const std::string& name) const;
+    const Compressor* FindCompressor(const std::string& name) const;
+    // Strip the trailer of a stored data block; false if it is malformed
+    bool ParseBlockTrailer(std::string_view* block, bool* compressed) const;
+    bool KeyMayMatch(const std::string& key) const;
+    bool BinarySearch(const std::string& key, uint64_t sequence, std::string* value,
+                      ValueType* type, uint64_t* found_sequence) const;
 
     std::string path_;
+    TableOptions options_;
+    uint64_t cache_id_; // Identifies this table in the block and table caches
+    uint32_t format_version_;
     int level_;
     size_t size_;
     std::string smallest_key_;
     std::string largest_key_;
+    uint64_t smallest_sequence_;
+    uint64_t largest_sequence_;
     std::vector<IndexEntry> index_;
-    std::unique_ptr<BloomFilter> bloom_filter_;
-    mutable std::mutex mutex_;
+    std::vector<RangeTombstone> range_tombstones_;
+    std::unique_ptr<Filter> filter_; // nullptr when filtering is disabled
+    std::string legacy_filter_; // Raw filter block of version 1 and 2 files
+    bool prefix_filtered_; // filter_ also holds prefixes of options_.prefix_extractor
+    const Compressor* compressor_; // Decodes compressed data blocks; nullptr if there are none
+    std::atomic<bool> obsolete_;
+    mutable std::once_flag load_once_;
+    std::atomic<bool> loaded_;
+    std::shared_ptr<RandomAccessFile> file_; // Own descriptor when there is no table cache
+    const char* mapped_;    // Whole file when use_mmap_reads is set
+    size_t mapped_size_;
 };
 
 } // namespace sstable 
\ No newline at end of file
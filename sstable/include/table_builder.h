@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compression.h"
+#include "filter_policy.h"
+#include "iterator.h"
+#include "options.h"
+#include "prefix_extractor.h"
+#include "range_tombstone.h"
+
+namespace sstable {
+
+/**
+ * @brief TableBuilder writes an SSTable file one entry at a time.
+ *
+ * Data blocks are written as soon as they reach TableOptions::block_size, so
+ * memory use does not grow with the size of the values: the builder keeps
+ * the current block, one index entry per finished block and a 64-bit hash
+ * per key for the filter. The filter, properties, index and footer are
+ * written by Finish(). Each data block is compressed with the compressor
+ * chosen for the table's level, and stored raw when that does not save at
+ * least TableOptions::min_compression_savings_percent of its size.
+ *
+ * Finish() syncs the file and its directory, so a finished table survives a
+ * crash. A builder that is destroyed before Finish() deletes its partial file.
+ */
+class TableBuilder {
+public:
+    /**
+     * @brief Start writing a new SSTable
+     *
+     * @param path Path of the file to create
+     * @param level The level in the LSM tree the table will belong to
+     * @param options Layout of the table, such as the block size and filter policy
+     */
+    TableBuilder(const std::string& path, int level, const TableOptions& options);
+
+    /**
+     * @brief Destroy the builder, deleting the file if Finish() was not called
+     */
+    ~TableBuilder();
+
+    TableBuilder(const TableBuilder&) = delete;
+    TableBuilder& operator=(const TableBuilder&) = delete;
+
+    /**
+     * @brief Append an entry
+     *
+     * Entries must be added in key order, and versions of one key from the
+     * highest sequence number to the lowest.
+     *
+     * @param key The key
+     * @param value The value; empty for deletions
+     * @param sequence Sequence number of the write that produced the entry
+     * @param type Whether the entry is a value or a deletion
+     */
+    void Add(std::string_view key, std::string_view value, uint64_t sequence = 0,
+             ValueType type = ValueType::kValue);
+
+    /**
+     * @brief Record a range tombstone
+     *
+     * Range tombstones may be added in any order, and do not widen the key
+     * range of the table.
+     *
+     * @param tombstone The range tombstone
+     */
+    void AddRangeTombstone(const RangeTombstone& tombstone);
+
+    /**
+     * @brief Write the remaining blocks and close the file
+     */
+    void Finish();
+
+    /**
+     * @brief Get the number of entries added so far
+     *
+     * @return uint64_t The number of entries
+     */
+    uint64_t GetNumEntries() const { return num_entries_; }
+
+    /**
+     * @brief Get the number of bytes written so far
+     *
+     * @return uint64_t The file size, final once Finish() returns
+     */
+    uint64_t GetFileSize() const { return offset_; }
+
+private:
+    struct IndexEntry {
+        std::string key; // Last key in the block
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    void FlushBlock();
+    void Write(std::string_view data);
+    std::shared_ptr<const FilterPolicy> ChooseFilterPolicy() const;
+    std::shared_ptr<const Compressor> ChooseCompressor() const;
+
+    std::string path_;
+    int level_;
+    TableOptions options_;
+    std::ofstream file_;
+    uint64_t offset_;
+    uint64_t num_entries_;
+    uint64_t smallest_sequence_;
+    uint64_t largest_sequence_;
+    std::string block_;
+    std::string compressed_block_; // Reused by every FlushBlock
+    std::shared_ptr<const Compressor> compressor_; // nullptr stores blocks raw
+    std::string smallest_key_;
+    std::string last_key_;
+    std::string last_prefix_;
+    bool has_prefix_;
+    std::vector<IndexEntry> index_;
+    std::vector<RangeTombstone> range_tombstones_;
+    std::vector<uint64_t> filter_hashes_; // Keys and prefixes for the filter
+    bool finished_;
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "random_access_file.h"
+
+namespace sstable {
+
+/**
+ * @brief TableCache bounds the number of SSTable files held open at once.
+ *
+ * Open files are kept in LRU order, keyed by the id of the table that owns
+ * them. When more than the configured number are open, the least recently
+ * used file is dropped from the cache. Files are handed out as shared
+ * pointers, so a file evicted in the middle of a read is only closed once
+ * that read finishes.
+ */
+class TableCache {
+public:
+    /**
+     * @brief Construct a new Table Cache
+     *
+     * @param max_open_files Maximum number of files the cache keeps open
+     */
+    explicit TableCache(size_t max_open_files);
+
+    TableCache(const TableCache&) = delete;
+    TableCache& operator=(const TableCache&) = delete;
+
+    /**
+     * @brief Get the open file of a table, opening it on a miss
+     *
+     * @param table_id Id of the table
+     * @param path Path of the table file, used on a miss
+     * @return std::shared_ptr<RandomAccessFile> The open file
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    std::shared_ptr<RandomAccessFile> Open(uint64_t table_id, const std::string& path);
+
+    /**
+     * @brief Drop the file of a table, e.g. because the table was destroyed
+     *
+     * @param table_id Id of the table
+     */
+    void Evict(uint64_t table_id);
+
+    /**
+     * @brief Get the number of files currently held by the cache
+     *
+     * @return size_t The number of open files
+     */
+    size_t GetOpenFiles() const;
+
+private:
+    using Entry = std::pair<uint64_t, std::shared_ptr<RandomAccessFile>>;
+
+    const size_t max_open_files_;
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // Most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> files_;
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "coding.h"
+#include "iterator.h"
+#include "range_tombstone.h"
+
+namespace sstable {
+
+/**
+ * @brief Constants and encoders of the on-disk SSTable format, shared by the
+ * writer (TableBuilder) and the reader (SSTable).
+ */
+
+constexpr uint32_t kTableMagic = 0x53535442; // "SSTB"
+constexpr uint32_t kLegacyFormatVersion = 1;
+constexpr uint32_t kBlockFormatVersion = 2;
+constexpr uint32_t kBlockedFilterFormatVersion = 3; // Version 2 with a new filter block
+constexpr uint32_t kSequenceFormatVersion = 4; // Version 3 with varint entries and sequences
+constexpr uint32_t kValueTypeFormatVersion = 5; // Version 4 with typed entries and range tombstones
+constexpr uint32_t kCompressionFormatVersion = 6; // Version 5 with a type trailer on data blocks
+
+// magic (4) + version (4) + number of entries (8)
+constexpr size_t kTableHeaderSize = 16;
+
+// Handles of the filter, properties and index blocks (8 + 8 each),
+// followed by magic (4) and version (4)
+constexpr size_t kTableFooterSize = 56;
+
+constexpr const char* kSmallestKeyProperty = "smallest_key";
+constexpr const char* kLargestKeyProperty = "largest_key";
+constexpr const char* kFilterPolicyProperty = "filter_policy";
+constexpr const char* kPrefixExtractorProperty = "prefix_extractor";
+constexpr const char* kLevelProperty = "level";
+constexpr const char* kLargestSequenceProperty = "largest_sequence";
+constexpr const char* kSmallestSequenceProperty = "smallest_sequence";
+constexpr const char* kRangeTombstonesProperty = "range_tombstones";
+constexpr const char* kCompressionProperty = "compression";
+
+// Version 3 files written before filter policies were recorded hold bloom filters
+constexpr const char* kDefaultFilterPolicy = "sstable.BloomFilter";
+
+// Location of a block within the file
+struct BlockHandle {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Since version 6 every data block ends with a one-byte trailer telling
+// whether it is stored raw or by the compressor named in the properties;
+// the size in the index includes the trailer
+constexpr size_t kBlockTrailerSize = 1;
+constexpr uint8_t kRawBlock = 0;
+constexpr uint8_t kCompressedBlock = 1;
+
+// Entries are stored as [key length (varint)][value length (varint)]
+// [tag (varint)][key][value], the tag packing the sequence number above an
+// 8-bit ValueType. Version 4 stores the bare sequence number in place of the
+// tag, and earlier versions store [key length (4)][value length (4)][key]
+// [value] without one; entries of those versions decode as deletions exactly
+// when their value is empty, which is how deletions used to be written.
+inline void EncodeEntry(std::string* dst, std::string_view key, uint64_t sequence,
+                        ValueType type, std::string_view value) {
+    PutVarint64(dst, key.size());
+    PutVarint64(dst, value.size());
+    PutVarint64(dst, (sequence << 8) | static_cast<uint8_t>(type));
+    dst->append(key);
+    dst->append(value);
+}
+
+// Decode the entry at *pos of a block written in format_version and advance
+// past it; false at the end of the block. Entries without a sequence number
+// decode with sequence 0.
+inline bool DecodeEntry(std::string_view block, uint32_t format_version, size_t* pos,
+                        std::string_view* key, uint64_t* sequence, ValueType* type,
+                        std::string_view* value) {
+    const char* ptr = block.data() + *pos;
+    const char* limit = block.data() + block.size();
+    uint64_t key_len, value_len;
+    if (format_version >= kSequenceFormatVersion) {
+        if (!(ptr = GetVarint64(ptr, limit, &key_len)) ||
+            !(ptr = GetVarint64(ptr, limit, &value_len)) ||
+            !(ptr = GetVarint64(ptr, limit, sequence))) {
+            return false;
+        }
+    } else {
+        if (limit - ptr < 8) {
+            return false;
+        }
+        key_len = DecodeFixed32(ptr);
+        value_len = DecodeFixed32(ptr + 4);
+        *sequence = 0;
+        ptr += 8;
+    }
+    if (static_cast<uint64_t>(limit - ptr) < key_len ||
+        static_cast<uint64_t>(limit - ptr) - key_len < value_len) {
+        return false;
+    }
+    if (format_version >= kValueTypeFormatVersion) {
+        const uint64_t tag = *sequence;
+        if ((tag & 0xff) > static_cast<uint8_t>(ValueType::kValue)) {
+            return false;
+        }
+        *type = static_cast<ValueType>(tag & 0xff);
+        *sequence = tag >> 8;
+    } else {
+        *type = value_len == 0 ? ValueType::kDeletion : ValueType::kValue;
+    }
+    *key = std::string_view(ptr, key_len);
+    *value = std::string_view(ptr + key_len, value_len);
+    *pos = static_cast<size_t>(ptr + key_len + value_len - block.data());
+    return true;
+}
+
+// Range tombstones are stored in a property as a run of entries, one per
+// tombstone: a deletion keyed by the start of the range whose value is its end
+inline std::string EncodeRangeTombstones(const std::vector<RangeTombstone>& tombstones) {
+    std::string result;
+    for (const auto& tombstone : tombstones) {
+        EncodeEntry(&result, tombstone.begin, tombstone.sequence, ValueType::kDeletion,
+                    tombstone.end);
+    }
+    return result;
+}
+
+inline bool DecodeRangeTombstones(std::string_view data, std::vector<RangeTombstone>* tombstones) {
+    size_t pos = 0;
+    std::string_view begin, end;
+    uint64_t sequence;
+    ValueType type;
+    while (pos < data.size()) {
+        if (!DecodeEntry(data, kValueTypeFormatVersion, &pos, &begin, &sequence, &type, &end)) {
+            return false;
+        }
+        tombstones->push_back({std::string(begin), std::string(end), sequence});
+    }
+    return true;
+}
+
+inline void PutLengthPrefixed(std::string* dst, std::string_view value) {
+    PutFixed32(dst, static_cast<uint32_t>(value.size()));
+    dst->append(value);
+}
+
+inline bool GetLengthPrefixed(const std::string& src, size_t* pos, std::string* value) {
+    if (src.size() - *pos < 4) {
+        return false;
+    }
+    uint32_t len = DecodeFixed32(src.data() + *pos);
+    if (src.size() - *pos - 4 < len) {
+        return false;
+    }
+    value->assign(src.data() + *pos + 4, len);
+    *pos += 4 + len;
+    return true;
+}
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace sstable {
+
+/**
+ * @brief ThreadPool runs scheduled tasks on a fixed set of worker threads.
+ * 
+ * Tasks run in FIFO order. Destroying the pool runs every task that is still
+ * queued before the workers are joined.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Construct a new Thread Pool
+     * 
+     * @param num_threads Number of worker threads (at least one is started)
+     */
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queue a task for execution on a worker thread
+     * 
+     * @param task The task to run
+     */
+    void Schedule(std::function<void()> task);
+
+    /**
+     * @brief Get the number of worker threads
+     * 
+     * @return size_t The number of threads
+     */
+    size_t GetNumThreads() const { return workers_.size(); }
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "range_tombstone.h"
+
+namespace sstable {
+
+/**
+ * @brief Description of an SSTable recorded in the MANIFEST
+ */
+struct FileMetaData {
+    int level = 0;
+    std::string path; // Relative to the directory of the tree
+    std::string smallest_key;
+    std::string largest_key;
+    uint64_t size = 0;
+    uint64_t smallest_sequence = 0;
+    uint64_t largest_sequence = 0;
+    // Kept here so that reads can apply them before the table is loaded
+    std::vector<RangeTombstone> range_tombstones;
+};
+
+/**
+ * @brief A change to the set of SSTables of an LSMTree, as one MANIFEST record
+ *
+ * The MANIFEST is a write-ahead log of edits: the first record describes
+ * every live table, and each flush or compaction appends the tables it adds
+ * and removes. Replaying the records in order rebuilds the exact level layout
+ * without listing directories or reading table files.
+ *
+ * Fields are tagged, so records written by newer code with fields this code
+ * does not know are rejected rather than misread.
+ */
+struct VersionEdit {
+    std::vector<FileMetaData> new_files;
+    std::vector<std::string> deleted_files; // Paths, as recorded when added
+
+    // Write-ahead logs numbered below this one only hold flushed writes
+    bool has_log_number = false;
+    uint64_t log_number = 0;
+
+    bool has_last_sequence = false;
+    uint64_t last_sequence = 0;
+
+    void SetLogNumber(uint64_t number) {
+        has_log_number = true;
+        log_number = number;
+    }
+
+    void SetLastSequence(uint64_t sequence) {
+        has_last_sequence = true;
+        last_sequence = sequence;
+    }
+
+    /**
+     * @brief Serialize the edit into a MANIFEST record
+     *
+     * @param dst String the record is appended to
+     */
+    void EncodeTo(std::string* dst) const;
+
+    /**
+     * @brief Parse a MANIFEST record
+     *
+     * @param src The record
+     * @return true if the record was parsed
+     * @return false if the record is malformed
+     */
+    bool DecodeFrom(const std::string& src);
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "options.h"
+
+namespace sstable {
+
+/**
+ * @brief WriteAheadLog is an append-only file of checksummed records.
+ *
+ * Every record is framed as [crc32 (4 bytes)][length (4 bytes)][payload].
+ * Replay stops at the first truncated or corrupt record, so a torn write at
+ * the tail of the log is discarded instead of being applied.
+ *
+ * A single AddRecord call performs one write and, depending on the sync mode,
+ * at most one fsync. Callers batch several logical writes into one record to
+ * amortize the sync (see LSMTree group commit).
+ */
+class WriteAheadLog {
+public:
+    /**
+     * @brief Open (or create) a log file for appending
+     *
+     * @param path Path to the log file
+     * @param sync_mode When appended records are synced to disk
+     * @param sync_interval Sync period used with WalSyncMode::kInterval
+     */
+    WriteAheadLog(const std::string& path,
+                  WalSyncMode sync_mode,
+                  std::chrono::milliseconds sync_interval);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    /**
+     * @brief Append a record to the log
+     *
+     * Once a sync has failed, including a background sync of
+     * WalSyncMode::kInterval, every later call fails without writing:
+     * records acknowledged since the last good sync may be lost.
+     *
+     * @param payload The record contents
+     * @return true if the record was written (and synced if required)
+     */
+    bool AddRecord(const std::string& payload);
+
+    /**
+     * @brief Force all appended records to stable storage
+     *
+     * @return true if the sync succeeded
+     */
+    bool Sync();
+
+    /**
+     * @brief Get the file path of this log
+     *
+     * @return std::string The file path
+     */
+    std::string GetPath() const { return path_; }
+
+    /**
+     * @brief Read every intact record of a log file in order
+     *
+     * @param path Path to the log file
+     * @param handler Called with the payload of each record
+     * @return size_t Number of records replayed
+     */
+    static size_t Replay(const std::string& path,
+                         const std::function<void(const std::string&)>& handler);
+
+private:
+    void SyncLoop();
+
+    std::string path_;
+    int fd_;
+    WalSyncMode sync_mode_;
+    std::chrono::milliseconds sync_interval_;
+    bool dirty_;
+    bool sync_failed_; // A sync reported an error; latched
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread sync_thread_;
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sstable {
+
+/**
+ * @brief WriteBatch collects updates that an LSMTree applies atomically.
+ *
+ * Operations are serialized into a single buffer as they are added, in the
+ * layout of a write-ahead log record: a header holding the sequence number
+ * of the first operation, then every operation as
+ * [type (1 byte)][key length (4)][value length (4)][key][value]. Writing a
+ * batch therefore costs one log record and one pass through the writer
+ * queue, and its operations take consecutive sequence numbers in the order
+ * they were added. Readers see either all of them or none.
+ *
+ * A batch is not thread-safe; it may be reused after Clear.
+ */
+class WriteBatch {
+public:
+    /**
+     * @brief Receiver of the operations of a batch, in order
+     */
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+        virtual void Put(const std::string& key, const std::string& value) = 0;
+        virtual void Delete(const std::string& key) = 0;
+        virtual void DeleteRange(const std::string& begin_key, const std::string& end_key) = 0;
+    };
+
+    WriteBatch();
+
+    /**
+     * @brief Add the insertion of a key-value pair
+     *
+     * @param key The key to insert
+     * @param value The value to insert
+     */
+    void Put(const std::string& key, const std::string& value);
+
+    /**
+     * @brief Add the deletion of a key
+     *
+     * @param key The key to delete
+     */
+    void Delete(const std::string& key);
+
+    /**
+     * @brief Add the deletion of every key in [begin_key, end_key)
+     *
+     * @param begin_key Start of the range (inclusive)
+     * @param end_key End of the range (exclusive); an empty range adds nothing
+     */
+    void DeleteRange(const std::string& begin_key, const std::string& end_key);
+
+    /**
+     * @brief Add the operations of another batch after those of this one
+     *
+     * @param other The batch to copy
+     */
+    void Append(const WriteBatch& other);
+
+    /**
+     * @brief Remove every operation
+     */
+    void Clear();
+
+    /**
+     * @brief Get the number of operations
+     *
+     * @return size_t The number of operations
+     */
+    size_t Count() const { return count_; }
+
+    /**
+     * @brief Get the size of the serialized batch
+     *
+     * @return size_t Bytes the batch takes in the write-ahead log
+     */
+    size_t ApproximateSize() const { return rep_.size(); }
+
+    /**
+     * @brief Pass every operation to a handler, in order
+     *
+     * @param handler The receiver of the operations
+     * @return true if every operation was decoded
+     * @return false if the batch is malformed
+     */
+    bool Iterate(Handler* handler) const;
+
+private:
+    friend class LSMTree;
+
+    // Sequence number of the first operation, or 0 if the batch was logged
+    // before sequence numbers existed
+    uint64_t Sequence() const;
+    void SetSequence(uint64_t sequence);
+
+    const std::string& Contents() const { return rep_; }
+
+    // Replace the batch with a log record; false if the record is malformed
+    bool SetContents(const std::string& contents);
+
+    std::string rep_;
+    size_t count_;
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "filter_policy.h"
+
+namespace sstable {
+
+/**
+ * @brief XorFilter is a static filter storing one 8-bit fingerprint per slot.
+ *
+ * Every key maps to three slots, one in each third of the table, and the XOR
+ * of those slots equals the key's fingerprint. The table holds about 1.23
+ * slots per key, so the filter costs roughly 9.9 bits per key for a false
+ * positive rate of 1/256. Unlike a bloom filter, keys cannot be added after
+ * construction.
+ */
+class XorFilter : public Filter {
+public:
+    /**
+     * @brief Build a filter over a set of key hashes
+     *
+     * @param hashes Hash64 of every key; duplicates are ignored
+     * @return std::unique_ptr<XorFilter> The filter
+     */
+    static std::unique_ptr<XorFilter> Build(std::vector<uint64_t> hashes);
+
+    bool MightContain(const std::string& key) const override;
+
+    /**
+     * @brief Serialize the filter to a string
+     *
+     * @return std::string Serialized filter
+     */
+    std::string Serialize() const;
+
+    /**
+     * @brief Deserialize a filter from a string
+     *
+     * @param data Serialized filter
+     * @return std::unique_ptr<XorFilter> Deserialized filter, or nullptr if data is malformed
+     */
+    static std::unique_ptr<XorFilter> Deserialize(const std::string& data);
+
+private:
+    XorFilter(uint64_t seed, uint32_t block_length);
+
+    struct Slots {
+        uint32_t index[3];
+    };
+
+    uint64_t Mix(uint64_t hash) const;
+    Slots GetSlots(uint64_t mixed) const;
+    static uint8_t Fingerprint(uint64_t mixed);
+
+    uint64_t seed_;
+    uint32_t block_length_; // Slots in each third of the table
+    std::vector<uint8_t> fingerprints_;
+};
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "arena.h"
+#include <cstdint>
+
+namespace sstable {
+
+Arena::Arena()
+    : alloc_ptr_(nullptr),
+      alloc_bytes_remaining_(0),
+      memory_usage_(0) {}
+
+char* Arena::Allocate(size_t bytes) {
+    memory_usage_.fetch_add(bytes, std::memory_order_relaxed);
+    if (bytes <= alloc_bytes_remaining_) {
+        char* result = alloc_ptr_;
+        alloc_ptr_ += bytes;
+        alloc_bytes_remaining_ -= bytes;
+        return result;
+    }
+    return AllocateFallback(bytes);
+}
+
+char* Arena::AllocateAligned(size_t bytes) {
+    constexpr size_t kAlign = alignof(std::max_align_t);
+    size_t current_mod = reinterpret_cast<uintptr_t>(alloc_ptr_) & (kAlign - 1);
+    size_t slop = (current_mod == 0 ? 0 : kAlign - current_mod);
+    size_t needed = bytes + slop;
+    if (needed <= alloc_bytes_remaining_) {
+        memory_usage_.fetch_add(needed, std::memory_order_relaxed);
+        char* result = alloc_ptr_ + slop;
+        alloc_ptr_ += needed;
+        alloc_bytes_remaining_ -= needed;
+        return result;
+    }
+    // New blocks come from operator new[] and are always aligned
+    memory_usage_.fetch_add(bytes, std::memory_order_relaxed);
+    return AllocateFallback(bytes);
+}
+
+char* Arena::AllocateFallback(size_t bytes) {
+    if (bytes > kBlockSize / 4) {
+        // Large objects get their own block so the current one isn't wasted
+        return AllocateNewBlock(bytes);
+    }
+
+    alloc_ptr_ = AllocateNewBlock(kBlockSize);
+    alloc_bytes_remaining_ = kBlockSize;
+
+    char* result = alloc_ptr_;
+    alloc_ptr_ += bytes;
+    alloc_bytes_remaining_ -= bytes;
+    return result;
+}
+
+char* Arena::AllocateNewBlock(size_t block_bytes) {
+    blocks_.emplace_back(new char[block_bytes]); // Left uninitialized
+    return blocks_.back().get();
+}
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "block_cache.h"
+#include <algorithm>
+
+namespace sstable {
+
+BlockCache::BlockCache(size_t capacity, int num_shard_bits)
+    : capacity_(capacity),
+      hits_(0),
+      misses_(0) {
+    const size_t num_shards = size_t{1} << std::max(num_shard_bits, 0);
+    shards_.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+        shards_.back()->capacity = (capacity + num_shards - 1) / num_shards;
+    }
+}
+
+uint64_t BlockCache::NewId() {
+    static std::atomic<uint64_t> next_id(1);
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t BlockCache::CacheKeyHash::operator()(const CacheKey& key) const {
+    // Mix both halves so blocks of one table spread over all shards
+    uint64_t h = key.file_id * 0x9E3779B97F4A7C15ull ^ key.offset;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
+BlockCache::Shard& BlockCache::GetShard(const CacheKey& key) {
+    return *shards_[CacheKeyHash()(key) & (shards_.size() - 1)];
+}
+
+std::shared_ptr<const std::string> BlockCache::Lookup(uint64_t file_id, uint64_t offset) {
+    CacheKey key{file_id, offset};
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.table.find(key);
+    if (it == shard.table.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->second->second;
+}
+
+void BlockCache::Insert(uint64_t file_id, uint64_t offset,
+                        std::shared_ptr<const std::string> block) {
+    CacheKey key{file_id, offset};
+    Shard& shard = GetShard(key);
+    const size_t charge = block->size();
+    if (charge > shard.capacity) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.table.find(key);
+    if (it != shard.table.end()) {
+        shard.usage -= it->second->second->size();
+        shard.lru.erase(it->second);
+        shard.table.erase(it);
+    }
+
+    while (shard.usage + charge > shard.capacity && !shard.lru.empty()) {
+        const auto& victim = shard.lru.back();
+        shard.usage -= victim.second->size();
+        shard.table.erase(victim.first);
+        shard.lru.pop_back();
+    }
+
+    shard.lru.emplace_front(key, std::move(block));
+    shard.table[key] = shard.lru.begin();
+    shard.usage += charge;
+}
+
+void BlockCache::Erase(uint64_t file_id, uint64_t offset) {
+    CacheKey key{file_id, offset};
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.table.find(key);
+    if (it != shard.table.end()) {
+        shard.usage -= it->second->second->size();
+        shard.lru.erase(it->second);
+        shard.table.erase(it);
+    }
+}
+
+size_t BlockCache::GetUsage() const {
+    size_t usage = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        usage += shard->usage;
+    }
+    return usage;
+}
+
+} // namespace sstable
\ No newline at end of file
@@ -1,78 +1,134 @@
 #include "bloom_filter.h"
-#include <functional>
-#include <sstream>
+#include "coding.h"
+#include <algorithm>
 
 namespace sstable {
 
+namespace {
+
+// num_hashes (4) + number of blocks (4)
+constexpr size_t kFilterHeaderSize = 8;
+
+uint64_t HashKey(const std::string& key) {
+    return Hash64(key.data(), key.size());
+}
+
+} // namespace
+
 BloomFilter::BloomFilter(size_t size, size_t num_hashes)
-    : bits_((size + 63) / 64),  // Round up to nearest 64-bit block
-      num_hashes_(num_hashes) {
-    InitializeHashFunctions();
+    : blocks_(std::max<size_t>((size + kBlockBits - 1) / kBlockBits, 1)),
+      num_hashes_(std::clamp<size_t>(num_hashes, 1, 30)) {
+    for (auto& block : blocks_) {
+        std::fill(std::begin(block.words), std::end(block.words), 0);
+    }
+}
+
+size_t BloomFilter::OptimalNumHashes(size_t bits_per_key) {
+    // bits_per_key * ln(2), rounded
+    return std::clamp<size_t>((bits_per_key * 69 + 50) / 100, 1, 30);
 }
 
-void BloomFilter::InitializeHashFunctions() {
-    // Use different seeds for each hash function
+size_t BloomFilter::BlockIndex(uint64_t hash) const {
+    // Map the upper half onto [0, number of blocks) without a division
+    return static_cast<size_t>(((hash >> 32) * blocks_.size()) >> 32);
+}
+
+void BloomFilter::ProbeMask(uint64_t hash, uint64_t* mask) const {
+    uint32_t h = static_cast<uint32_t>(hash);
+    const uint32_t delta = (h >> 17) | (h << 15);
     for (size_t i = 0; i < num_hashes_; ++i) {
-        hash_functions_.push_back(
-            [i](const std::string& key) {
-                size_t hash = 5381;
-                for (char c : key) {
-                    hash = ((hash << 5) + hash) + c + i;
-                }
-                return hash;
-            }
-        );
+        const uint32_t bit = h & (kBlockBits - 1);
+        mask[bit >> 6] |= uint64_t{1} << (bit & 63);
+        h += delta;
     }
 }
 
 void BloomFilter::Add(const std::string& key) {
-    for (size_t i = 0; i < num_hashes_; ++i) {
-        size_t hash = hash_functions_[i](key);
-        size_t bit_index = hash % (bits_.size() * 64);
-        size_t block_index = bit_index / 64;
-        size_t bit_offset = bit_index % 64;
-        bits_[block_index].set(bit_offset);
+    AddHash(HashKey(key));
+}
+
+void BloomFilter::AddHash(uint64_t hash) {
+    uint64_t mask[kWordsPerBlock] = {};
+    ProbeMask(hash, mask);
+
+    Block& block = blocks_[BlockIndex(hash)];
+    for (size_t i = 0; i < kWordsPerBlock; ++i) {
+        block.words[i] |= mask[i];
     }
 }
 
 bool BloomFilter::MightContain(const std::string& key) const {
-    for (size_t i = 0; i < num_hashes_; ++i) {
-        size_t hash = hash_functions_[i](key);
-        size_t bit_index = hash % (bits_.size() * 64);
-        size_t block_index = bit_index / 64;
-        size_t bit_offset = bit_index % 64;
-        if (!bits_[block_index].test(bit_offset)) {
-            return false;
-        }
+    const uint64_t hash = HashKey(key);
+    uint64_t mask[kWordsPerBlock] = {};
+    ProbeMask(hash, mask);
+
+    // No early exit, so the loop compiles to straight-line vector code
+    const Block& block = blocks_[BlockIndex(hash)];
+    uint64_t missing = 0;
+    for (size_t i = 0; i < kWordsPerBlock; ++i) {
+        missing |= mask[i] & ~block.words[i];
     }
-    return true;
+    return missing == 0;
 }
 
 std::string BloomFilter::Serialize() const {
-    std::stringstream ss;
-    ss.write(reinterpret_cast<const char*>(&num_hashes_), sizeof(num_hashes_));
-    size_t num_blocks = bits_.size();
-    ss.write(reinterpret_cast<const char*>(&num_blocks), sizeof(num_blocks));
-    for (const auto& block : bits_) {
-        uint64_t value = block.to_ullong();
-        ss.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    std::string result;
+    result.reserve(kFilterHeaderSize + blocks_.size() * sizeof(Block));
+    PutFixed32(&result, static_cast<uint32_t>(num_hashes_));
+    PutFixed32(&result, static_cast<uint32_t>(blocks_.size()));
+    for (const auto& block : blocks_) {
+        for (uint64_t word : block.words) {
+            PutFixed64(&result, word);
+        }
     }
-    return ss.str();
+    return result;
 }
 
 std::unique_ptr<BloomFilter> BloomFilter::Deserialize(const std::string& data) {
-    std::stringstream ss(data);
-    size_t num_hashes, num_blocks;
-    ss.read(reinterpret_cast<char*>(&num_hashes), sizeof(num_hashes));
-    ss.read(reinterpret_cast<char*>(&num_blocks), sizeof(num_blocks));
-    
-    auto filter = std::make_unique<BloomFilter>(num_blocks * 64, num_hashes);
-    for (size_t i = 0; i < num_blocks; ++i) {
-        uint64_t value;
-        ss.read(reinterpret_cast<char*>(&value), sizeof(value));
-        filter->bits_[i] = std::bitset<64>(value);
+    if (data.size() < kFilterHeaderSize) {
+        return nullptr;
+    }
+    const uint32_t num_hashes = DecodeFixed32(data.data());
+    const uint32_t num_blocks = DecodeFixed32(data.data() + 4);
+    if (num_blocks == 0 || data.size() != kFilterHeaderSize + num_blocks * sizeof(Block)) {
+        return nullptr;
+    }
+
+    auto filter = std::make_unique<BloomFilter>(num_blocks * kBlockBits, num_hashes);
+    const char* ptr = data.data() + kFilterHeaderSize;
+    for (auto& block : filter->blocks_) {
+        for (uint64_t& word : block.words) {
+            word = DecodeFixed64(ptr);
+            ptr += 8;
+        }
     }
     return filter;
 }
 
-} // namespace sstable 
\ No newline at end of file
+bool BloomFilter::LegacyMightContain(const std::string& data, const std::string& key) {
+    // Layout: num_hashes (8), number of 64-bit words (8), words
+    if (data.size() < 16) {
+        return true;
+    }
+    const uint64_t num_hashes = DecodeFixed64(data.data());
+    const uint64_t num_words = DecodeFixed64(data.data() + 8);
+    if (num_words == 0 || (data.size() - 16) / 8 < num_words) {
+        return true;
+    }
+
+    for (uint64_t i = 0; i < num_hashes; ++i) {
+        // DJB2 with the hash function index added to every byte
+        size_t hash = 5381;
+        for (char c : key) {
+            hash = ((hash << 5) + hash) + c + i;
+        }
+        const size_t bit_index = hash % (num_words * 64);
+        const uint64_t word = DecodeFixed64(data.data() + 16 + (bit_index / 64) * 8);
+        if (!(word & (uint64_t{1} << (bit_index % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace sstable
\ No newline at end of file
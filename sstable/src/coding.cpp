@@ -0,0 +1,62 @@
+#include "coding.h"
+#include <array>
+
+namespace sstable {
+
+namespace {
+
+std::array<uint32_t, 256> MakeCrcTable() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; ++j) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+} // namespace
+
+uint32_t Crc32(const char* data, size_t size) {
+    static const std::array<uint32_t, 256> table = MakeCrcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+uint64_t Hash64(const char* data, size_t size, uint64_t seed) {
+    constexpr uint64_t m = 0xC6A4A7935BD1E995ull;
+    constexpr int r = 47;
+
+    uint64_t h = seed ^ (size * m);
+    const char* end = data + (size & ~size_t{7});
+    for (; data != end; data += 8) {
+        uint64_t k = DecodeFixed64(data);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    const size_t tail = size & 7;
+    if (tail != 0) {
+        uint64_t k = 0;
+        for (size_t i = tail; i > 0; --i) {
+            k = (k << 8) | static_cast<uint8_t>(data[i - 1]);
+        }
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+} // namespace sstable
\ No newline at end of file
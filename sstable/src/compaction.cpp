@@ -1,102 +1,413 @@
 #include "compaction.h"
+#include "merging_iterator.h"
+#include "random_access_file.h"
+#include "table_builder.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
 #include <filesystem>
+#include <future>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
 
 namespace sstable {
 
-Compaction::Compaction(const std::string& base_path)
-    : base_path_(base_path) {
+namespace {
+
+template <typename TablePtr>
+std::vector<const SSTable*> RawTables(const std::vector<TablePtr>& tables) {
+    std::vector<const SSTable*> raw;
+    raw.reserve(tables.size());
+    for (const auto& table : tables) {
+        raw.push_back(table.get());
+    }
+    return raw;
+}
+
+// An older version of a key must be kept if a snapshot reads it: one taken
+// at or after the version but before the next newer version was written
+bool SnapshotReads(const std::vector<uint64_t>& snapshots, uint64_t sequence,
+                   uint64_t newer_sequence) {
+    auto it = std::lower_bound(snapshots.begin(), snapshots.end(), sequence);
+    return it != snapshots.end() && *it < newer_sequence;
+}
+
+// A deletion must be kept while a snapshot older than it may read what it hides
+bool SnapshotBelow(const std::vector<uint64_t>& snapshots, uint64_t sequence) {
+    return !snapshots.empty() && snapshots.front() < sequence;
+}
+
+class VersionFilterIterator : public Iterator {
+public:
+    VersionFilterIterator(std::unique_ptr<Iterator> input, std::vector<uint64_t> snapshots,
+                          std::vector<RangeTombstone> range_tombstones, bool drop_deletions)
+        : input_(std::move(input)),
+          snapshots_(std::move(snapshots)),
+          range_tombstones_(std::move(range_tombstones)),
+          drop_deletions_(drop_deletions),
+          has_current_key_(false),
+          newer_sequence_(0) {}
+
+    bool Valid() const override { return input_->Valid(); }
+
+    void SeekToFirst() override {
+        input_->SeekToFirst();
+        has_current_key_ = false;
+        FindReadVersion();
+    }
+
+    void Seek(const std::string& target) override {
+        input_->Seek(target);
+        has_current_key_ = false;
+        FindReadVersion();
+    }
+
+    void Next() override {
+        input_->Next();
+        FindReadVersion();
+    }
+
+    std::string_view Key() const override { return input_->Key(); }
+
+    std::string_view Value() const override { return input_->Value(); }
+
+    uint64_t Sequence() const override { return input_->Sequence(); }
+
+    ValueType Type() const override { return input_->Type(); }
+
+private:
+    void FindReadVersion() {
+        while (input_->Valid()) {
+            const uint64_t sequence = input_->Sequence();
+            if (!has_current_key_ || input_->Key() != current_key_) {
+                current_key_.assign(input_->Key());
+                has_current_key_ = true;
+                newer_sequence_ = kMaxSequenceNumber;
+            }
+
+            // A version is read until a newer version or a range tombstone hides it
+            uint64_t hidden_at = newer_sequence_;
+            if (!range_tombstones_.empty()) {
+                hidden_at = std::min(hidden_at, NextCoveringSequence(range_tombstones_,
+                                                                     current_key_, sequence));
+            }
+            newer_sequence_ = sequence;
+
+            if (hidden_at == kMaxSequenceNumber) {
+                // Latest reads see this version; a deletion is only needed
+                // while something older may still be read
+                if (!drop_deletions_ || input_->Type() != ValueType::kDeletion ||
+                    SnapshotBelow(snapshots_, sequence)) {
+                    return;
+                }
+            } else if (SnapshotReads(snapshots_, sequence, hidden_at)) {
+                return;
+            }
+            input_->Next();
+        }
+    }
+
+    std::unique_ptr<Iterator> input_;
+    std::vector<uint64_t> snapshots_;
+    std::vector<RangeTombstone> range_tombstones_;
+    bool drop_deletions_;
+    std::string current_key_;
+    bool has_current_key_;
+    uint64_t newer_sequence_; // Sequence of the previous version of current_key_
+};
+
+size_t TotalSize(const std::vector<const SSTable*>& tables) {
+    size_t total_size = 0;
+    for (const auto* table : tables) {
+        total_size += table->GetSize();
+    }
+    return total_size;
+}
+
+} // namespace
+
+std::unique_ptr<Iterator> NewVersionFilterIterator(std::unique_ptr<Iterator> input,
+                                                   std::vector<uint64_t> snapshots,
+                                                   std::vector<RangeTombstone> range_tombstones,
+                                                   bool drop_deletions) {
+    return std::make_unique<VersionFilterIterator>(std::move(input), std::move(snapshots),
+                                                   std::move(range_tombstones), drop_deletions);
+}
+
+Compaction::Compaction(const std::string& base_path,
+                       const TableOptions& table_options,
+                       size_t target_file_size,
+                       size_t max_subcompactions)
+    : base_path_(base_path),
+      table_options_(table_options),
+      target_file_size_(std::max<size_t>(target_file_size, 1)),
+      max_subcompactions_(std::max<size_t>(max_subcompactions, 1)) {
     std::filesystem::create_directories(base_path);
+    if (max_subcompactions_ > 1) {
+        // The thread running a compaction merges one range itself
+        subcompaction_pool_ = std::make_unique<ThreadPool>(max_subcompactions_ - 1);
+    }
 }
 
 std::unique_ptr<SSTable> Compaction::Compact(
     const std::vector<std::unique_ptr<SSTable>>& input_tables,
-    int output_level) {
-    // Merge all entries from input tables
-    auto merged_entries = MergeTables(input_tables);
-    
-    // Remove duplicates and tombstones
-    RemoveDuplicates(&merged_entries);
-    
-    // Create new SSTable
-    std::string output_path = GenerateOutputPath(output_level);
-    return std::make_unique<SSTable>(output_path, merged_entries, output_level);
+    int output_level,
+    const std::vector<uint64_t>& snapshots,
+    bool bottommost) {
+    return CompactToSingleTable(RawTables(input_tables), output_level, snapshots, bottommost);
 }
 
-bool Compaction::ShouldCompact(
-    const std::vector<std::unique_ptr<SSTable>>& tables,
-    int level) const {
-    if (tables.empty()) {
-        return false;
+std::unique_ptr<SSTable> Compaction::Compact(
+    const std::vector<std::shared_ptr<SSTable>>& input_tables,
+    int output_level,
+    const std::vector<uint64_t>& snapshots,
+    bool bottommost) {
+    return CompactToSingleTable(RawTables(input_tables), output_level, snapshots, bottommost);
+}
+
+std::vector<std::unique_ptr<SSTable>> Compaction::CompactToLevel(
+    const std::vector<std::shared_ptr<SSTable>>& input_tables,
+    int output_level,
+    const std::vector<uint64_t>& snapshots,
+    bool bottommost) {
+    using Outputs = std::vector<std::unique_ptr<SSTable>>;
+    const std::vector<const SSTable*> tables = RawTables(input_tables);
+    const std::vector<std::string> splits = PickSubcompactionSplits(tables);
+    if (splits.empty()) {
+        return CompactTables(tables, output_level, target_file_size_, snapshots, bottommost);
     }
 
-    // Check if total size exceeds level's maximum size
-    size_t total_size = 0;
-    for (const auto& table : tables) {
-        total_size += table->GetSize();
+    // Range i covers [splits[i - 1], splits[i]); the outer ranges are open
+    const size_t num_ranges = splits.size() + 1;
+    auto compact_range = [&](size_t i) {
+        return CompactTables(tables, output_level, target_file_size_, snapshots, bottommost,
+                             i > 0 ? &splits[i - 1] : nullptr,
+                             i < splits.size() ? &splits[i] : nullptr);
+    };
+    std::vector<std::future<Outputs>> futures;
+    for (size_t i = 1; i < num_ranges; ++i) {
+        auto task = std::make_shared<std::packaged_task<Outputs()>>(
+            [&compact_range, i] { return compact_range(i); });
+        futures.push_back(task->get_future());
+        subcompaction_pool_->Schedule([task] { (*task)(); });
     }
 
-    return total_size > GetMaxSizeForLevel(level);
+    // Every range must finish before returning, since the tasks borrow this frame
+    std::vector<Outputs> results(num_ranges);
+    std::exception_ptr error;
+    for (size_t i = 0; i < num_ranges; ++i) {
+        try {
+            results[i] = i == 0 ? compact_range(0) : futures[i - 1].get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    Outputs outputs;
+    for (auto& result : results) {
+        for (auto& table : result) {
+            outputs.push_back(std::move(table));
+        }
+    }
+    if (error) {
+        for (const auto& table : outputs) {
+            table->MarkObsolete();
+        }
+        std::rethrow_exception(error);
+    }
+    return outputs;
 }
 
-size_t Compaction::GetMaxSizeForLevel(int level) {
-    return static_cast<size_t>(kBaseLevelSize * std::pow(kLevelSizeMultiplier, level));
+std::vector<std::string> Compaction::PickSubcompactionSplits(
+    const std::vector<const SSTable*>& input_tables) const {
+    const size_t num_ranges = std::min(max_subcompactions_,
+                                       TotalSize(input_tables) / target_file_size_);
+    if (num_ranges < 2) {
+        return {};
+    }
+
+    // Block boundaries of all inputs, so each range holds about as many blocks
+    std::vector<std::string> boundaries;
+    for (const auto* table : input_tables) {
+        std::vector<std::string> keys = table->GetIndexKeys();
+        boundaries.insert(boundaries.end(), std::make_move_iterator(keys.begin()),
+                          std::make_move_iterator(keys.end()));
+    }
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+    std::vector<std::string> splits;
+    for (size_t i = 1; i < num_ranges && !boundaries.empty(); ++i) {
+        const std::string& key = boundaries[i * boundaries.size() / num_ranges];
+        if (splits.empty() || splits.back() < key) {
+            splits.push_back(key);
+        }
+    }
+    return splits;
 }
 
-std::vector<Compaction::KeyValue> Compaction::MergeTables(
-    const std::vector<std::unique_ptr<SSTable>>& tables) {
-    std::vector<KeyValue> result;
-    
-    // Collect all entries from all tables
+std::vector<std::shared_ptr<SSTable>> Compaction::GetOverlappingTables(
+    const std::vector<std::shared_ptr<SSTable>>& tables,
+    const std::string& smallest_key,
+    const std::string& largest_key) {
+    std::vector<std::shared_ptr<SSTable>> result;
     for (const auto& table : tables) {
-        auto entries = table->GetRange(table->GetSmallestKey(), table->GetLargestKey());
-        for (const auto& [key, value] : entries) {
-            result.push_back({key, value, value.empty(), 0});
+        if (table->GetLargestKey() >= smallest_key && table->GetSmallestKey() <= largest_key) {
+            result.push_back(table);
         }
     }
-    
-    // Sort by key
-    std::sort(result.begin(), result.end(),
-        [](const KeyValue& a, const KeyValue& b) {
-            return a.key < b.key;
-        });
-    
     return result;
 }
 
-void Compaction::RemoveDuplicates(std::vector<KeyValue>* entries) {
-    if (entries->empty()) {
-        return;
+std::unique_ptr<SSTable> Compaction::CompactToSingleTable(
+    const std::vector<const SSTable*>& input_tables,
+    int output_level,
+    const std::vector<uint64_t>& snapshots,
+    bool bottommost) {
+    auto outputs = CompactTables(input_tables, output_level,
+                                 std::numeric_limits<size_t>::max(), snapshots, bottommost);
+    if (outputs.empty()) {
+        std::string output_path = GenerateOutputPath(output_level);
+        TableBuilder(output_path, output_level, table_options_).Finish();
+        return std::make_unique<SSTable>(output_path, table_options_);
+    }
+    return std::move(outputs.front());
+}
+
+std::vector<std::unique_ptr<SSTable>> Compaction::CompactTables(
+    const std::vector<const SSTable*>& input_tables,
+    int output_level,
+    size_t max_file_size,
+    const std::vector<uint64_t>& snapshots,
+    bool bottommost,
+    const std::string* start_key,
+    const std::string* end_key) {
+    std::vector<std::unique_ptr<Iterator>> children;
+    std::vector<RangeTombstone> range_tombstones;
+    children.reserve(input_tables.size());
+    for (const auto* table : input_tables) {
+        // Compaction reads every block once, so it would only evict hot blocks
+        children.push_back(table->NewIterator(false));
+        const auto& tombstones = table->GetRangeTombstones();
+        range_tombstones.insert(range_tombstones.end(), tombstones.begin(), tombstones.end());
+    }
+
+    // Range tombstones are written to the first output, clipped to this
+    // key range so that parallel ranges never write the same piece twice.
+    // Once nothing older is left below and no snapshot reads what they hide,
+    // they are dropped.
+    std::vector<RangeTombstone> output_tombstones;
+    for (RangeTombstone tombstone : range_tombstones) {
+        if (bottommost && !SnapshotBelow(snapshots, tombstone.sequence)) {
+            continue;
+        }
+        if (start_key && tombstone.begin < *start_key) {
+            tombstone.begin = *start_key;
+        }
+        if (end_key && *end_key < tombstone.end) {
+            tombstone.end = *end_key;
+        }
+        if (tombstone.begin < tombstone.end) {
+            output_tombstones.push_back(std::move(tombstone));
+        }
+    }
+
+    auto input = NewVersionFilterIterator(NewMergingIterator(std::move(children)), snapshots,
+                                          std::move(range_tombstones), bottommost);
+    if (start_key) {
+        input->Seek(*start_key);
+    } else {
+        input->SeekToFirst();
     }
 
-    std::vector<KeyValue> result;
-    result.push_back(entries->front());
-    
-    for (size_t i = 1; i < entries->size(); ++i) {
-        const auto& current = (*entries)[i];
-        const auto& last = result.back();
-        
-        if (current.key != last.key) {
-            result.push_back(current);
-        } else if (!current.is_tombstone) {
-            // Keep the latest non-tombstone value
-            result.back() = current;
+    std::vector<std::unique_ptr<SSTable>> outputs;
+    std::unique_ptr<TableBuilder> builder;
+    std::string output_path;
+    auto start_output = [&]() {
+        output_path = GenerateOutputPath(output_level);
+        builder = std::make_unique<TableBuilder>(output_path, output_level, table_options_);
+        for (const auto& tombstone : output_tombstones) {
+            builder->AddRangeTombstone(tombstone);
+        }
+        output_tombstones.clear();
+    };
+    auto finish_output = [&]() {
+        builder->Finish();
+        builder.reset();
+        outputs.push_back(std::make_unique<SSTable>(output_path, table_options_));
+    };
+
+    // Deletions are carried over so they keep shadowing older values below,
+    // unless the compaction is bottommost. Files are only cut between keys, so
+    // the outputs stay disjoint even when snapshots keep several versions of a key.
+    std::string last_key;
+    try {
+        for (; input->Valid() && (!end_key || input->Key() < *end_key); input->Next()) {
+            if (builder && builder->GetFileSize() >= max_file_size && input->Key() != last_key) {
+                finish_output();
+            }
+            if (!builder) {
+                start_output();
+            }
+            builder->Add(input->Key(), input->Value(), input->Sequence(), input->Type());
+            last_key.assign(input->Key());
+        }
+        if (!builder && !output_tombstones.empty()) {
+            start_output();
+        }
+        if (builder) {
+            finish_output();
         }
+    } catch (...) {
+        // Outputs that were finished are never installed; drop their files
+        for (const auto& table : outputs) {
+            table->MarkObsolete();
+        }
+        throw;
     }
-    
-    // Remove tombstones at the end
-    while (!result.empty() && result.back().is_tombstone) {
-        result.pop_back();
+    return outputs;
+}
+
+bool Compaction::ShouldCompact(
+    const std::vector<std::unique_ptr<SSTable>>& tables,
+    int level) const {
+    if (tables.empty()) {
+        return false;
     }
-    
-    *entries = std::move(result);
+
+    // Check if total size exceeds level's maximum size
+    return TotalSize(RawTables(tables)) > GetMaxSizeForLevel(level);
+}
+
+double Compaction::GetCompactionScore(
+    const std::vector<std::shared_ptr<SSTable>>& tables,
+    int level) {
+    return static_cast<double>(TotalSize(RawTables(tables))) /
+           static_cast<double>(GetMaxSizeForLevel(level));
+}
+
+size_t Compaction::GetMaxSizeForLevel(int level) {
+    return static_cast<size_t>(kBaseLevelSize * std::pow(kLevelSizeMultiplier, level));
 }
 
 std::string Compaction::GenerateOutputPath(int level) const {
+    std::string level_dir = base_path_ + "/level-" + std::to_string(level);
+    // Tables in a new level directory are only durable once its entry is
+    if (std::filesystem::create_directories(level_dir) && !SyncPath(base_path_)) {
+        throw std::runtime_error("Failed to sync directory: " + base_path_);
+    }
+
+    // The counter keeps names unique when outputs are generated back to back
+    static std::atomic<uint64_t> next_file_number{0};
     std::stringstream ss;
-    ss << base_path_ << "/level-" << level << "/sstable-"
-       << std::chrono::system_clock::now().time_since_epoch().count() << ".sst";
+    ss << level_dir << "/sstable-"
+       << std::chrono::system_clock::now().time_since_epoch().count() << "-"
+       << next_file_number.fetch_add(1, std::memory_order_relaxed) << ".sst";
     return ss.str();
 }
 
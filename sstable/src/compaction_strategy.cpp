@@ -0,0 +1,184 @@
+#include "compaction_strategy.h"
+#include "compaction.h"
+#include <algorithm>
+#include <functional>
+
+namespace sstable {
+
+namespace {
+
+class LeveledCompactionStrategy : public CompactionStrategy {
+public:
+    const char* Name() const override { return "Leveled"; }
+
+    bool PickCompaction(const LevelTables& levels,
+                        const std::set<int>& busy_levels,
+                        CompactionJob* job) override {
+        // Most urgent levels first
+        std::vector<std::pair<double, int>> candidates;
+        for (const auto& [level, tables] : levels) {
+            double score = Compaction::GetCompactionScore(tables, level);
+            if (score > 1.0) {
+                candidates.emplace_back(score, level);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), std::greater<>());
+
+        for (const auto& [score, level] : candidates) {
+            if (busy_levels.count(level) || busy_levels.count(level + 1)) {
+                continue;
+            }
+            job->level = level;
+            job->output_level = level + 1;
+            job->inputs = PickInputs(levels, level);
+            job->split_output = true;
+            if (level > 0) {
+                compact_pointers_[level] = job->inputs.back()->GetLargestKey();
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::shared_ptr<SSTable>> PickInputs(const LevelTables& levels,
+                                                     int level) const {
+        const auto& tables = levels.at(level);
+
+        // Level-0 files overlap each other, so they are compacted together;
+        // elsewhere one file is taken, resuming after the last compacted key
+        std::vector<std::shared_ptr<SSTable>> level_inputs;
+        if (level == 0) {
+            level_inputs = tables;
+        } else {
+            auto pointer = compact_pointers_.find(level);
+            auto it = tables.begin();
+            if (pointer != compact_pointers_.end()) {
+                it = std::find_if(tables.begin(), tables.end(),
+                    [&pointer](const std::shared_ptr<SSTable>& table) {
+                        return table->GetSmallestKey() > pointer->second;
+                    });
+                if (it == tables.end()) {
+                    it = tables.begin();
+                }
+            }
+            level_inputs.push_back(*it);
+        }
+
+        std::string smallest_key = level_inputs.front()->GetSmallestKey();
+        std::string largest_key = level_inputs.front()->GetLargestKey();
+        for (const auto& table : level_inputs) {
+            smallest_key = std::min(smallest_key, table->GetSmallestKey());
+            largest_key = std::max(largest_key, table->GetLargestKey());
+        }
+
+        // Next-level files are older than anything above them, so they go first
+        std::vector<std::shared_ptr<SSTable>> inputs;
+        auto next = levels.find(level + 1);
+        if (next != levels.end()) {
+            inputs = Compaction::GetOverlappingTables(next->second, smallest_key, largest_key);
+        }
+        inputs.insert(inputs.end(), level_inputs.begin(), level_inputs.end());
+        return inputs;
+    }
+
+    std::map<int, std::string> compact_pointers_; // Largest key last compacted per level
+};
+
+class UniversalCompactionStrategy : public CompactionStrategy {
+public:
+    explicit UniversalCompactionStrategy(const UniversalCompactionOptions& options)
+        : options_(options) {}
+
+    const char* Name() const override { return "Universal"; }
+
+    bool PickCompaction(const LevelTables& levels,
+                        const std::set<int>& busy_levels,
+                        CompactionJob* job) override {
+        auto it = levels.find(0);
+        if (busy_levels.count(0) || it == levels.end()) {
+            return false;
+        }
+        const auto& runs = it->second; // Oldest first
+        const size_t num_runs = runs.size();
+        if (num_runs < std::max<size_t>(options_.sorted_run_trigger, 2)) {
+            return false;
+        }
+
+        size_t first = 0;
+        size_t count = 0;
+        if (PickForSpaceAmplification(runs)) {
+            count = num_runs;
+        } else if (!PickBySizeRatio(runs, &first, &count)) {
+            // Too many runs of dissimilar sizes: merge the newest ones, just
+            // enough to drop below the trigger
+            count = num_runs - std::max<size_t>(options_.sorted_run_trigger, 2) + 2;
+            first = num_runs - count;
+        }
+
+        job->level = 0;
+        job->output_level = 0;
+        job->inputs.assign(runs.begin() + first, runs.begin() + first + count);
+        job->split_output = false;
+        return true;
+    }
+
+private:
+    // True when the runs newer than the oldest one take more extra space
+    // than allowed, so everything should be merged into a single run
+    bool PickForSpaceAmplification(const std::vector<std::shared_ptr<SSTable>>& runs) const {
+        size_t newer_size = 0;
+        for (size_t i = 1; i < runs.size(); ++i) {
+            newer_size += runs[i]->GetSize();
+        }
+        const size_t oldest_size = runs.front()->GetSize();
+        return newer_size * 100 > oldest_size * options_.max_size_amplification_percent;
+    }
+
+    // Starting from the newest run, grow a group towards older runs while
+    // each next run is not much larger than the group so far
+    bool PickBySizeRatio(const std::vector<std::shared_ptr<SSTable>>& runs,
+                         size_t* first, size_t* count) const {
+        const size_t min_width = std::max<size_t>(options_.min_merge_width, 2);
+        for (size_t end = runs.size(); end >= min_width; --end) {
+            size_t group_size = runs[end - 1]->GetSize();
+            size_t start = end - 1;
+            while (start > 0 && end - start < options_.max_merge_width) {
+                const size_t next_size = runs[start - 1]->GetSize();
+                if (next_size * 100 > group_size * (100 + options_.size_ratio)) {
+                    break;
+                }
+                group_size += next_size;
+                --start;
+            }
+            if (end - start >= min_width) {
+                *first = start;
+                *count = end - start;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    UniversalCompactionOptions options_;
+};
+
+} // namespace
+
+std::unique_ptr<CompactionStrategy> NewLeveledCompactionStrategy() {
+    return std::make_unique<LeveledCompactionStrategy>();
+}
+
+std::unique_ptr<CompactionStrategy> NewUniversalCompactionStrategy(
+    const UniversalCompactionOptions& options) {
+    return std::make_unique<UniversalCompactionStrategy>(options);
+}
+
+std::unique_ptr<CompactionStrategy> NewCompactionStrategy(const Options& options) {
+    if (options.compaction_style == CompactionStyle::kUniversal) {
+        return NewUniversalCompactionStrategy(options.universal_compaction);
+    }
+    return NewLeveledCompactionStrategy();
+}
+
+} // namespace sstable
\ No newline at end of file
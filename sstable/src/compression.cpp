@@ -0,0 +1,313 @@
+#include "compression.h"
+#include "coding.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#ifdef SSTABLE_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef SSTABLE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace sstable {
+
+namespace {
+
+constexpr const char* kLZCompressorName = "sstable.LZ";
+constexpr const char* kLZ4CompressorName = "sstable.LZ4";
+constexpr const char* kZstdCompressorName = "sstable.Zstd";
+
+// The built-in format is the raw length (varint) followed by sequences of
+// [token][extra literal length][literals][offset (2)][extra match length].
+// The token holds the literal length in its upper 4 bits and the match
+// length minus kMinMatch in its lower 4; a nibble of 15 continues in extra
+// bytes of 255 up to a final byte below 255. A last sequence with literals
+// only may end the input.
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 0xFFFF;
+constexpr int kMaxHashBits = 14;
+
+// Each input byte yields at most this many output bytes
+constexpr uint64_t kMaxExpansion = 255;
+
+uint32_t Load32(const char* ptr) {
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+void PutLength(std::string* dst, size_t length) {
+    for (; length >= 255; length -= 255) {
+        dst->push_back(static_cast<char>(255));
+    }
+    dst->push_back(static_cast<char>(length));
+}
+
+void EmitSequence(std::string* dst, const char* literals, size_t literal_len,
+                  size_t offset, size_t match_len) {
+    const size_t match_code = match_len ? match_len - kMinMatch : 0;
+    dst->push_back(static_cast<char>((std::min<size_t>(literal_len, 15) << 4) |
+                                     std::min<size_t>(match_code, 15)));
+    if (literal_len >= 15) {
+        PutLength(dst, literal_len - 15);
+    }
+    dst->append(literals, literal_len);
+    if (match_len == 0) {
+        return;
+    }
+    dst->push_back(static_cast<char>(offset & 0xFF));
+    dst->push_back(static_cast<char>(offset >> 8));
+    if (match_code >= 15) {
+        PutLength(dst, match_code - 15);
+    }
+}
+
+// Add the extra length bytes following a nibble of 15; false if truncated
+bool GetLength(const char** ptr, const char* limit, size_t* length) {
+    uint8_t byte;
+    do {
+        if (*ptr >= limit) {
+            return false;
+        }
+        byte = static_cast<uint8_t>(*(*ptr)++);
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+class LZCompressor : public Compressor {
+public:
+    const char* Name() const override { return kLZCompressorName; }
+
+    bool Compress(std::string_view input, std::string* output) const override {
+        const char* base = input.data();
+        const size_t n = input.size();
+        if (n > std::numeric_limits<uint32_t>::max()) {
+            return false;
+        }
+        output->clear();
+        PutVarint64(output, n);
+
+        // Small blocks get a small table, which is cheaper to clear
+        int hash_bits = 8;
+        while (hash_bits < kMaxHashBits && (size_t{1} << hash_bits) < n) {
+            ++hash_bits;
+        }
+        std::vector<uint32_t> table(size_t{1} << hash_bits, 0);
+
+        size_t anchor = 0;
+        size_t pos = 0;
+        while (pos + kMinMatch <= n) {
+            const uint32_t sequence = Load32(base + pos);
+            uint32_t& slot = table[(sequence * 2654435761u) >> (32 - hash_bits)];
+            const size_t candidate = slot;
+            slot = static_cast<uint32_t>(pos);
+
+            if (candidate < pos && pos - candidate <= kMaxOffset &&
+                Load32(base + candidate) == sequence) {
+                size_t length = kMinMatch;
+                while (pos + length < n && base[candidate + length] == base[pos + length]) {
+                    ++length;
+                }
+                EmitSequence(output, base + anchor, pos - anchor, pos - candidate, length);
+                pos += length;
+                anchor = pos;
+            } else {
+                // Step faster through data that keeps missing, such as
+                // already compressed values
+                pos += 1 + ((pos - anchor) >> 6);
+            }
+        }
+        if (anchor < n) {
+            EmitSequence(output, base + anchor, n - anchor, 0, 0);
+        }
+        return true;
+    }
+
+    bool Uncompress(std::string_view input, std::string* output) const override {
+        const char* ptr = input.data();
+        const char* limit = ptr + input.size();
+        uint64_t raw_size;
+        if (!(ptr = GetVarint64(ptr, limit, &raw_size)) ||
+            raw_size > static_cast<uint64_t>(limit - ptr) * kMaxExpansion) {
+            return false;
+        }
+        // Sized once up front; every copy below is checked against it
+        output->resize(raw_size);
+        char* out = output->data();
+        size_t pos = 0;
+
+        while (ptr < limit) {
+            const uint8_t token = static_cast<uint8_t>(*ptr++);
+            size_t literal_len = token >> 4;
+            if (literal_len == 15 && !GetLength(&ptr, limit, &literal_len)) {
+                return false;
+            }
+            if (static_cast<size_t>(limit - ptr) < literal_len || raw_size - pos < literal_len) {
+                return false;
+            }
+            std::memcpy(out + pos, ptr, literal_len);
+            pos += literal_len;
+            ptr += literal_len;
+            if (ptr == limit) {
+                break;
+            }
+
+            if (limit - ptr < 2) {
+                return false;
+            }
+            const size_t offset = static_cast<uint8_t>(ptr[0]) |
+                                  (static_cast<size_t>(static_cast<uint8_t>(ptr[1])) << 8);
+            ptr += 2;
+            size_t match_len = token & 0x0F;
+            if (match_len == 15 && !GetLength(&ptr, limit, &match_len)) {
+                return false;
+            }
+            match_len += kMinMatch;
+            if (offset == 0 || offset > pos || raw_size - pos < match_len) {
+                return false;
+            }
+            const char* from = out + pos - offset;
+            if (offset >= match_len) {
+                std::memcpy(out + pos, from, match_len);
+            } else {
+                // The match overlaps the bytes it produces, repeating the
+                // last offset bytes, so copy a byte at a time
+                for (size_t i = 0; i < match_len; ++i) {
+                    out[pos + i] = from[i];
+                }
+            }
+            pos += match_len;
+        }
+        return pos == raw_size;
+    }
+};
+
+#ifdef SSTABLE_HAVE_LZ4
+// The LZ4 block format does not record the raw length, so it is prepended
+// as a varint
+class LZ4Compressor : public Compressor {
+public:
+    const char* Name() const override { return kLZ4CompressorName; }
+
+    bool Compress(std::string_view input, std::string* output) const override {
+        if (input.size() > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+            return false;
+        }
+        const int input_size = static_cast<int>(input.size());
+        const int bound = LZ4_compressBound(input_size);
+        output->clear();
+        PutVarint64(output, input.size());
+        const size_t header = output->size();
+        output->resize(header + bound);
+        const int size = LZ4_compress_default(input.data(), &(*output)[header],
+                                              input_size, bound);
+        if (size <= 0) {
+            return false;
+        }
+        output->resize(header + size);
+        return true;
+    }
+
+    bool Uncompress(std::string_view input, std::string* output) const override {
+        const char* ptr = input.data();
+        const char* limit = ptr + input.size();
+        uint64_t raw_size;
+        if (!(ptr = GetVarint64(ptr, limit, &raw_size)) ||
+            raw_size > static_cast<uint64_t>(LZ4_MAX_INPUT_SIZE) ||
+            raw_size > static_cast<uint64_t>(limit - ptr) * kMaxExpansion) {
+            return false;
+        }
+        output->resize(raw_size);
+        const int size = LZ4_decompress_safe(ptr, &(*output)[0], static_cast<int>(limit - ptr),
+                                             static_cast<int>(raw_size));
+        return size >= 0 && static_cast<uint64_t>(size) == raw_size;
+    }
+};
+#endif
+
+#ifdef SSTABLE_HAVE_ZSTD
+class ZstdCompressor : public Compressor {
+public:
+    explicit ZstdCompressor(int level) : level_(level) {}
+
+    const char* Name() const override { return kZstdCompressorName; }
+
+    bool Compress(std::string_view input, std::string* output) const override {
+        output->resize(ZSTD_compressBound(input.size()));
+        const size_t size = ZSTD_compress(&(*output)[0], output->size(), input.data(),
+                                          input.size(), level_);
+        if (ZSTD_isError(size)) {
+            return false;
+        }
+        output->resize(size);
+        return true;
+    }
+
+    bool Uncompress(std::string_view input, std::string* output) const override {
+        // Frames written by ZSTD_compress record their raw size
+        const unsigned long long raw_size = ZSTD_getFrameContentSize(input.data(), input.size());
+        if (raw_size == ZSTD_CONTENTSIZE_ERROR || raw_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+            raw_size > std::numeric_limits<uint32_t>::max()) {
+            return false;
+        }
+        output->resize(raw_size);
+        const size_t size = ZSTD_decompress(&(*output)[0], output->size(), input.data(),
+                                            input.size());
+        return !ZSTD_isError(size) && size == raw_size;
+    }
+
+private:
+    int level_;
+};
+#endif
+
+} // namespace
+
+std::shared_ptr<const Compressor> NewLZCompressor() {
+    return std::make_shared<LZCompressor>();
+}
+
+std::shared_ptr<const Compressor> NewLZ4Compressor() {
+#ifdef SSTABLE_HAVE_LZ4
+    return std::make_shared<LZ4Compressor>();
+#else
+    return nullptr;
+#endif
+}
+
+std::shared_ptr<const Compressor> NewZstdCompressor(int level) {
+#ifdef SSTABLE_HAVE_ZSTD
+    return std::make_shared<ZstdCompressor>(level);
+#else
+    (void)level;
+    return nullptr;
+#endif
+}
+
+const Compressor* FindBuiltinCompressor(const std::string& name) {
+    static const LZCompressor lz;
+    if (name == kLZCompressorName) {
+        return &lz;
+    }
+#ifdef SSTABLE_HAVE_LZ4
+    static const LZ4Compressor lz4;
+    if (name == kLZ4CompressorName) {
+        return &lz4;
+    }
+#endif
+#ifdef SSTABLE_HAVE_ZSTD
+    // Decoding does not depend on the level
+    static const ZstdCompressor zstd(3);
+    if (name == kZstdCompressorName) {
+        return &zstd;
+    }
+#endif
+    return nullptr;
+}
+
+} // namespace sstable
\ No newline at end of file
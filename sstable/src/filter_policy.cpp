@@ -0,0 +1,72 @@
+#include "filter_policy.h"
+#include "bloom_filter.h"
+#include "xor_filter.h"
+
+namespace sstable {
+
+namespace {
+
+constexpr const char* kBloomFilterPolicyName = "sstable.BloomFilter";
+constexpr const char* kXorFilterPolicyName = "sstable.XorFilter8";
+
+class BloomFilterPolicy : public FilterPolicy {
+public:
+    explicit BloomFilterPolicy(size_t bits_per_key)
+        : bits_per_key_(bits_per_key) {}
+
+    const char* Name() const override { return kBloomFilterPolicyName; }
+
+    std::string CreateFilter(const std::vector<uint64_t>& key_hashes) const override {
+        BloomFilter filter(key_hashes.size() * bits_per_key_,
+                           BloomFilter::OptimalNumHashes(bits_per_key_));
+        for (uint64_t hash : key_hashes) {
+            filter.AddHash(hash);
+        }
+        return filter.Serialize();
+    }
+
+    std::unique_ptr<Filter> LoadFilter(const std::string& data) const override {
+        return BloomFilter::Deserialize(data);
+    }
+
+private:
+    size_t bits_per_key_;
+};
+
+class XorFilterPolicy : public FilterPolicy {
+public:
+    const char* Name() const override { return kXorFilterPolicyName; }
+
+    std::string CreateFilter(const std::vector<uint64_t>& key_hashes) const override {
+        return XorFilter::Build(key_hashes)->Serialize();
+    }
+
+    std::unique_ptr<Filter> LoadFilter(const std::string& data) const override {
+        return XorFilter::Deserialize(data);
+    }
+};
+
+} // namespace
+
+std::shared_ptr<const FilterPolicy> NewBloomFilterPolicy(size_t bits_per_key) {
+    return std::make_shared<BloomFilterPolicy>(bits_per_key);
+}
+
+std::shared_ptr<const FilterPolicy> NewXorFilterPolicy() {
+    return std::make_shared<XorFilterPolicy>();
+}
+
+const FilterPolicy* FindBuiltinFilterPolicy(const std::string& name) {
+    // Loading does not depend on the bits per key
+    static const BloomFilterPolicy bloom(10);
+    static const XorFilterPolicy xor_filter;
+    if (name == kBloomFilterPolicyName) {
+        return &bloom;
+    }
+    if (name == kXorFilterPolicyName) {
+        return &xor_filter;
+    }
+    return nullptr;
+}
+
+} // namespace sstable
\ No newline at end of file
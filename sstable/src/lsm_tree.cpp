@@ -1,171 +1,1411 @@
 #include "lsm_tree.h"
+#include "coding.h"
+#include "block_cache.h"
+#include "table_cache.h"
+#include "prefix_extractor.h"
+#include "merging_iterator.h"
+#include "table_builder.h"
+#include "random_access_file.h"
 #include <filesystem>
 #include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <limits>
+#include <stdexcept>
 
 namespace sstable {
 
+namespace {
+
+// Upper bound on the bytes a group-commit leader folds into one log record
+constexpr size_t kMaxGroupSize = 1 << 20; // 1MB
+
+constexpr const char* kLogPrefix = "wal-";
+constexpr const char* kLogSuffix = ".log";
+constexpr const char* kManifestName = "MANIFEST";
+constexpr const char* kLevelDirPrefix = "level-";
+
+// LSMTree decides when to switch MemTables from options_.memtable_size, so its
+// MemTables never reject a write that has already been logged
+std::shared_ptr<MemTable> NewMemTable(const Options& options) {
+    return std::make_shared<MemTable>(std::numeric_limits<size_t>::max(),
+                                      options.table_options.prefix_extractor);
+}
+
+Options MakeOptions(size_t memtable_size) {
+    Options options;
+    options.memtable_size = memtable_size;
+    return options;
+}
+
+// Give the tree its own block and table caches unless the caller shares them
+Options SanitizeOptions(const Options& options) {
+    Options result = options;
+    if (!result.table_options.block_cache && result.block_cache_size > 0) {
+        result.table_options.block_cache = std::make_shared<BlockCache>(result.block_cache_size);
+    }
+    if (!result.table_options.table_cache) {
+        result.table_options.table_cache = std::make_shared<TableCache>(result.max_open_files);
+    }
+    return result;
+}
+
+// Returns true and sets *number if filename is a log file name
+bool ParseLogNumber(const std::string& filename, uint64_t* number) {
+    const std::string prefix = kLogPrefix;
+    const std::string suffix = kLogSuffix;
+    if (filename.size() <= prefix.size() + suffix.size() ||
+        filename.compare(0, prefix.size(), prefix) != 0 ||
+        filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return false;
+    }
+    std::string digits = filename.substr(
+        prefix.size(), filename.size() - prefix.size() - suffix.size());
+    if (!std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+        return false;
+    }
+    *number = std::stoull(digits);
+    return true;
+}
+
+// Number of a log file given its path
+uint64_t LogNumberOf(const std::string& path) {
+    uint64_t number = 0;
+    ParseLogNumber(std::filesystem::path(path).filename().string(), &number);
+    return number;
+}
+
+// Every table file in dir and its level-N subdirectories
+std::vector<std::string> ListTableFiles(const std::string& dir) {
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.is_directory() &&
+            entry.path().filename().string().rfind(kLevelDirPrefix, 0) == 0) {
+            for (const auto& file : std::filesystem::directory_iterator(entry.path())) {
+                if (file.is_regular_file() && file.path().extension() == ".sst") {
+                    paths.push_back(file.path().string());
+                }
+            }
+        } else if (entry.is_regular_file() && entry.path().extension() == ".sst") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    return paths;
+}
+
+bool TableMayContain(const SSTable& table, const std::string& key) {
+    return table.GetSmallestKey() <= key && key <= table.GetLargestKey();
+}
+
+// Binary search a level sorted by key with disjoint ranges for the only
+// table that may hold key; nullptr if the key falls between tables
+std::shared_ptr<SSTable> FindTableInLevel(
+    const std::vector<std::shared_ptr<SSTable>>& tables, const std::string& key) {
+    auto it = std::lower_bound(tables.begin(), tables.end(), key,
+        [](const std::shared_ptr<SSTable>& table, const std::string& k) {
+            return table->GetLargestKey() < k;
+        });
+    if (it == tables.end() || (*it)->GetSmallestKey() > key) {
+        return nullptr;
+    }
+    return *it;
+}
+
+// Insert a table into a level sorted by key with disjoint ranges
+void InsertByKey(std::vector<std::shared_ptr<SSTable>>* tables, std::shared_ptr<SSTable> table) {
+    auto it = std::upper_bound(tables->begin(), tables->end(), table->GetSmallestKey(),
+        [](const std::string& key, const std::shared_ptr<SSTable>& t) {
+            return key < t->GetSmallestKey();
+        });
+    tables->insert(it, std::move(table));
+}
+
+bool TableOverlaps(const SSTable& table, const std::string* start_key,
+                   const std::string* end_key) {
+    return (!start_key || table.GetLargestKey() >= *start_key) &&
+           (!end_key || table.GetSmallestKey() <= *end_key);
+}
+
+// Walks a level sorted by key with disjoint ranges as one source, opening
+// only the table under the cursor
+class LevelIterator : public Iterator {
+public:
+    explicit LevelIterator(std::vector<std::shared_ptr<SSTable>> tables)
+        : tables_(std::move(tables)), table_index_(0) {}
+
+    bool Valid() const override { return current_ && current_->Valid(); }
+
+    void SeekToFirst() override {
+        OpenTable(0);
+        if (current_) {
+            current_->SeekToFirst();
+        }
+        SkipExhaustedTables();
+    }
+
+    void Seek(const std::string& target) override {
+        auto it = std::lower_bound(tables_.begin(), tables_.end(), target,
+            [](const std::shared_ptr<SSTable>& table, const std::string& k) {
+                return table->GetLargestKey() < k;
+            });
+        OpenTable(static_cast<size_t>(it - tables_.begin()));
+        if (current_) {
+            current_->Seek(target);
+        }
+        SkipExhaustedTables();
+    }
+
+    void Next() override {
+        current_->Next();
+        SkipExhaustedTables();
+    }
+
+    std::string_view Key() const override { return current_->Key(); }
+
+    std::string_view Value() const override { return current_->Value(); }
+
+    uint64_t Sequence() const override { return current_->Sequence(); }
+
+    ValueType Type() const override { return current_->Type(); }
+
+private:
+    void OpenTable(size_t index) {
+        table_index_ = index;
+        current_ = index < tables_.size() ? tables_[index]->NewIterator() : nullptr;
+    }
+
+    void SkipExhaustedTables() {
+        while (current_ && !current_->Valid()) {
+            OpenTable(table_index_ + 1);
+            if (current_) {
+                current_->SeekToFirst();
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<SSTable>> tables_;
+    size_t table_index_;
+    std::unique_ptr<Iterator> current_;
+};
+
+// Merges a snapshot of the tree's sources and yields the newest version of
+// each key at a sequence number, hiding deleted keys. The snapshot keeps its
+// MemTables and tables alive for as long as it is used.
+class TreeIterator : public Iterator {
+public:
+    TreeIterator(std::vector<std::shared_ptr<const MemTable>> memtables,
+                 std::vector<std::shared_ptr<SSTable>> tables,
+                 std::unique_ptr<Iterator> merged,
+                 std::vector<std::shared_ptr<const FragmentedRangeTombstones>> range_tombstones,
+                 uint64_t sequence)
+        : memtables_(std::move(memtables)),
+          tables_(std::move(tables)),
+          merged_(std::move(merged)),
+          range_tombstones_(std::move(range_tombstones)),
+          sequence_(sequence) {}
+
+    bool Valid() const override { return merged_->Valid(); }
+
+    void SeekToFirst() override {
+        merged_->SeekToFirst();
+        FindVisibleEntry();
+    }
+
+    void Seek(const std::string& target) override {
+        merged_->Seek(target);
+        FindVisibleEntry();
+    }
+
+    void Next() override {
+        SkipCurrentKey();
+        FindVisibleEntry();
+    }
+
+    std::string_view Key() const override { return merged_->Key(); }
+
+    std::string_view Value() const override { return merged_->Value(); }
+
+    uint64_t Sequence() const override { return merged_->Sequence(); }
+
+    ValueType Type() const override { return merged_->Type(); }
+
+private:
+    // Stop at the newest version at or below sequence_ unless it is a
+    // deletion or a range tombstone covers it, which hides the whole key
+    void FindVisibleEntry() {
+        while (merged_->Valid()) {
+            if (merged_->Sequence() > sequence_) {
+                merged_->Next();
+            } else if (merged_->Type() == ValueType::kDeletion ||
+                       MaxCoveringSequence(merged_->Key()) > merged_->Sequence()) {
+                SkipCurrentKey();
+            } else {
+                return;
+            }
+        }
+    }
+
+    uint64_t MaxCoveringSequence(std::string_view key) const {
+        uint64_t result = 0;
+        for (const auto& tombstones : range_tombstones_) {
+            result = std::max(result, tombstones->MaxCoveringSequence(key, sequence_));
+        }
+        return result;
+    }
+
+    void SkipCurrentKey() {
+        current_key_.assign(merged_->Key());
+        do {
+            merged_->Next();
+        } while (merged_->Valid() && merged_->Key() == current_key_);
+    }
+
+    std::vector<std::shared_ptr<const MemTable>> memtables_;
+    std::vector<std::shared_ptr<SSTable>> tables_;
+    std::unique_ptr<Iterator> merged_; // Declared after the sources so it is destroyed first
+    std::vector<std::shared_ptr<const FragmentedRangeTombstones>> range_tombstones_;
+    uint64_t sequence_;
+    std::string current_key_;
+};
+
+} // namespace
+
+struct LSMTree::Writer {
+    explicit Writer(const WriteBatch* b) : batch(b) {}
+
+    const WriteBatch* batch;
+    bool done = false;
+    bool ok = false;
+    std::condition_variable cv;
+};
+
 LSMTree::LSMTree(const std::string& base_path, size_t memtable_size)
+    : LSMTree(base_path, MakeOptions(memtable_size)) {}
+
+LSMTree::LSMTree(const std::string& base_path, const Options& options)
     : base_path_(base_path),
-      memtable_(std::make_unique<MemTable>(memtable_size)),
-      compaction_(std::make_unique<Compaction>(base_path)) {
+      options_(SanitizeOptions(options)),
+      memtable_(NewMemTable(options_)),
+      next_log_number_(1),
+      log_number_(0),
+      last_sequence_(0),
+      compaction_(std::make_unique<Compaction>(base_path, options_.table_options,
+                                               options_.target_file_size,
+                                               options_.max_subcompactions)),
+      compaction_strategy_(NewCompactionStrategy(options_)),
+      shutting_down_(false),
+      background_error_(false),
+      pending_compactions_(0),
+      compaction_pool_(std::make_unique<ThreadPool>(options.max_background_compactions)) {
+    if (options_.max_multiget_threads > 1) {
+        // The thread calling MultiGet probes one table itself
+        multiget_pool_ = std::make_unique<ThreadPool>(options_.max_multiget_threads - 1);
+    }
     std::filesystem::create_directories(base_path);
     LoadExistingSSTables();
-}
+    WriteManifestSnapshot();
+    RecoverLogs();
+    if (!NewLog()) {
+        throw std::runtime_error("Failed to sync directory: " + base_path_);
+    }
+    flush_thread_ = std::thread(&LSMTree::BackgroundFlush, this);
 
-bool LSMTree::Put(const std::string& key, const std::string& value) {
     std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (CheckMemTableFull()) {
-        SwitchMemTable();
+    MaybeScheduleCompaction();
+}
+
+LSMTree::~LSMTree() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutting_down_ = true;
     }
-    
-    return memtable_->Put(key, value);
+    flush_cv_.notify_all();
+    flush_done_cv_.notify_all();
+    flush_thread_.join();
+
+    // Lets queued and running compactions finish and install their output
+    compaction_pool_.reset();
 }
 
-bool LSMTree::Get(const std::string& key, std::string* value) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    // Check MemTable first
-    if (memtable_->Get(key, value)) {
+bool LSMTree::Put(const std::string& key, const std::string& value) {
+    WriteBatch batch;
+    batch.Put(key, value);
+    return Write(batch);
+}
+
+bool LSMTree::Write(const WriteBatch& batch) {
+    if (batch.Count() == 0) {
         return true;
     }
-    
-    // Check immutable MemTable if it exists
-    if (immutable_memtable_ && immutable_memtable_->Get(key, value)) {
-        return true;
+    return WriteImpl(&batch);
+}
+
+bool LSMTree::WriteImpl(const WriteBatch* batch) {
+    Writer w(batch);
+    std::unique_lock<std::mutex> lock(mutex_);
+    writers_.push_back(&w);
+    while (!w.done && &w != writers_.front()) {
+        w.cv.wait(lock);
     }
-    
-    // Check SSTables from newest to oldest
-    for (auto level_it = levels_.rbegin(); level_it != levels_.rend(); ++level_it) {
-        for (auto table_it = level_it->second.rbegin(); table_it != level_it->second.rend(); ++table_it) {
-            if ((*table_it)->Get(key, value)) {
-                return true;
+    if (w.done) {
+        return w.ok;
+    }
+
+    // A flush request switches out the MemTable on its own
+    if (!w.batch) {
+        bool ok = MakeRoomForWrite(&lock, 0, true);
+        writers_.pop_front();
+        if (!writers_.empty()) {
+            writers_.front()->cv.notify_one();
+        }
+        return ok;
+    }
+
+    // This writer is the leader: fold the batches of everyone queued behind
+    // it into a single log record. Their operations take the next sequence
+    // numbers in order; only the leader assigns them.
+    WriteBatch group;
+    group.SetSequence(last_sequence_ + 1);
+    Writer* last_writer = &w;
+    for (Writer* writer : writers_) {
+        if (writer != &w &&
+            (!writer->batch ||
+             group.ApproximateSize() + writer->batch->ApproximateSize() > kMaxGroupSize)) {
+            break;
+        }
+        group.Append(*writer->batch);
+        last_writer = writer;
+    }
+
+    bool ok = MakeRoomForWrite(&lock, group.ApproximateSize(), false);
+    if (ok) {
+        // Only the leader touches the log, so the I/O can run without the lock;
+        // later writers keep queueing up for the next group meanwhile.
+        lock.unlock();
+        ok = wal_->AddRecord(group.Contents());
+        lock.lock();
+        if (!ok) {
+            // The record may be torn, and recovery stops at the first bad
+            // record, so nothing may be appended after it. The writes of
+            // this group may or may not survive a restart.
+            background_error_ = true;
+            flush_done_cv_.notify_all();
+        }
+    }
+
+    if (ok) {
+        ok = ApplyBatch(group);
+    }
+
+    while (true) {
+        Writer* ready = writers_.front();
+        writers_.pop_front();
+        if (ready != &w) {
+            ready->ok = ok;
+            ready->done = true;
+            ready->cv.notify_one();
+        }
+        if (ready == last_writer) {
+            break;
+        }
+    }
+
+    if (!writers_.empty()) {
+        writers_.front()->cv.notify_one();
+    }
+    return ok;
+}
+
+bool LSMTree::ApplyBatch(const WriteBatch& batch) {
+    // Batches logged before sequence numbers existed continue from the last one
+    const uint64_t sequence = batch.Sequence() != 0 ? batch.Sequence() : last_sequence_ + 1;
+    const bool ok = memtable_->Apply(batch, sequence);
+
+    // Readers only see the operations once the last sequence number covers them
+    if (batch.Count() > 0) {
+        last_sequence_ = std::max(last_sequence_, sequence + batch.Count() - 1);
+    }
+    return ok;
+}
+
+bool LSMTree::Get(const std::string& key, std::string* value, const Snapshot* snapshot) {
+    std::vector<std::shared_ptr<const MemTable>> memtables;
+    std::shared_ptr<const FragmentedRangeTombstones> table_tombstones;
+    std::vector<std::shared_ptr<SSTable>> tables;
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sequence = snapshot ? snapshot->sequence_ : last_sequence_;
+
+        // Snapshot the sources that may hold the key, newest first: the
+        // MemTables, level-0 files covering it from the most recent down,
+        // then at most one file from each sorted level
+        memtables.push_back(memtable_);
+        for (auto it = immutable_memtables_.rbegin(); it != immutable_memtables_.rend(); ++it) {
+            memtables.push_back(it->memtable);
+        }
+        table_tombstones = table_tombstones_;
+        for (const auto& [level, level_tables] : levels_) {
+            if (level == 0) {
+                for (auto it = level_tables.rbegin(); it != level_tables.rend(); ++it) {
+                    if (TableMayContain(**it, key)) {
+                        tables.push_back(*it);
+                    }
+                }
+            } else if (auto table = FindTableInLevel(level_tables, key)) {
+                tables.push_back(std::move(table));
             }
         }
     }
-    
+
+    // Reads happen without the lock: MemTables are read lock-free and the
+    // snapshot keeps every source alive.
+    // Newest range tombstone covering the key; versions below it are deleted.
+    // Range tombstones may sit in any source, whatever its key range.
+    uint64_t tombstone =
+        table_tombstones ? table_tombstones->MaxCoveringSequence(key, sequence) : 0;
+    for (const auto& memtable : memtables) {
+        tombstone = std::max(tombstone, memtable->MaxCoveringSequence(key, sequence));
+    }
+
+    // Newer sources hold newer versions, so the first version found wins;
+    // a table that cannot be read throws rather than letting an older
+    // version through.
+    ValueType type;
+    uint64_t found_sequence;
+    for (const auto& memtable : memtables) {
+        if (memtable->Find(key, sequence, value, &type, &found_sequence)) {
+            return type == ValueType::kValue && found_sequence >= tombstone;
+        }
+    }
+    for (const auto& table : tables) {
+        if (table->Find(key, sequence, value, &type, &found_sequence)) {
+            return type == ValueType::kValue && found_sequence >= tombstone;
+        }
+    }
+
     return false;
 }
 
-bool LSMTree::Delete(const std::string& key) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (CheckMemTableFull()) {
-        SwitchMemTable();
+std::vector<bool> LSMTree::MultiGet(const std::vector<std::string>& keys,
+                                    std::vector<std::string>* values,
+                                    const Snapshot* snapshot) {
+    values->assign(keys.size(), std::string());
+    std::vector<bool> found(keys.size(), false);
+    if (keys.empty()) {
+        return found;
+    }
+
+    // Probe each distinct key once, in key order
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+        return keys[a] < keys[b];
+    });
+    std::vector<KeyLookup> lookups;
+    std::vector<size_t> lookup_of(keys.size());
+    for (size_t i : order) {
+        if (lookups.empty() || *lookups.back().key != keys[i]) {
+            lookups.emplace_back();
+            lookups.back().key = &keys[i];
+        }
+        lookup_of[i] = lookups.size() - 1;
+    }
+
+    // Groups of tables to probe in turn, newest first: each level-0 file
+    // covering some key on its own, then the tables of each sorted level
+    // that may hold a key
+    std::vector<std::shared_ptr<const MemTable>> memtables;
+    std::shared_ptr<const FragmentedRangeTombstones> table_tombstones;
+    std::vector<std::vector<std::shared_ptr<SSTable>>> groups;
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sequence = snapshot ? snapshot->sequence_ : last_sequence_;
+        memtables.push_back(memtable_);
+        for (auto it = immutable_memtables_.rbegin(); it != immutable_memtables_.rend(); ++it) {
+            memtables.push_back(it->memtable);
+        }
+        table_tombstones = table_tombstones_;
+
+        const std::string& smallest_key = *lookups.front().key;
+        const std::string& largest_key = *lookups.back().key;
+        for (const auto& [level, level_tables] : levels_) {
+            if (level == 0) {
+                for (auto it = level_tables.rbegin(); it != level_tables.rend(); ++it) {
+                    if (TableOverlaps(**it, &smallest_key, &largest_key)) {
+                        groups.push_back({*it});
+                    }
+                }
+            } else {
+                std::vector<std::shared_ptr<SSTable>> group;
+                for (const auto& lookup : lookups) {
+                    auto table = FindTableInLevel(level_tables, *lookup.key);
+                    if (table && (group.empty() || group.back() != table)) {
+                        group.push_back(std::move(table));
+                    }
+                }
+                if (!group.empty()) {
+                    groups.push_back(std::move(group));
+                }
+            }
+        }
     }
-    
-    return memtable_->Delete(key);
+
+    // Range tombstones may sit in any source, whatever its key range
+    std::vector<uint64_t> tombstones(lookups.size(), 0);
+    for (size_t i = 0; i < lookups.size(); ++i) {
+        if (table_tombstones) {
+            tombstones[i] = table_tombstones->MaxCoveringSequence(*lookups[i].key, sequence);
+        }
+        for (const auto& memtable : memtables) {
+            tombstones[i] = std::max(tombstones[i],
+                                     memtable->MaxCoveringSequence(*lookups[i].key, sequence));
+        }
+    }
+
+    // MemTables from newest to oldest; they are read lock-free
+    for (const auto& memtable : memtables) {
+        for (auto& lookup : lookups) {
+            if (!lookup.found) {
+                lookup.found = memtable->Find(*lookup.key, sequence, &lookup.value,
+                                              &lookup.type, &lookup.found_sequence);
+            }
+        }
+    }
+
+    // Disk reads happen without the lock; the groups keep tables alive
+    std::vector<KeyLookup*> pending;
+    for (auto& lookup : lookups) {
+        if (!lookup.found) {
+            pending.push_back(&lookup);
+        }
+    }
+    for (const auto& group : groups) {
+        if (pending.empty()) {
+            break;
+        }
+
+        // Hand every table the pending keys inside its range; the tables of
+        // a sorted level are disjoint, so each key goes to at most one
+        std::vector<std::pair<const SSTable*, std::vector<KeyLookup*>>> probes;
+        size_t next = 0;
+        for (const auto& table : group) {
+            while (next < pending.size() && *pending[next]->key < table->GetSmallestKey()) {
+                ++next;
+            }
+            std::vector<KeyLookup*> table_lookups;
+            while (next < pending.size() && *pending[next]->key <= table->GetLargestKey()) {
+                table_lookups.push_back(pending[next++]);
+            }
+            if (!table_lookups.empty()) {
+                probes.emplace_back(table.get(), std::move(table_lookups));
+            }
+        }
+
+        std::vector<std::future<void>> futures;
+        if (multiget_pool_) {
+            for (size_t i = 1; i < probes.size(); ++i) {
+                auto task = std::make_shared<std::packaged_task<void()>>(
+                    [&probe = probes[i], sequence] {
+                        probe.first->MultiFind(probe.second, sequence);
+                    });
+                futures.push_back(task->get_future());
+                multiget_pool_->Schedule([task] { (*task)(); });
+            }
+        }
+        // A table that cannot be read fails the whole call; its keys must not
+        // fall through to older tables, which may hold overwritten values
+        std::exception_ptr error;
+        try {
+            for (size_t i = 0; i < probes.size(); ++i) {
+                if (i == 0 || !multiget_pool_) {
+                    probes[i].first->MultiFind(probes[i].second, sequence);
+                }
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // Every probe must finish before a failure is reported, since they
+        // borrow this frame
+        for (auto& future : futures) {
+            future.wait();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                     [](const KeyLookup* lookup) { return lookup->found; }),
+                      pending.end());
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const size_t l = lookup_of[i];
+        const KeyLookup& lookup = lookups[l];
+        if (lookup.found && lookup.type == ValueType::kValue &&
+            lookup.found_sequence >= tombstones[l]) {
+            (*values)[i] = lookup.value;
+            found[i] = true;
+        }
+    }
+    return found;
+}
+
+bool LSMTree::Delete(const std::string& key) {
+    WriteBatch batch;
+    batch.Delete(key);
+    return Write(batch);
+}
+
+bool LSMTree::DeleteRange(const std::string& begin_key, const std::string& end_key) {
+    WriteBatch batch;
+    batch.DeleteRange(begin_key, end_key);
+    return Write(batch);
 }
 
 std::vector<std::pair<std::string, std::string>> LSMTree::GetRange(
     const std::string& start_key,
-    const std::string& end_key) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string& end_key,
+    const Snapshot* snapshot) {
     std::vector<std::pair<std::string, std::string>> result;
-    
-    // Get entries from MemTable
-    auto memtable_entries = memtable_->GetAllEntries();
-    result.insert(result.end(), memtable_entries.begin(), memtable_entries.end());
-    
-    // Get entries from immutable MemTable if it exists
-    if (immutable_memtable_) {
-        auto immutable_entries = immutable_memtable_->GetAllEntries();
-        result.insert(result.end(), immutable_entries.begin(), immutable_entries.end());
-    }
-    
-    // Get entries from SSTables
-    for (const auto& [level, tables] : levels_) {
-        for (const auto& table : tables) {
-            auto table_entries = table->GetRange(start_key, end_key);
-            result.insert(result.end(), table_entries.begin(), table_entries.end());
-        }
+    auto it = NewRangeIterator(&start_key, &end_key, snapshot);
+    for (it->Seek(start_key); it->Valid() && it->Key() <= end_key; it->Next()) {
+        result.emplace_back(it->Key(), it->Value());
     }
-    
-    // Sort and remove duplicates
-    std::sort(result.begin(), result.end());
-    result.erase(std::unique(result.begin(), result.end()), result.end());
-    
     return result;
 }
 
-void LSMTree::FlushMemTable() {
+std::unique_ptr<Iterator> LSMTree::NewIterator(const Snapshot* snapshot) {
+    return NewRangeIterator(nullptr, nullptr, snapshot);
+}
+
+std::unique_ptr<Iterator> LSMTree::NewRangeIterator(const std::string* start_key,
+                                                    const std::string* end_key,
+                                                    const Snapshot* snapshot) {
+    // A scan confined to one prefix skips sources whose filters rule it out
+    std::string_view prefix;
+    const PrefixExtractor* extractor = options_.table_options.prefix_extractor.get();
+    const bool prefix_scan = extractor && start_key && end_key &&
+                             GetScanPrefix(*extractor, *start_key, *end_key, &prefix);
+
+    // Children are ordered oldest first: sorted levels from the deepest up,
+    // then level-0 files, immutable MemTables and the live MemTable. Only
+    // the source lists are copied under the lock; prefix filters and table
+    // iterators may load a table from disk, so they come after.
+    std::vector<std::vector<std::shared_ptr<SSTable>>> sorted_levels;
+    std::vector<std::shared_ptr<SSTable>> level0_tables;
+    std::vector<std::shared_ptr<const MemTable>> memtables;
+    std::vector<std::unique_ptr<Iterator>> children;
+    // Range tombstones may sit in any source, whatever its key range: those
+    // of the tables come indexed, those of the MemTables are indexed below
+    std::vector<std::shared_ptr<const FragmentedRangeTombstones>> range_tombstones;
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sequence = snapshot ? snapshot->sequence_ : last_sequence_;
+        if (table_tombstones_) {
+            range_tombstones.push_back(table_tombstones_);
+        }
+
+        for (auto it = levels_.rbegin(); it != levels_.rend(); ++it) {
+            const auto& [level, level_tables] = *it;
+            std::vector<std::shared_ptr<SSTable>> overlapping;
+            for (const auto& table : level_tables) {
+                if (TableOverlaps(*table, start_key, end_key)) {
+                    overlapping.push_back(table);
+                }
+            }
+            if (level == 0) {
+                level0_tables = std::move(overlapping);
+            } else if (!overlapping.empty()) {
+                sorted_levels.push_back(std::move(overlapping));
+            }
+        }
+
+        for (const auto& immutable : immutable_memtables_) {
+            memtables.push_back(immutable.memtable);
+        }
+        memtables.push_back(memtable_);
+    }
+
+    auto may_hold_prefix = [&](const SSTable& table) {
+        return !prefix_scan || table.PrefixMayMatch(prefix);
+    };
+    for (const auto& level_tables : sorted_levels) {
+        std::vector<std::shared_ptr<SSTable>> matching;
+        for (const auto& table : level_tables) {
+            if (may_hold_prefix(*table)) {
+                matching.push_back(table);
+            }
+        }
+        if (!matching.empty()) {
+            children.push_back(std::make_unique<LevelIterator>(std::move(matching)));
+        }
+    }
+    std::vector<std::shared_ptr<SSTable>> tables;
+    for (auto& table : level0_tables) {
+        if (may_hold_prefix(*table)) {
+            children.push_back(table->NewIterator());
+            tables.push_back(std::move(table));
+        }
+    }
+
+    std::vector<RangeTombstone> memtable_tombstones;
+    for (const auto& memtable : memtables) {
+        for (auto& tombstone : memtable->GetRangeTombstones()) {
+            if (tombstone.sequence <= sequence &&
+                (!start_key || tombstone.end > *start_key) &&
+                (!end_key || tombstone.begin <= *end_key)) {
+                memtable_tombstones.push_back(std::move(tombstone));
+            }
+        }
+        if (!prefix_scan || memtable->PrefixMayMatch(prefix)) {
+            children.push_back(memtable->NewIterator());
+        }
+    }
+    if (!memtable_tombstones.empty()) {
+        range_tombstones.push_back(
+            std::make_shared<const FragmentedRangeTombstones>(memtable_tombstones));
+    }
+
+    return std::make_unique<TreeIterator>(std::move(memtables), std::move(tables),
+                                          NewMergingIterator(std::move(children)),
+                                          std::move(range_tombstones), sequence);
+}
+
+const Snapshot* LSMTree::GetSnapshot() {
     std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (!immutable_memtable_) {
+    snapshots_.insert(last_sequence_);
+    return new Snapshot(last_sequence_);
+}
+
+void LSMTree::ReleaseSnapshot(const Snapshot* snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshots_.erase(snapshots_.find(snapshot->sequence_));
+    }
+    delete snapshot;
+}
+
+std::vector<uint64_t> LSMTree::LiveSnapshots() const {
+    return std::vector<uint64_t>(snapshots_.begin(), snapshots_.end());
+}
+
+void LSMTree::FlushMemTable() {
+    // Go through the writer queue so the switch is ordered with in-flight writes
+    if (!WriteImpl(nullptr)) {
         return;
     }
-    
-    // Create new SSTable from immutable MemTable
-    auto entries = immutable_memtable_->GetAllEntries();
-    auto new_table = std::make_unique<SSTable>(
-        compaction_->GenerateOutputPath(0),
-        entries,
-        0);
-    
-    // Add to level 0
-    AddSSTable(std::move(new_table));
-    immutable_memtable_.reset();
-    
-    // Check if compaction is needed
-    MaybeCompact();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    flush_done_cv_.wait(lock, [this] {
+        return immutable_memtables_.empty() || background_error_ || shutting_down_;
+    });
+}
+
+std::unique_ptr<SSTable> LSMTree::BuildLevel0Table(
+    const MemTable& memtable, const std::vector<uint64_t>& snapshots) const {
+    // Overwritten and range-deleted versions that no snapshot reads are
+    // dropped on the way out
+    const std::string path = compaction_->GenerateOutputPath(0);
+    TableBuilder builder(path, 0, options_.table_options);
+    std::vector<RangeTombstone> range_tombstones = memtable.GetRangeTombstones();
+    for (const auto& tombstone : range_tombstones) {
+        builder.AddRangeTombstone(tombstone);
+    }
+    auto it = NewVersionFilterIterator(memtable.NewIterator(), snapshots,
+                                       std::move(range_tombstones));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        builder.Add(it->Key(), it->Value(), it->Sequence(), it->Type());
+    }
+    builder.Finish();
+    return std::make_unique<SSTable>(path, options_.table_options);
+}
+
+void LSMTree::BackgroundFlush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        flush_cv_.wait(lock, [this] {
+            return shutting_down_ ||
+                   (!immutable_memtables_.empty() && !background_error_);
+        });
+        if (shutting_down_) {
+            return;
+        }
+
+        // The oldest MemTable stays visible to readers while it is written;
+        // nothing else removes it from the queue, so it is safe to use unlocked.
+        const MemTable* memtable = immutable_memtables_.front().memtable.get();
+        const std::vector<uint64_t> snapshots = LiveSnapshots();
+        lock.unlock();
+        std::unique_ptr<SSTable> new_table;
+        try {
+            new_table = BuildLevel0Table(*memtable, snapshots);
+        } catch (const std::exception&) {
+            // Leave the MemTable queued; its logs keep the data recoverable
+        }
+        lock.lock();
+
+        if (!new_table) {
+            background_error_ = true;
+            flush_done_cv_.notify_all();
+            continue;
+        }
+
+        // The table was synced by its builder; record it, and that the
+        // MemTable's logs are no longer needed, before publishing it
+        VersionEdit edit;
+        edit.new_files.push_back(DescribeTable(*new_table));
+        uint64_t log_number = 0;
+        for (const auto& log_path : immutable_memtables_.front().logs) {
+            log_number = std::max(log_number, LogNumberOf(log_path) + 1);
+        }
+        edit.SetLogNumber(log_number);
+        if (!LogEdit(&edit)) {
+            new_table->MarkObsolete();
+            background_error_ = true;
+            flush_done_cv_.notify_all();
+            continue;
+        }
+
+        // Publish the table and retire the MemTable in one step
+        AddSSTable(std::move(new_table));
+        std::vector<std::string> logs = std::move(immutable_memtables_.front().logs);
+        immutable_memtables_.pop_front();
+
+        // The data is now in an SSTable, so its logs are no longer needed
+        for (const auto& log_path : logs) {
+            std::filesystem::remove(log_path);
+        }
+
+        // Check if compaction is needed
+        MaybeScheduleCompaction();
+        flush_done_cv_.notify_all();
+    }
 }
 
 void LSMTree::MaybeCompact() {
-    // Check each level for compaction
-    for (auto& [level, tables] : levels_) {
-        if (compaction_->ShouldCompact(tables, level)) {
-            // Select tables to compact
-            size_t num_tables = std::min(static_cast<size_t>(10), tables.size());
-            std::vector<std::unique_ptr<SSTable>> to_compact;
-            to_compact.reserve(num_tables);
-            
-            for (size_t i = 0; i < num_tables; ++i) {
-                to_compact.push_back(std::move(tables[i]));
+    std::lock_guard<std::mutex> lock(mutex_);
+    MaybeScheduleCompaction();
+}
+
+void LSMTree::WaitForCompactions() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    compaction_done_cv_.wait(lock, [this] { return pending_compactions_ == 0; });
+}
+
+void LSMTree::MaybeScheduleCompaction() {
+    if (shutting_down_ || background_error_) {
+        return;
+    }
+
+    CompactionJob job;
+    while (compaction_strategy_->PickCompaction(levels_, compacting_levels_, &job)) {
+        // A job owns its input and output level until it is installed
+        compacting_levels_.insert(job.level);
+        compacting_levels_.insert(job.output_level);
+        ++pending_compactions_;
+        const bool bottommost = IsBottommost(job);
+        compaction_pool_->Schedule([this, job = std::move(job), snapshots = LiveSnapshots(),
+                                    bottommost]() mutable {
+            BackgroundCompaction(std::move(job), snapshots, bottommost);
+        });
+        job = CompactionJob();
+    }
+}
+
+bool LSMTree::IsBottommost(const CompactionJob& job) const {
+    // Key span and newest entry of the inputs, range tombstones included
+    std::string smallest_key, largest_key;
+    uint64_t largest_sequence = 0;
+    bool empty = true;
+    auto extend = [&](const std::string& begin, const std::string& end) {
+        if (empty || begin < smallest_key) {
+            smallest_key = begin;
+        }
+        if (empty || end > largest_key) {
+            largest_key = end;
+        }
+        empty = false;
+    };
+    for (const auto& input : job.inputs) {
+        // Taken from the metadata, as the caller holds mutex_ and must not
+        // load the table. A table holding nothing but range tombstones adds
+        // an empty key, which only widens the span.
+        extend(input->GetSmallestKey(), input->GetLargestKey());
+        for (const auto& tombstone : input->GetRangeTombstones()) {
+            extend(tombstone.begin, tombstone.end);
+        }
+        largest_sequence = std::max(largest_sequence, input->GetLargestSequence());
+    }
+
+    // Tables flushed or compacted later only hold newer entries or entries
+    // of tables checked here
+    for (const auto& [level, tables] : levels_) {
+        for (const auto& table : tables) {
+            if (std::find(job.inputs.begin(), job.inputs.end(), table) == job.inputs.end() &&
+                table->GetSmallestSequence() <= largest_sequence &&
+                TableOverlaps(*table, &smallest_key, &largest_key)) {
+                return false;
             }
-            tables.erase(tables.begin(), tables.begin() + num_tables);
-            
-            // Compact and add to next level
-            auto new_table = compaction_->Compact(to_compact, level + 1);
-            AddSSTable(std::move(new_table));
         }
     }
+    return true;
+}
+
+void LSMTree::BackgroundCompaction(CompactionJob job, const std::vector<uint64_t>& snapshots,
+                                   bool bottommost) {
+    // Merge without the lock; inputs stay visible to readers meanwhile.
+    // Snapshots taken after scheduling read only the newest versions, which
+    // are always kept.
+    std::vector<std::unique_ptr<SSTable>> outputs;
+    bool ok = false;
+    try {
+        if (job.split_output) {
+            outputs = compaction_->CompactToLevel(job.inputs, job.output_level, snapshots,
+                                                  bottommost);
+        } else {
+            outputs.push_back(compaction_->Compact(job.inputs, job.output_level, snapshots,
+                                                   bottommost));
+        }
+        ok = true;
+    } catch (const std::exception&) {
+        // Inputs are left in place
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ok) {
+        ok = InstallCompaction(job, std::move(outputs));
+    }
+    if (!ok) {
+        background_error_ = true;
+    }
+
+    compacting_levels_.erase(job.level);
+    compacting_levels_.erase(job.output_level);
+    --pending_compactions_;
+
+    // Compact the next level if this job pushed it over its limit
+    MaybeScheduleCompaction();
+    compaction_done_cv_.notify_all();
+}
+
+bool LSMTree::InstallCompaction(const CompactionJob& job,
+                                std::vector<std::unique_ptr<SSTable>> outputs) {
+    // Inputs may only be deleted once the MANIFEST no longer lists them
+    VersionEdit edit;
+    for (const auto& input : job.inputs) {
+        edit.deleted_files.push_back(DescribeTable(*input).path);
+    }
+    for (const auto& output : outputs) {
+        edit.new_files.push_back(DescribeTable(*output));
+    }
+    if (!LogEdit(&edit)) {
+        for (auto& output : outputs) {
+            output->MarkObsolete();
+        }
+        return false;
+    }
+
+    // The tombstone index only needs rebuilding if tables with range
+    // tombstones come or go
+    bool tombstones_changed = false;
+    for (const auto& input : job.inputs) {
+        tombstones_changed |= !input->GetRangeTombstones().empty();
+    }
+    for (const auto& output : outputs) {
+        tombstones_changed |= !output->GetRangeTombstones().empty();
+    }
+
+    auto is_input = [&job](const std::shared_ptr<SSTable>& table) {
+        return std::find(job.inputs.begin(), job.inputs.end(), table) != job.inputs.end();
+    };
+
+    // Level-0 outputs take the place of the oldest level-0 input, so newer
+    // files flushed meanwhile keep shadowing them
+    auto& level0 = levels_[0];
+    size_t level0_position = static_cast<size_t>(
+        std::find_if(level0.begin(), level0.end(), is_input) - level0.begin());
+
+    // Install atomically: drop the inputs and publish the outputs together
+    for (int input_level : {job.level, job.output_level}) {
+        auto& tables = levels_[input_level];
+        tables.erase(std::remove_if(tables.begin(), tables.end(), is_input), tables.end());
+    }
+    for (const auto& input : job.inputs) {
+        input->MarkObsolete();
+    }
+    for (auto& output : outputs) {
+        const int level = output->GetLevel();
+        if (level == 0) {
+            level0.insert(level0.begin() + level0_position++, std::move(output));
+        } else {
+            InsertByKey(&levels_[level], std::move(output));
+        }
+    }
+    if (tombstones_changed) {
+        RebuildTableTombstones();
+    }
+    return true;
 }
 
 void LSMTree::LoadExistingSSTables() {
-    for (const auto& entry : std::filesystem::directory_iterator(base_path_)) {
-        if (entry.path().extension() == ".sst") {
-            auto table = std::make_unique<SSTable>(entry.path().string());
-            AddSSTable(std::move(table));
+    const std::string manifest_path = base_path_ + "/" + kManifestName;
+    if (std::filesystem::exists(manifest_path)) {
+        ReplayManifest(manifest_path);
+        RemoveOrphanedTables();
+    } else {
+        ScanLegacyTables();
+    }
+    if (options_.table_warmup_threads > 0) {
+        WarmUpTables();
+    }
+
+    // Level-0 files hold disjoint runs of sequence numbers, so sorting by
+    // them restores oldest first
+    auto& level0 = levels_[0];
+    std::stable_sort(level0.begin(), level0.end(),
+        [](const std::shared_ptr<SSTable>& a, const std::shared_ptr<SSTable>& b) {
+            return a->GetLargestSequence() < b->GetLargestSequence();
+        });
+    RebuildTableTombstones();
+}
+
+void LSMTree::ReplayManifest(const std::string& manifest_path) {
+    // Live tables by recorded path, in the order they were added
+    std::vector<FileMetaData> files;
+    bool corrupt = false;
+    WriteAheadLog::Replay(manifest_path, [&](const std::string& record) {
+        VersionEdit edit;
+        if (corrupt || !edit.DecodeFrom(record)) {
+            corrupt = true;
+            return;
+        }
+        for (const auto& path : edit.deleted_files) {
+            files.erase(std::remove_if(files.begin(), files.end(),
+                                       [&path](const FileMetaData& file) {
+                                           return file.path == path;
+                                       }),
+                        files.end());
+        }
+        for (auto& file : edit.new_files) {
+            files.push_back(std::move(file));
+        }
+        if (edit.has_log_number) {
+            log_number_ = std::max(log_number_, edit.log_number);
+        }
+        if (edit.has_last_sequence) {
+            last_sequence_ = std::max(last_sequence_, edit.last_sequence);
+        }
+    });
+    if (corrupt) {
+        throw std::runtime_error("Corrupt MANIFEST: " + manifest_path);
+    }
+
+    // Tables go straight into the level the MANIFEST records, and are not
+    // read until they are first used
+    for (const auto& file : files) {
+        const std::string path = ResolveTablePath(file.path);
+        if (!std::filesystem::exists(path)) {
+            throw std::runtime_error("SSTable listed in MANIFEST is missing: " + path);
+        }
+        auto table = std::make_shared<SSTable>(path, file, options_.table_options);
+        last_sequence_ = std::max(last_sequence_, file.largest_sequence);
+        if (file.level == 0) {
+            levels_[0].push_back(std::move(table));
+        } else {
+            InsertByKey(&levels_[file.level], std::move(table));
+        }
+    }
+}
+
+void LSMTree::WarmUpTables() {
+    std::vector<std::shared_ptr<SSTable>> tables;
+    for (const auto& [level, level_tables] : levels_) {
+        for (const auto& table : level_tables) {
+            if (!table->IsLoaded()) {
+                tables.push_back(table);
+            }
         }
     }
+    if (tables.empty()) {
+        return;
+    }
+
+    // Tasks own their table, so a failure can be reported before the rest finish
+    ThreadPool pool(std::min(options_.table_warmup_threads, tables.size()));
+    std::vector<std::future<void>> futures;
+    for (const auto& table : tables) {
+        auto task = std::make_shared<std::packaged_task<void()>>([table] { table->Load(); });
+        futures.push_back(task->get_future());
+        pool.Schedule([task] { (*task)(); });
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+}
+
+void LSMTree::ScanLegacyTables() {
+    // Trees written before the MANIFEST existed are listed once; the level
+    // of each table is read from its properties
+    for (const auto& path : ListTableFiles(base_path_)) {
+        auto table = std::make_unique<SSTable>(path, options_.table_options);
+        last_sequence_ = std::max(last_sequence_, table->GetLargestSequence());
+        AddSSTable(std::move(table));
+    }
+}
+
+void LSMTree::RemoveOrphanedTables() {
+    // Outputs of an interrupted flush or compaction, and inputs whose
+    // deletion a crash cut short
+    std::set<std::string> live;
+    for (const auto& [level, tables] : levels_) {
+        for (const auto& table : tables) {
+            live.insert(std::filesystem::path(table->GetPath()).lexically_normal().string());
+        }
+    }
+    for (const auto& path : ListTableFiles(base_path_)) {
+        if (!live.count(std::filesystem::path(path).lexically_normal().string())) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+    }
+}
+
+void LSMTree::WriteManifestSnapshot() {
+    // Start a fresh MANIFEST holding only the live tables, so its size
+    // stays proportional to the tree rather than to its history
+    VersionEdit edit;
+    for (const auto& [level, tables] : levels_) {
+        for (const auto& table : tables) {
+            edit.new_files.push_back(DescribeTable(*table));
+        }
+    }
+    edit.SetLogNumber(log_number_);
+    edit.SetLastSequence(last_sequence_);
+    std::string record;
+    edit.EncodeTo(&record);
+
+    const std::string manifest_path = base_path_ + "/" + kManifestName;
+    const std::string temp_path = manifest_path + ".tmp";
+    manifest_.reset();
+    std::filesystem::remove(temp_path);
+    {
+        WriteAheadLog temp(temp_path, WalSyncMode::kEveryWrite, options_.wal_sync_interval);
+        if (!temp.AddRecord(record)) {
+            throw std::runtime_error("Failed to write MANIFEST: " + temp_path);
+        }
+    }
+    // The rename replaces the old MANIFEST atomically, and is durable once
+    // the directory is synced
+    std::filesystem::rename(temp_path, manifest_path);
+    if (!SyncPath(base_path_)) {
+        throw std::runtime_error("Failed to sync directory: " + base_path_);
+    }
+    manifest_ = std::make_unique<WriteAheadLog>(manifest_path, WalSyncMode::kEveryWrite,
+                                                options_.wal_sync_interval);
+}
+
+bool LSMTree::LogEdit(VersionEdit* edit) {
+    edit->SetLastSequence(last_sequence_);
+    std::string record;
+    edit->EncodeTo(&record);
+    return manifest_->AddRecord(record);
+}
+
+FileMetaData LSMTree::DescribeTable(const SSTable& table) const {
+    FileMetaData file;
+    file.level = table.GetLevel();
+    file.smallest_key = table.GetSmallestKey();
+    file.largest_key = table.GetLargestKey();
+    file.size = table.GetSize();
+    file.smallest_sequence = table.GetSmallestSequence();
+    file.largest_sequence = table.GetLargestSequence();
+    file.range_tombstones = table.GetRangeTombstones();
+
+    // Paths inside the tree are recorded relative to it, so the directory
+    // can be moved
+    std::filesystem::path base = std::filesystem::path(base_path_).lexically_normal();
+    if (!base.has_filename()) {
+        base = base.parent_path();
+    }
+    const std::filesystem::path relative =
+        std::filesystem::path(table.GetPath()).lexically_normal().lexically_relative(base);
+    if (relative.empty() || *relative.begin() == "..") {
+        file.path = std::filesystem::absolute(table.GetPath()).string();
+    } else {
+        file.path = relative.string();
+    }
+    return file;
+}
+
+std::string LSMTree::ResolveTablePath(const std::string& path) const {
+    if (std::filesystem::path(path).is_absolute()) {
+        return path;
+    }
+    return (std::filesystem::path(base_path_) / path).string();
 }
 
 void LSMTree::AddSSTable(std::unique_ptr<SSTable> table) {
+    const bool has_tombstones = !table->GetRangeTombstones().empty();
     int level = table->GetLevel();
-    levels_[level].push_back(std::move(table));
+    if (level == 0) {
+        levels_[0].push_back(std::move(table));
+    } else {
+        // Keep the level sorted by key
+        InsertByKey(&levels_[level], std::move(table));
+    }
+    if (has_tombstones) {
+        RebuildTableTombstones();
+    }
+}
+
+void LSMTree::RebuildTableTombstones() {
+    std::vector<RangeTombstone> tombstones;
+    for (const auto& [level, tables] : levels_) {
+        for (const auto& table : tables) {
+            tombstones.insert(tombstones.end(), table->GetRangeTombstones().begin(),
+                              table->GetRangeTombstones().end());
+        }
+    }
+    table_tombstones_ = tombstones.empty()
+        ? nullptr
+        : std::make_shared<const FragmentedRangeTombstones>(tombstones);
+}
+
+std::vector<TableMetadata> LSMTree::GetLevelMetadata(int level) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<TableMetadata> result;
+    auto it = levels_.find(level);
+    if (it == levels_.end()) {
+        return result;
+    }
+    for (const auto& table : it->second) {
+        result.push_back({table->GetPath(), table->GetSmallestKey(),
+                          table->GetLargestKey(), table->GetSize()});
+    }
+    return result;
 }
 
 void LSMTree::RemoveSSTable(const std::string& path) {
     for (auto& [level, tables] : levels_) {
         auto it = std::find_if(tables.begin(), tables.end(),
-            [&path](const std::unique_ptr<SSTable>& table) {
+            [&path](const std::shared_ptr<SSTable>& table) {
                 return table->GetPath() == path;
             });
         
         if (it != tables.end()) {
+            const bool has_tombstones = !(*it)->GetRangeTombstones().empty();
             tables.erase(it);
+            if (has_tombstones) {
+                RebuildTableTombstones();
+            }
             return;
         }
     }
 }
 
-bool LSMTree::CheckMemTableFull() {
-    return memtable_->IsFull();
+void LSMTree::RecoverLogs() {
+    std::vector<std::pair<uint64_t, std::string>> logs;
+    for (const auto& entry : std::filesystem::directory_iterator(base_path_)) {
+        uint64_t number;
+        if (entry.is_regular_file() &&
+            ParseLogNumber(entry.path().filename().string(), &number)) {
+            logs.emplace_back(number, entry.path().string());
+        }
+    }
+    std::sort(logs.begin(), logs.end());
+
+    for (const auto& [number, path] : logs) {
+        next_log_number_ = std::max(next_log_number_, number + 1);
+        if (number < log_number_) {
+            // Every write in it was flushed before the log could be deleted
+            std::filesystem::remove(path);
+            continue;
+        }
+        WriteAheadLog::Replay(path, [this](const std::string& record) {
+            WriteBatch batch;
+            if (!batch.SetContents(record)) {
+                return;
+            }
+            if (CheckMemTableFull(batch.ApproximateSize())) {
+                // Logs stay attached to the live MemTable until it is flushed,
+                // so flushing early here only means replaying some records twice.
+                std::unique_ptr<SSTable> table = BuildLevel0Table(*memtable_, {});
+                VersionEdit edit;
+                edit.new_files.push_back(DescribeTable(*table));
+                if (!LogEdit(&edit)) {
+                    table->MarkObsolete();
+                    throw std::runtime_error("Failed to write MANIFEST: " + base_path_);
+                }
+                AddSSTable(std::move(table));
+                memtable_ = NewMemTable(options_);
+            }
+            ApplyBatch(batch);
+        });
+        memtable_logs_.push_back(path);
+    }
+}
+
+bool LSMTree::NewLog() {
+    std::string path = base_path_ + "/" + kLogPrefix +
+                       std::to_string(next_log_number_++) + kLogSuffix;
+    auto wal = std::make_unique<WriteAheadLog>(
+        path, options_.wal_sync_mode, options_.wal_sync_interval);
+    // Synced writes are only durable once the log's directory entry is
+    if (options_.wal_sync_mode != WalSyncMode::kNone && !SyncPath(base_path_)) {
+        return false;
+    }
+    wal_ = std::move(wal);
+    memtable_logs_.push_back(path);
+    return true;
+}
+
+bool LSMTree::CheckMemTableFull(size_t write_size) const {
+    if (memtable_->IsEmpty()) {
+        return false;
+    }
+    return memtable_->GetSize() + write_size > options_.memtable_size;
+}
+
+bool LSMTree::MakeRoomForWrite(std::unique_lock<std::mutex>* lock,
+                               size_t write_size, bool force) {
+    while (true) {
+        if (background_error_ || shutting_down_) {
+            return false;
+        }
+        if (memtable_->IsEmpty() || (!force && !CheckMemTableFull(write_size))) {
+            return true;
+        }
+        if (immutable_memtables_.size() >= std::max<size_t>(1, options_.max_immutable_memtables)) {
+            // The flush thread is behind; stall until it retires a MemTable
+            flush_done_cv_.wait(*lock);
+            continue;
+        }
+        SwitchMemTable();
+        force = false;
+    }
 }
 
 void LSMTree::SwitchMemTable() {
-    immutable_memtable_ = std::move(memtable_);
-    memtable_ = std::make_unique<MemTable>(memtable_->GetSize());
+    immutable_memtables_.push_back({std::move(memtable_), std::move(memtable_logs_)});
+    memtable_logs_.clear();
+    memtable_ = NewMemTable(options_);
+    if (!NewLog()) {
+        // Writes would otherwise go on to a log retired with the old MemTable
+        background_error_ = true;
+        flush_done_cv_.notify_all();
+        return;
+    }
+    flush_cv_.notify_one();
 }
 
 } // namespace sstable 
\ No newline at end of file
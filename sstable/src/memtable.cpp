@@ -1,71 +1,202 @@
 #include "memtable.h"
 #include "skip_list.h"
+#include "coding.h"
+#include <algorithm>
 #include <cstring>
 
 namespace sstable {
 
-MemTable::MemTable(size_t max_size)
-    : skip_list_(std::make_unique<SkipList>()),
-      max_size_(max_size),
-      current_size_(0) {}
+namespace {
 
-bool MemTable::Put(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (IsFull()) {
-        return false;
-    }
+// Both probe bits of a prefix fall in one word
+uint64_t PrefixBits(uint64_t hash) {
+    return (uint64_t{1} << (hash & 63)) | (uint64_t{1} << ((hash >> 6) & 63));
+}
 
-    size_t entry_size = key.size() + value.size() + 8; // 8 bytes for lengths
-    if (current_size_ + entry_size > max_size_) {
-        return false;
-    }
+} // namespace
 
-    if (skip_list_->Insert(key, value)) {
-        current_size_ += entry_size;
-        return true;
+MemTable::MemTable(size_t max_size,
+                   std::shared_ptr<const PrefixExtractor> prefix_extractor)
+    : skip_list_(std::make_unique<SkipList>(&arena_)),
+      range_tombstones_(std::make_unique<SkipList>(&arena_)),
+      max_size_(max_size),
+      prefix_extractor_(std::move(prefix_extractor)) {
+    if (prefix_extractor_) {
+        prefix_bloom_ = std::make_unique<std::atomic<uint64_t>[]>(kPrefixBloomWords);
+        for (size_t i = 0; i < kPrefixBloomWords; ++i) {
+            prefix_bloom_[i].store(0, std::memory_order_relaxed);
+        }
     }
-    return false;
 }
 
-bool MemTable::Get(const std::string& key, std::string* value) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return skip_list_->Get(key, value);
+MemTable::~MemTable() = default;
+
+bool MemTable::Put(const std::string& key, const std::string& value, uint64_t sequence) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return AddEntry(key, value, sequence, ValueType::kValue);
+}
+
+bool MemTable::Get(const std::string& key, std::string* value, uint64_t sequence) const {
+    return skip_list_->Get(key, value, sequence);
+}
+
+bool MemTable::Find(const std::string& key, uint64_t sequence, std::string* value,
+                    ValueType* type, uint64_t* found_sequence) const {
+    return skip_list_->Find(key, sequence, value, type, found_sequence);
+}
+
+bool MemTable::Delete(const std::string& key, uint64_t sequence) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return AddEntry(key, "", sequence, ValueType::kDeletion);
+}
+
+bool MemTable::DeleteRange(const std::string& begin, const std::string& end,
+                           uint64_t sequence) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return AddRangeTombstone(begin, end, sequence);
+}
+
+bool MemTable::Apply(const WriteBatch& batch, uint64_t sequence) {
+    // Numbers the operations from sequence as they are decoded
+    class Inserter : public WriteBatch::Handler {
+    public:
+        Inserter(MemTable* memtable, uint64_t sequence)
+            : memtable_(memtable), sequence_(sequence), ok_(true) {}
+
+        void Put(const std::string& key, const std::string& value) override {
+            ok_ = memtable_->AddEntry(key, value, sequence_++, ValueType::kValue) && ok_;
+        }
+
+        void Delete(const std::string& key) override {
+            ok_ = memtable_->AddEntry(key, "", sequence_++, ValueType::kDeletion) && ok_;
+        }
+
+        void DeleteRange(const std::string& begin_key, const std::string& end_key) override {
+            ok_ = memtable_->AddRangeTombstone(begin_key, end_key, sequence_++) && ok_;
+        }
+
+        bool ok() const { return ok_; }
+
+    private:
+        MemTable* memtable_;
+        uint64_t sequence_;
+        bool ok_;
+    };
+
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    Inserter inserter(this, sequence);
+    return batch.Iterate(&inserter) && inserter.ok();
 }
 
-bool MemTable::Delete(const std::string& key) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (IsFull()) {
+bool MemTable::AddEntry(const std::string& key, const std::string& value,
+                        uint64_t sequence, ValueType type) {
+    if (IsFull() || !HasRoomFor(key.size(), value.size())) {
         return false;
     }
 
-    // For deletion, we insert a tombstone value
-    const std::string tombstone = "";
-    size_t entry_size = key.size() + 8; // 8 bytes for lengths
-    if (current_size_ + entry_size > max_size_) {
+    AddPrefix(key);
+    return skip_list_->Insert(key, value, sequence, type);
+}
+
+bool MemTable::AddRangeTombstone(const std::string& begin, const std::string& end,
+                                 uint64_t sequence) {
+    if (IsFull() || !HasRoomFor(begin.size(), end.size())) {
         return false;
     }
 
-    if (skip_list_->Insert(key, tombstone)) {
-        current_size_ += entry_size;
-        return true;
+    // Keyed by the start of the range, with the end as the value. The range
+    // may span prefixes, so it is not added to the prefix bloom: prefix scans
+    // apply the tombstones of every MemTable they may overlap.
+    return range_tombstones_->Insert(begin, end, sequence, ValueType::kDeletion);
+}
+
+std::vector<RangeTombstone> MemTable::GetRangeTombstones() const {
+    std::vector<RangeTombstone> tombstones;
+    if (range_tombstones_->IsEmpty()) {
+        return tombstones;
+    }
+    auto it = range_tombstones_->NewIterator();
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        tombstones.push_back({std::string(it->Key()), std::string(it->Value()), it->Sequence()});
     }
-    return false;
+    return tombstones;
+}
+
+uint64_t MemTable::MaxCoveringSequence(std::string_view key, uint64_t sequence) const {
+    uint64_t result = 0;
+    if (range_tombstones_->IsEmpty()) {
+        return result;
+    }
+
+    // Tombstones are ordered by start key, so none past key can cover it
+    auto it = range_tombstones_->NewIterator();
+    for (it->SeekToFirst(); it->Valid() && it->Key() <= key; it->Next()) {
+        if (it->Sequence() <= sequence && key < it->Value()) {
+            result = std::max(result, it->Sequence());
+        }
+    }
+    return result;
 }
 
 bool MemTable::IsFull() const {
-    return current_size_ >= max_size_;
+    return GetSize() >= max_size_;
+}
+
+bool MemTable::IsEmpty() const {
+    return skip_list_->IsEmpty() && range_tombstones_->IsEmpty();
 }
 
 size_t MemTable::GetSize() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return current_size_;
+    return arena_.MemoryUsage();
+}
+
+bool MemTable::HasRoomFor(size_t key_size, size_t value_size) const {
+    size_t entry_size = SkipList::EstimateEntrySize(key_size, value_size);
+    return GetSize() + entry_size <= max_size_;
 }
 
 std::vector<std::pair<std::string, std::string>> MemTable::GetAllEntries() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return skip_list_->GetAllEntries();
+    std::vector<std::pair<std::string, std::string>> entries;
+    auto it = skip_list_->NewIterator();
+    std::string_view last_key; // Points into the Arena, which outlives the loop
+    bool seen = false;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        // Versions are visited newest first, and the newest one decides
+        if (seen && it->Key() == last_key) {
+            continue;
+        }
+        seen = true;
+        last_key = it->Key();
+        if (it->Type() == ValueType::kValue) {
+            entries.emplace_back(it->Key(), it->Value());
+        }
+    }
+    return entries;
+}
+
+std::unique_ptr<Iterator> MemTable::NewIterator() const {
+    return skip_list_->NewIterator();
+}
+
+void MemTable::AddPrefix(const std::string& key) {
+    if (!prefix_extractor_ || !prefix_extractor_->InDomain(key)) {
+        return;
+    }
+    std::string_view prefix = prefix_extractor_->Transform(key);
+    uint64_t hash = Hash64(prefix.data(), prefix.size());
+    // Set before the key is linked, so a reader that can see the key sees the bits
+    prefix_bloom_[(hash >> 32) % kPrefixBloomWords].fetch_or(PrefixBits(hash),
+                                                             std::memory_order_release);
+}
+
+bool MemTable::PrefixMayMatch(std::string_view prefix) const {
+    if (!prefix_bloom_) {
+        return true;
+    }
+    uint64_t hash = Hash64(prefix.data(), prefix.size());
+    uint64_t bits = PrefixBits(hash);
+    return (prefix_bloom_[(hash >> 32) % kPrefixBloomWords].load(std::memory_order_acquire) &
+            bits) == bits;
 }
 
-} // namespace sstable 
\ No newline at end of file
+} // namespace sstable
\ No newline at end of file
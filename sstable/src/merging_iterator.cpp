@@ -0,0 +1,93 @@
+#include "merging_iterator.h"
+#include <algorithm>
+#include <string>
+
+namespace sstable {
+
+namespace {
+
+class MergingIterator : public Iterator {
+public:
+    explicit MergingIterator(std::vector<std::unique_ptr<Iterator>> children)
+        : children_(std::move(children)) {
+        heap_.reserve(children_.size());
+    }
+
+    bool Valid() const override { return !heap_.empty(); }
+
+    void SeekToFirst() override {
+        for (auto& child : children_) {
+            child->SeekToFirst();
+        }
+        BuildHeap();
+    }
+
+    void Seek(const std::string& target) override {
+        for (auto& child : children_) {
+            child->Seek(target);
+        }
+        BuildHeap();
+    }
+
+    void Next() override {
+        std::pop_heap(heap_.begin(), heap_.end(), HeapOrder{this});
+        size_t i = heap_.back();
+        children_[i]->Next();
+        if (children_[i]->Valid()) {
+            std::push_heap(heap_.begin(), heap_.end(), HeapOrder{this});
+        } else {
+            heap_.pop_back();
+        }
+    }
+
+    std::string_view Key() const override { return children_[heap_.front()]->Key(); }
+
+    std::string_view Value() const override { return children_[heap_.front()]->Value(); }
+
+    uint64_t Sequence() const override { return children_[heap_.front()]->Sequence(); }
+
+    ValueType Type() const override { return children_[heap_.front()]->Type(); }
+
+private:
+    // The heap top is the child with the smallest key; on equal keys the
+    // highest sequence number, then the newest child, which is the last one
+    bool After(size_t a, size_t b) const {
+        int cmp = children_[a]->Key().compare(children_[b]->Key());
+        if (cmp != 0) {
+            return cmp > 0;
+        }
+        uint64_t sequence_a = children_[a]->Sequence();
+        uint64_t sequence_b = children_[b]->Sequence();
+        if (sequence_a != sequence_b) {
+            return sequence_a < sequence_b;
+        }
+        return a < b;
+    }
+
+    struct HeapOrder {
+        const MergingIterator* merger;
+
+        bool operator()(size_t a, size_t b) const { return merger->After(a, b); }
+    };
+
+    void BuildHeap() {
+        heap_.clear();
+        for (size_t i = 0; i < children_.size(); ++i) {
+            if (children_[i]->Valid()) {
+                heap_.push_back(i);
+            }
+        }
+        std::make_heap(heap_.begin(), heap_.end(), HeapOrder{this});
+    }
+
+    std::vector<std::unique_ptr<Iterator>> children_;
+    std::vector<size_t> heap_;
+};
+
+} // namespace
+
+std::unique_ptr<Iterator> NewMergingIterator(std::vector<std::unique_ptr<Iterator>> children) {
+    return std::make_unique<MergingIterator>(std::move(children));
+}
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "prefix_extractor.h"
+#include <string>
+
+namespace sstable {
+
+namespace {
+
+class FixedPrefixExtractor : public PrefixExtractor {
+public:
+    explicit FixedPrefixExtractor(size_t length)
+        : length_(length),
+          name_("sstable.FixedPrefix." + std::to_string(length)) {}
+
+    const char* Name() const override { return name_.c_str(); }
+
+    bool InDomain(std::string_view key) const override {
+        return key.size() >= length_;
+    }
+
+    std::string_view Transform(std::string_view key) const override {
+        return key.substr(0, length_);
+    }
+
+private:
+    size_t length_;
+    std::string name_;
+};
+
+class DelimitedPrefixExtractor : public PrefixExtractor {
+public:
+    explicit DelimitedPrefixExtractor(char delimiter)
+        : delimiter_(delimiter),
+          name_(std::string("sstable.DelimitedPrefix.") + delimiter) {}
+
+    const char* Name() const override { return name_.c_str(); }
+
+    bool InDomain(std::string_view key) const override {
+        return key.find(delimiter_) != std::string_view::npos;
+    }
+
+    std::string_view Transform(std::string_view key) const override {
+        return key.substr(0, key.find(delimiter_) + 1);
+    }
+
+private:
+    char delimiter_;
+    std::string name_;
+};
+
+} // namespace
+
+std::shared_ptr<const PrefixExtractor> NewFixedPrefixExtractor(size_t length) {
+    return std::make_shared<FixedPrefixExtractor>(length);
+}
+
+std::shared_ptr<const PrefixExtractor> NewDelimitedPrefixExtractor(char delimiter) {
+    return std::make_shared<DelimitedPrefixExtractor>(delimiter);
+}
+
+bool GetScanPrefix(const PrefixExtractor& extractor,
+                   std::string_view start_key,
+                   std::string_view end_key,
+                   std::string_view* prefix) {
+    if (!extractor.InDomain(start_key) || !extractor.InDomain(end_key)) {
+        return false;
+    }
+    // Every key between two keys sharing a prefix starts with that prefix too
+    std::string_view start_prefix = extractor.Transform(start_key);
+    if (start_prefix != extractor.Transform(end_key)) {
+        return false;
+    }
+    *prefix = start_prefix;
+    return true;
+}
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "random_access_file.h"
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sstable {
+
+RandomAccessFile::RandomAccessFile(const std::string& path)
+    : path_(path),
+      fd_(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open file for reading: " + path_);
+    }
+}
+
+RandomAccessFile::~RandomAccessFile() {
+    close(fd_);
+}
+
+bool RandomAccessFile::Read(uint64_t offset, size_t size, std::string* contents) const {
+    contents->resize(size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd_, &(*contents)[done], size - done,
+                          static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool SyncPath(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+} // namespace sstable
\ No newline at end of file
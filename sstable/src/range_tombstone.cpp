@@ -0,0 +1,93 @@
+#include "range_tombstone.h"
+#include "iterator.h"
+#include <algorithm>
+#include <functional>
+
+namespace sstable {
+
+uint64_t MaxCoveringSequence(const std::vector<RangeTombstone>& tombstones,
+                             std::string_view key, uint64_t sequence) {
+    uint64_t result = 0;
+    for (const auto& tombstone : tombstones) {
+        if (tombstone.sequence <= sequence && tombstone.Contains(key)) {
+            result = std::max(result, tombstone.sequence);
+        }
+    }
+    return result;
+}
+
+uint64_t NextCoveringSequence(const std::vector<RangeTombstone>& tombstones,
+                              std::string_view key, uint64_t sequence) {
+    uint64_t result = kMaxSequenceNumber;
+    for (const auto& tombstone : tombstones) {
+        if (tombstone.sequence > sequence && tombstone.Contains(key)) {
+            result = std::min(result, tombstone.sequence);
+        }
+    }
+    return result;
+}
+
+FragmentedRangeTombstones::FragmentedRangeTombstones(
+    const std::vector<RangeTombstone>& tombstones) {
+    std::vector<std::string_view> bounds;
+    std::vector<const RangeTombstone*> by_begin;
+    for (const auto& tombstone : tombstones) {
+        if (tombstone.begin < tombstone.end) {
+            bounds.push_back(tombstone.begin);
+            bounds.push_back(tombstone.end);
+            by_begin.push_back(&tombstone);
+        }
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+    std::sort(by_begin.begin(), by_begin.end(),
+              [](const RangeTombstone* a, const RangeTombstone* b) { return a->begin < b->begin; });
+
+    // Sweep the bounds, keeping the tombstones that cover the current one
+    std::vector<const RangeTombstone*> active;
+    size_t next = 0;
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [&](const RangeTombstone* t) { return t->end <= bounds[i]; }),
+                     active.end());
+        while (next < by_begin.size() && by_begin[next]->begin == bounds[i]) {
+            active.push_back(by_begin[next++]);
+        }
+        if (active.empty()) {
+            continue;
+        }
+
+        std::vector<uint64_t> sequences;
+        for (const RangeTombstone* tombstone : active) {
+            sequences.push_back(tombstone->sequence);
+        }
+        std::sort(sequences.begin(), sequences.end(), std::greater<uint64_t>());
+
+        // Neighbours covered by the same tombstones merge into one fragment
+        if (!fragments_.empty() && fragments_.back().end == bounds[i] &&
+            fragments_.back().sequences == sequences) {
+            fragments_.back().end.assign(bounds[i + 1]);
+        } else {
+            fragments_.push_back({std::string(bounds[i]), std::string(bounds[i + 1]),
+                                  std::move(sequences)});
+        }
+    }
+}
+
+uint64_t FragmentedRangeTombstones::MaxCoveringSequence(std::string_view key,
+                                                        uint64_t sequence) const {
+    // The last fragment starting at or before key is the only one that may
+    // hold it
+    auto it = std::upper_bound(fragments_.begin(), fragments_.end(), key,
+                               [](std::string_view k, const Fragment& fragment) {
+                                   return k < fragment.begin;
+                               });
+    if (it == fragments_.begin() || key >= (--it)->end) {
+        return 0;
+    }
+    auto covering = std::lower_bound(it->sequences.begin(), it->sequences.end(), sequence,
+                                     std::greater<uint64_t>());
+    return covering == it->sequences.end() ? 0 : *covering;
+}
+
+} // namespace sstable
\ No newline at end of file
@@ -1,111 +1,258 @@
 #include "skip_list.h"
-#include <algorithm>
+#include "coding.h"
+#include <cstring>
+#include <new>
 
 namespace sstable {
 
+struct SkipList::Node {
+    Node(const char* k, uint32_t k_size, uint64_t s, const char* v)
+        : key_data(k), key_size(k_size), sequence(s), value(v) {}
+
+    std::string_view Key() const { return std::string_view(key_data, key_size); }
+
+    // Keys ascend; versions of one key go from the highest sequence number down
+    bool Before(std::string_view key, uint64_t seq) const {
+        int cmp = Key().compare(key);
+        return cmp < 0 || (cmp == 0 && sequence > seq);
+    }
+
+    // Values are stored as [length (4 bytes)][type (1 byte)][bytes] and
+    // swapped as a whole, so a value and its type are always read together
+    static std::string_view DecodeValue(const char* data) {
+        return std::string_view(data + 5, DecodeFixed32(data));
+    }
+    static ValueType DecodeType(const char* data) {
+        return static_cast<ValueType>(data[4]);
+    }
+    const char* LoadValue() const { return value.load(std::memory_order_acquire); }
+
+    Node* Next(int level) const {
+        return forward[level].load(std::memory_order_acquire);
+    }
+    void SetNext(int level, Node* node) {
+        forward[level].store(node, std::memory_order_release);
+    }
+
+    // Relaxed variants for links that are not yet visible to readers
+    Node* NoBarrierNext(int level) const {
+        return forward[level].load(std::memory_order_relaxed);
+    }
+    void NoBarrierSetNext(int level, Node* node) {
+        forward[level].store(node, std::memory_order_relaxed);
+    }
+
+    const char* const key_data;
+    const uint32_t key_size;
+    const uint64_t sequence;
+    std::atomic<const char*> value;
+
+    // Array of length equal to the node height; forward[0] is the lowest level
+    std::atomic<Node*> forward[1];
+};
+
+class SkipList::ListIterator : public Iterator {
+public:
+    explicit ListIterator(const SkipList* list) : list_(list), node_(nullptr) {}
+
+    bool Valid() const override { return node_ != nullptr; }
+
+    void SeekToFirst() override { SetNode(list_->head_->Next(0)); }
+
+    void Seek(const std::string& target) override {
+        SetNode(list_->FindGreaterOrEqual(target, kMaxSequenceNumber, nullptr));
+    }
+
+    void Next() override { SetNode(node_->Next(0)); }
+
+    std::string_view Key() const override { return node_->Key(); }
+
+    std::string_view Value() const override { return Node::DecodeValue(value_); }
+
+    uint64_t Sequence() const override { return node_->sequence; }
+
+    ValueType Type() const override { return Node::DecodeType(value_); }
+
+private:
+    // The value is loaded once, so a concurrent overwrite cannot change it
+    // between two calls to Value()
+    void SetNode(Node* node) {
+        node_ = node;
+        if (node_) {
+            value_ = node_->LoadValue();
+        }
+    }
+
+    const SkipList* list_;
+    Node* node_;
+    const char* value_;
+};
+
 SkipList::SkipList()
-    : head_(std::make_shared<Node>("", "", kMaxLevel)),
+    : SkipList(nullptr) {}
+
+SkipList::SkipList(Arena* arena)
+    : owned_arena_(arena ? nullptr : std::make_unique<Arena>()),
+      arena_(arena ? arena : owned_arena_.get()),
+      head_(nullptr),
       max_level_(1),
-      rng_(std::random_device{}()),
-      dist_(0.0, 1.0) {
-    for (int i = 0; i <= kMaxLevel; ++i) {
-        head_->forward[i] = nullptr;
+      rng_(std::random_device{}()) {
+    head_ = NewNode("", 0, nullptr, kMaxLevel);
+}
+
+SkipList::Node* SkipList::NewNode(std::string_view key,
+                                  uint64_t sequence,
+                                  const char* value,
+                                  int height) {
+    // Node, tower and key bytes share one allocation
+    const size_t node_size = sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
+    char* memory = arena_->AllocateAligned(node_size + key.size());
+    char* key_data = memory + node_size;
+    if (!key.empty()) {
+        std::memcpy(key_data, key.data(), key.size());
     }
+
+    Node* node = new (memory) Node(key_data, static_cast<uint32_t>(key.size()), sequence, value);
+    for (int i = 1; i < height; ++i) {
+        new (&node->forward[i]) std::atomic<Node*>();
+    }
+    for (int i = 0; i < height; ++i) {
+        node->NoBarrierSetNext(i, nullptr);
+    }
+    return node;
+}
+
+const char* SkipList::NewValue(std::string_view value, ValueType type) {
+    char* data = arena_->Allocate(5 + value.size());
+    const uint32_t size = static_cast<uint32_t>(value.size());
+    std::memcpy(data, &size, sizeof(size));
+    data[4] = static_cast<char>(type);
+    if (!value.empty()) {
+        std::memcpy(data + 5, value.data(), value.size());
+    }
+    return data;
 }
 
 int SkipList::RandomLevel() {
     int level = 1;
-    while (dist_(rng_) < kProbability && level < kMaxLevel) {
+    while (level < kMaxLevel && rng_() % kBranching == 0) {
         ++level;
     }
     return level;
 }
 
-std::shared_ptr<SkipList::Node> SkipList::FindGreaterOrEqual(
-    const std::string& key,
-    std::vector<std::shared_ptr<Node>>* prev) const {
-    if (prev) {
-        prev->resize(kMaxLevel + 1);
-        std::fill(prev->begin(), prev->end(), head_);
-    }
-
-    auto current = head_;
-    for (int i = max_level_; i >= 0; --i) {
-        while (current->forward[i] && current->forward[i]->key < key) {
-            current = current->forward[i];
+SkipList::Node* SkipList::FindGreaterOrEqual(std::string_view key,
+                                             uint64_t sequence,
+                                             Node** prev) const {
+    Node* current = head_;
+    int level = GetMaxLevel() - 1;
+    while (true) {
+        Node* next = current->Next(level);
+        if (next && next->Before(key, sequence)) {
+            current = next;
+            continue;
         }
         if (prev) {
-            (*prev)[i] = current;
+            prev[level] = current;
+        }
+        if (level == 0) {
+            return next;
         }
+        --level;
     }
-    return current->forward[0];
 }
 
-bool SkipList::Insert(const std::string& key, const std::string& value) {
-    std::vector<std::shared_ptr<Node>> prev(kMaxLevel + 1);
-    auto node = FindGreaterOrEqual(key, &prev);
+bool SkipList::Insert(const std::string& key, const std::string& value, uint64_t sequence,
+                      ValueType type) {
+    const char* stored_value = NewValue(value, type);
 
-    if (node && node->key == key) {
-        node->value = value;
+    Node* prev[kMaxLevel];
+    Node* node = FindGreaterOrEqual(key, sequence, prev);
+
+    if (node && node->Key() == key && node->sequence == sequence) {
+        // Readers holding the old value keep a valid pointer into the Arena
+        node->value.store(stored_value, std::memory_order_release);
         return true;
     }
 
     int level = RandomLevel();
-    if (level > max_level_) {
-        for (int i = max_level_ + 1; i <= level; ++i) {
+    if (level > GetMaxLevel()) {
+        for (int i = GetMaxLevel(); i < level; ++i) {
             prev[i] = head_;
         }
-        max_level_ = level;
+        // Readers that see the new height before the links find nullptr at
+        // the new levels and simply drop down
+        max_level_.store(level, std::memory_order_relaxed);
     }
 
-    auto new_node = std::make_shared<Node>(key, value, level);
-    for (int i = 0; i <= level; ++i) {
-        new_node->forward[i] = prev[i]->forward[i];
-        prev[i]->forward[i] = new_node;
+    Node* new_node = NewNode(key, sequence, stored_value, level);
+    for (int i = 0; i < level; ++i) {
+        new_node->NoBarrierSetNext(i, prev[i]->NoBarrierNext(i));
+        prev[i]->SetNext(i, new_node);
     }
 
     return true;
 }
 
-bool SkipList::Get(const std::string& key, std::string* value) const {
-    auto node = FindGreaterOrEqual(key, nullptr);
-    if (node && node->key == key) {
-        *value = node->value;
+bool SkipList::Get(const std::string& key, std::string* value, uint64_t sequence) const {
+    ValueType type;
+    uint64_t found_sequence;
+    return Find(key, sequence, value, &type, &found_sequence) && type == ValueType::kValue;
+}
+
+bool SkipList::Find(const std::string& key, uint64_t sequence, std::string* value,
+                    ValueType* type, uint64_t* found_sequence) const {
+    Node* node = FindGreaterOrEqual(key, sequence, nullptr);
+    if (node && node->Key() == key) {
+        const char* data = node->LoadValue();
+        value->assign(Node::DecodeValue(data));
+        *type = Node::DecodeType(data);
+        *found_sequence = node->sequence;
         return true;
     }
     return false;
 }
 
 bool SkipList::Delete(const std::string& key) {
-    std::vector<std::shared_ptr<Node>> prev(kMaxLevel + 1);
-    auto node = FindGreaterOrEqual(key, &prev);
+    Node* prev[kMaxLevel];
+    Node* node = FindGreaterOrEqual(key, kMaxSequenceNumber, prev);
 
-    if (!node || node->key != key) {
+    if (!node || node->Key() != key) {
         return false;
     }
 
-    for (int i = 0; i <= max_level_; ++i) {
-        if (prev[i]->forward[i] != node) {
-            break;
+    // Unlink top-down; the node keeps its own links so readers on it can
+    // continue the traversal
+    for (int i = GetMaxLevel() - 1; i >= 0; --i) {
+        if (prev[i]->NoBarrierNext(i) == node) {
+            prev[i]->SetNext(i, node->NoBarrierNext(i));
         }
-        prev[i]->forward[i] = node->forward[i];
-    }
-
-    while (max_level_ > 0 && !head_->forward[max_level_]) {
-        --max_level_;
     }
 
     return true;
 }
 
+std::unique_ptr<Iterator> SkipList::NewIterator() const {
+    return std::make_unique<ListIterator>(this);
+}
+
+bool SkipList::IsEmpty() const {
+    return head_->Next(0) == nullptr;
+}
+
+size_t SkipList::EstimateEntrySize(size_t key_size, size_t value_size) {
+    // A node of average height is only slightly taller than one level
+    return sizeof(Node) + key_size + 5 + value_size;
+}
+
 std::vector<std::pair<std::string, std::string>> SkipList::GetAllEntries() const {
     std::vector<std::pair<std::string, std::string>> entries;
-    auto node = head_->forward[0];
+    Node* node = head_->Next(0);
     while (node) {
-        entries.emplace_back(node->key, node->value);
-        node = node->forward[0];
+        entries.emplace_back(node->Key(), Node::DecodeValue(node->LoadValue()));
+        node = node->Next(0);
     }
     return entries;
 }
 
-} // namespace sstable 
\ No newline at end of file
+} // namespace sstable
\ No newline at end of file
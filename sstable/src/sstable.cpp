@@ -1,104 +1,347 @@
 #include "sstable.h"
+#include "coding.h"
+#include "table_builder.h"
+#include "table_format.h"
 #include <fstream>
 #include <algorithm>
+#include <cstdlib>
 #include <filesystem>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace sstable {
 
+namespace {
+
+// Bytes of a mapped table read ahead at a time by a sequential scan
+constexpr uint64_t kScanReadahead = 256 * 1024;
+
+} // namespace
+
+// Walks the data blocks of a table in order, holding one block at a time
+class SSTable::TableIterator : public Iterator {
+public:
+    TableIterator(const SSTable* table, bool fill_cache)
+        : table_(table),
+          fill_cache_(fill_cache),
+          block_index_(0),
+          pos_(0),
+          sequence_(0),
+          type_(ValueType::kValue),
+          valid_(false),
+          readahead_begin_(0),
+          readahead_end_(0) {}
+
+    bool Valid() const override { return valid_; }
+
+    void SeekToFirst() override {
+        block_index_ = 0;
+        LoadBlock(false);
+        FindNextEntry();
+    }
+
+    void Seek(const std::string& target) override {
+        // The first block ending at or after target holds the first candidate
+        const auto& index = table_->index_;
+        auto it = std::lower_bound(index.begin(), index.end(), target,
+            [](const IndexEntry& entry, const std::string& k) {
+                return entry.key < k;
+            });
+        block_index_ = static_cast<size_t>(it - index.begin());
+        LoadBlock(false);
+        FindNextEntry();
+        while (valid_ && key_ < target) {
+            FindNextEntry();
+        }
+    }
+
+    void Next() override { FindNextEntry(); }
+
+    std::string_view Key() const override { return key_; }
+
+    std::string_view Value() const override { return value_; }
+
+    uint64_t Sequence() const override { return sequence_; }
+
+    ValueType Type() const override { return type_; }
+
+private:
+    // sequential is set when the previous block was just read to its end
+    void LoadBlock(bool sequential) {
+        holder_.reset();
+        block_ = std::string_view();
+        pos_ = 0;
+        if (block_index_ >= table_->index_.size()) {
+            return;
+        }
+        const IndexEntry& entry = table_->index_[block_index_];
+
+        // The mapping is advised for random access, which turns off the
+        // kernel's readahead. A scan asks for the blocks ahead of it instead:
+        // bulk scans from their first block, others once they cross into the
+        // next one.
+        if (table_->mapped_ && (sequential || !fill_cache_) &&
+            (entry.offset < readahead_begin_ || entry.offset + entry.size > readahead_end_)) {
+            readahead_begin_ = entry.offset;
+            readahead_end_ = table_->ReadAhead(entry.offset, std::max(kScanReadahead, entry.size));
+        }
+        table_->ReadDataBlock(entry, &holder_, &block_, fill_cache_);
+    }
+
+    // Decode the entry at pos_, moving on to later blocks at the end of this one
+    void FindNextEntry() {
+        while (block_index_ < table_->index_.size()) {
+            if (DecodeEntry(block_, table_->format_version_, &pos_, &key_, &sequence_,
+                            &type_, &value_)) {
+                valid_ = true;
+                return;
+            }
+            table_->CheckBlockEnd(block_, pos_);
+            ++block_index_;
+            LoadBlock(true);
+        }
+        valid_ = false;
+    }
+
+    const SSTable* table_;
+    bool fill_cache_;
+    size_t block_index_;
+    std::shared_ptr<const std::string> holder_;
+    std::string_view block_;
+    size_t pos_;
+    std::string_view key_;
+    std::string_view value_;
+    uint64_t sequence_;
+    ValueType type_;
+    bool valid_;
+    uint64_t readahead_begin_; // Part of the mapping last advised WILLNEED
+    uint64_t readahead_end_;
+};
+
 SSTable::SSTable(const std::string& path,
                  const std::vector<std::pair<std::string, std::string>>& entries,
-                 int level)
+                 int level,
+                 const TableOptions& options)
     : path_(path),
+      options_(options),
+      cache_id_(BlockCache::NewId()),
+      format_version_(kCompressionFormatVersion),
       level_(level),
       size_(0),
-      bloom_filter_(std::make_unique<BloomFilter>(entries.size() * 10, 3)) {
-    WriteToDisk(entries);
+      smallest_sequence_(0),
+      largest_sequence_(0),
+      prefix_filtered_(false),
+      compressor_(nullptr),
+      obsolete_(false),
+      loaded_(true),
+      mapped_(nullptr),
+      mapped_size_(0) {
+    TableBuilder builder(path_, level_, options_);
+    for (const auto& [key, value] : entries) {
+        builder.Add(key, value, 0);
+    }
+    builder.Finish();
+    ReadFromDisk(true);
     size_ = std::filesystem::file_size(path_);
+    OpenForReads();
 }
 
-SSTable::SSTable(const std::string& path)
+SSTable::SSTable(const std::string& path, const TableOptions& options)
     : path_(path),
+      options_(options),
+      cache_id_(BlockCache::NewId()),
+      format_version_(0),
       level_(0),
-      size_(0) {
-    ReadFromDisk();
+      size_(0),
+      smallest_sequence_(0),
+      largest_sequence_(0),
+      prefix_filtered_(false),
+      compressor_(nullptr),
+      obsolete_(false),
+      loaded_(true),
+      mapped_(nullptr),
+      mapped_size_(0) {
+    ReadFromDisk(true);
     size_ = std::filesystem::file_size(path_);
+    OpenForReads();
 }
 
-void SSTable::WriteToDisk(const std::vector<std::pair<std::string, std::string>>& entries) {
-    std::ofstream file(path_, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Failed to open file for writing: " + path_);
-    }
-
-    // Write header
-    const uint32_t magic = 0x53535442; // "SSTB"
-    const uint32_t version = 1;
-    const uint64_t num_entries = entries.size();
-    
-    file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
-    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
-    file.write(reinterpret_cast<const char*>(&num_entries), sizeof(num_entries));
-
-    // Write entries
-    size_t offset = sizeof(magic) + sizeof(version) + sizeof(num_entries);
-    for (const auto& entry : entries) {
-        const auto& [key, value] = entry;
-        uint32_t key_len = key.size();
-        uint32_t value_len = value.size();
-
-        file.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
-        file.write(reinterpret_cast<const char*>(&value_len), sizeof(value_len));
-        file.write(key.data(), key_len);
-        file.write(value.data(), value_len);
-
-        bloom_filter_->Add(key);
-        index_.push_back({key, static_cast<uint32_t>(offset), key_len + value_len + 8});
-        offset += key_len + value_len + 8;
+SSTable::SSTable(const std::string& path, const FileMetaData& metadata,
+                 const TableOptions& options)
+    : path_(path),
+      options_(options),
+      cache_id_(BlockCache::NewId()),
+      format_version_(0),
+      level_(metadata.level),
+      size_(metadata.size),
+      smallest_key_(metadata.smallest_key),
+      largest_key_(metadata.largest_key),
+      smallest_sequence_(metadata.smallest_sequence),
+      largest_sequence_(metadata.largest_sequence),
+      range_tombstones_(metadata.range_tombstones),
+      prefix_filtered_(false),
+      compressor_(nullptr),
+      obsolete_(false),
+      loaded_(false),
+      mapped_(nullptr),
+      mapped_size_(0) {}
+
+void SSTable::Load() const {
+    if (IsLoaded()) {
+        return;
     }
+    std::call_once(load_once_, [this] {
+        // The description fields are read concurrently and never rewritten;
+        // everything else is written once here, before loaded_ publishes it
+        SSTable* self = const_cast<SSTable*>(this);
+        self->index_.clear();
+        self->ReadFromDisk(false);
+        self->OpenForReads();
+        self->loaded_.store(true, std::memory_order_release);
+    });
+}
 
-    // Write bloom filter
-    std::string bloom_data = bloom_filter_->Serialize();
-    uint32_t bloom_size = bloom_data.size();
-    file.write(reinterpret_cast<const char*>(&bloom_size), sizeof(bloom_size));
-    file.write(bloom_data.data(), bloom_size);
+SSTable::~SSTable() {
+    if (mapped_) {
+        munmap(const_cast<char*>(mapped_), mapped_size_);
+    }
+    file_.reset();
+    if (options_.table_cache) {
+        options_.table_cache->Evict(cache_id_);
+    }
+    if (obsolete_) {
+        // Nothing will read these blocks again
+        if (options_.block_cache) {
+            for (const auto& entry : index_) {
+                options_.block_cache->Erase(cache_id_, entry.offset);
+            }
+        }
+        std::error_code ec;
+        std::filesystem::remove(path_, ec);
+    }
+}
 
-    if (!index_.empty()) {
-        smallest_key_ = index_.front().key;
-        largest_key_ = index_.back().key;
+void SSTable::OpenForReads() {
+    if (options_.use_mmap_reads) {
+        MapFile();
+    } else if (!options_.table_cache) {
+        file_ = std::make_shared<RandomAccessFile>(path_);
     }
 }
 
-void SSTable::ReadFromDisk() {
+std::shared_ptr<RandomAccessFile> SSTable::GetFile() const {
+    if (file_) {
+        return file_;
+    }
+    return options_.table_cache->Open(cache_id_, path_);
+}
+
+void SSTable::MapFile() {
+    int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file for mapping: " + path_);
+    }
+    // A lazily opened table takes its size from its description. Pages of
+    // the mapping past the end of the file would raise SIGBUS when touched,
+    // so a file of any other size is refused.
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != size_) {
+        close(fd);
+        throw std::runtime_error("SSTable file size does not match its description: " + path_);
+    }
+    void* base = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file: " + path_);
+    }
+
+    // Point lookups touch one block, so readahead would mostly be wasted
+    madvise(base, size_, MADV_RANDOM);
+    mapped_ = static_cast<const char*>(base);
+    mapped_size_ = size_;
+}
+
+uint64_t SSTable::ReadAhead(uint64_t offset, uint64_t size) const {
+    // madvise wants a page-aligned start
+    const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t begin = offset / page_size * page_size;
+    const uint64_t end = std::min<uint64_t>(offset + size, mapped_size_);
+    if (begin < end) {
+        madvise(const_cast<char*>(mapped_) + begin, end - begin, MADV_WILLNEED);
+    }
+    return end;
+}
+
+const FilterPolicy* SSTable::FindFilterPolicy(const std::string& name) const {
+    if (options_.filter_policy && name == options_.filter_policy->Name()) {
+        return options_.filter_policy.get();
+    }
+    for (const auto& [level, policy] : options_.level_filter_policies) {
+        if (policy && name == policy->Name()) {
+            return policy.get();
+        }
+    }
+    return FindBuiltinFilterPolicy(name);
+}
+
+const Compressor* SSTable::FindCompressor(const std::string& name) const {
+    if (options_.compressor && name == options_.compressor->Name()) {
+        return options_.compressor.get();
+    }
+    for (const auto& [level, compressor] : options_.level_compressors) {
+        if (compressor && name == compressor->Name()) {
+            return compressor.get();
+        }
+    }
+    return FindBuiltinCompressor(name);
+}
+
+void SSTable::ReadFromDisk(bool read_metadata) {
     std::ifstream file(path_, std::ios::binary);
     if (!file) {
         throw std::runtime_error("Failed to open file for reading: " + path_);
     }
 
     // Read header
-    uint32_t magic, version;
-    uint64_t num_entries;
-    
-    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
-    file.read(reinterpret_cast<char*>(&version), sizeof(version));
-    file.read(reinterpret_cast<char*>(&num_entries), sizeof(num_entries));
-
-    if (magic != 0x53535442) {
+    char header[kTableHeaderSize];
+    if (!file.read(header, sizeof(header)) || DecodeFixed32(header) != kTableMagic) {
         throw std::runtime_error("Invalid SSTable file: " + path_);
     }
+    format_version_ = DecodeFixed32(header + 4);
+    uint64_t num_entries = DecodeFixed64(header + 8);
+
+    if (format_version_ == kLegacyFormatVersion) {
+        ReadLegacyIndex(file, num_entries, read_metadata);
+    } else if (format_version_ == kBlockFormatVersion ||
+               format_version_ == kBlockedFilterFormatVersion ||
+               format_version_ == kSequenceFormatVersion ||
+               format_version_ == kValueTypeFormatVersion ||
+               format_version_ == kCompressionFormatVersion) {
+        ReadBlockIndex(file, read_metadata);
+    } else {
+        throw std::runtime_error("Unsupported SSTable version " +
+                                 std::to_string(format_version_) + ": " + path_);
+    }
+}
 
-    // Read entries
-    size_t offset = sizeof(magic) + sizeof(version) + sizeof(num_entries);
+void SSTable::ReadLegacyIndex(std::ifstream& file, uint64_t num_entries,
+                              bool read_metadata) {
+    // Version 1 has no index on disk, so every entry is read to rebuild it
+    uint64_t offset = kTableHeaderSize;
     for (uint64_t i = 0; i < num_entries; ++i) {
         uint32_t key_len, value_len;
         file.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
         file.read(reinterpret_cast<char*>(&value_len), sizeof(value_len));
 
         std::string key(key_len, '\0');
-        std::string value(value_len, '\0');
         file.read(&key[0], key_len);
-        file.read(&value[0], value_len);
+        file.seekg(value_len, std::ios::cur);
 
-        index_.push_back({key, static_cast<uint32_t>(offset), key_len + value_len + 8});
+        index_.push_back({key, offset, key_len + value_len + 8ull});
         offset += key_len + value_len + 8;
     }
 
@@ -107,89 +350,392 @@ void SSTable::ReadFromDisk() {
     file.read(reinterpret_cast<char*>(&bloom_size), sizeof(bloom_size));
     std::string bloom_data(bloom_size, '\0');
     file.read(&bloom_data[0], bloom_size);
-    bloom_filter_ = BloomFilter::Deserialize(bloom_data);
+    if (!file) {
+        throw std::runtime_error("Truncated SSTable file: " + path_);
+    }
+    legacy_filter_ = std::move(bloom_data);
 
-    if (!index_.empty()) {
+    if (read_metadata && !index_.empty()) {
         smallest_key_ = index_.front().key;
         largest_key_ = index_.back().key;
     }
 }
 
-bool SSTable::Get(const std::string& key, std::string* value) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (!bloom_filter_->MightContain(key)) {
+void SSTable::ReadBlockIndex(std::ifstream& file, bool read_metadata) {
+    // Read footer
+    file.seekg(0, std::ios::end);
+    uint64_t file_size = static_cast<uint64_t>(file.tellg());
+    std::string footer;
+    if (file_size < kTableHeaderSize + kTableFooterSize ||
+        !ReadBlock(file, file_size - kTableFooterSize, kTableFooterSize, &footer) ||
+        DecodeFixed32(footer.data() + 48) != kTableMagic) {
+        throw std::runtime_error("Invalid SSTable footer: " + path_);
+    }
+    BlockHandle filter_handle{DecodeFixed64(footer.data()), DecodeFixed64(footer.data() + 8)};
+    BlockHandle properties_handle{DecodeFixed64(footer.data() + 16),
+                                  DecodeFixed64(footer.data() + 24)};
+    BlockHandle index_handle{DecodeFixed64(footer.data() + 32), DecodeFixed64(footer.data() + 40)};
+
+    // Read properties block
+    std::string properties;
+    if (!ReadBlock(file, properties_handle.offset, properties_handle.size, &properties)) {
+        throw std::runtime_error("Failed to read properties block: " + path_);
+    }
+    size_t pos = 0;
+    std::string name, value;
+    std::string policy_name = kDefaultFilterPolicy;
+    while (GetLengthPrefixed(properties, &pos, &name) &&
+           GetLengthPrefixed(properties, &pos, &value)) {
+        if (name == kFilterPolicyProperty) {
+            policy_name = value;
+        } else if (name == kPrefixExtractorProperty) {
+            prefix_filtered_ = options_.prefix_extractor &&
+                               value == options_.prefix_extractor->Name();
+        } else if (name == kCompressionProperty) {
+            // Unlike a filter, the data cannot be read without its compressor
+            compressor_ = FindCompressor(value);
+            if (!compressor_) {
+                throw std::runtime_error("Unknown compressor " + value + ": " + path_);
+            }
+        } else if (!read_metadata) {
+            continue;
+        } else if (name == kSmallestKeyProperty) {
+            smallest_key_ = value;
+        } else if (name == kLargestKeyProperty) {
+            largest_key_ = value;
+        } else if (name == kLevelProperty) {
+            level_ = std::atoi(value.c_str());
+        } else if (name == kLargestSequenceProperty) {
+            largest_sequence_ = std::stoull(value);
+        } else if (name == kSmallestSequenceProperty) {
+            smallest_sequence_ = std::stoull(value);
+        } else if (name == kRangeTombstonesProperty) {
+            if (!DecodeRangeTombstones(value, &range_tombstones_)) {
+                throw std::runtime_error("Corrupt range tombstones: " + path_);
+            }
+        }
+    }
+
+    // Read filter block
+    std::string filter;
+    if (!ReadBlock(file, filter_handle.offset, filter_handle.size, &filter)) {
+        throw std::runtime_error("Failed to read filter block: " + path_);
+    }
+    if (format_version_ == kBlockFormatVersion) {
+        legacy_filter_ = std::move(filter);
+    } else if (!filter.empty()) {
+        // A table built by an unknown policy is read without filtering
+        if (const FilterPolicy* policy = FindFilterPolicy(policy_name)) {
+            filter_ = policy->LoadFilter(filter);
+            if (!filter_) {
+                throw std::runtime_error("Corrupt filter block: " + path_);
+            }
+        }
+    }
+
+    // Read index block
+    std::string index;
+    if (!ReadBlock(file, index_handle.offset, index_handle.size, &index)) {
+        throw std::runtime_error("Failed to read index block: " + path_);
+    }
+    pos = 0;
+    std::string key;
+    while (GetLengthPrefixed(index, &pos, &key)) {
+        if (index.size() - pos < 16) {
+            throw std::runtime_error("Corrupt index block: " + path_);
+        }
+        index_.push_back({key, DecodeFixed64(index.data() + pos),
+                          DecodeFixed64(index.data() + pos + 8)});
+        pos += 16;
+    }
+}
+
+bool SSTable::ReadBlock(std::ifstream& file, uint64_t offset, uint64_t size,
+                        std::string* contents) const {
+    contents->resize(size);
+    file.clear();
+    file.seekg(offset);
+    return static_cast<bool>(file.read(&(*contents)[0], size));
+}
+
+bool SSTable::ParseBlockTrailer(std::string_view* block, bool* compressed) const {
+    *compressed = false;
+    if (format_version_ < kCompressionFormatVersion) {
+        return true;
+    }
+    if (block->size() < kBlockTrailerSize) {
         return false;
     }
-    return BinarySearch(key, value);
+    const uint8_t type = static_cast<uint8_t>(block->back());
+    block->remove_suffix(kBlockTrailerSize);
+    if (type == kCompressedBlock) {
+        *compressed = true;
+        return compressor_ != nullptr;
+    }
+    return type == kRawBlock;
 }
 
-bool SSTable::BinarySearch(const std::string& key, std::string* value) const {
-    std::ifstream file(path_, std::ios::binary);
-    if (!file) {
+void SSTable::ReadDataBlock(const IndexEntry& entry,
+                            std::shared_ptr<const std::string>* holder,
+                            std::string_view* contents,
+                            bool fill_cache) const {
+    std::string_view stored;
+    bool compressed = false;
+    if (mapped_) {
+        if (entry.offset > mapped_size_ || entry.size > mapped_size_ - entry.offset) {
+            throw std::runtime_error("Data block out of bounds: " + path_);
+        }
+        stored = std::string_view(mapped_ + entry.offset, entry.size);
+        if (!ParseBlockTrailer(&stored, &compressed)) {
+            throw std::runtime_error("Corrupt data block trailer: " + path_);
+        }
+        if (!compressed) {
+            *contents = stored;
+            return;
+        }
+    }
+
+    BlockCache* cache = options_.block_cache.get();
+    if (cache) {
+        if (auto block = cache->Lookup(cache_id_, entry.offset)) {
+            *contents = *block;
+            *holder = std::move(block);
+            return;
+        }
+    }
+
+    auto block = std::make_shared<std::string>();
+    if (!mapped_) {
+        // GetFile throws if an evicted descriptor cannot be reopened
+        if (!GetFile()->Read(entry.offset, entry.size, block.get())) {
+            throw std::runtime_error("Failed to read data block: " + path_);
+        }
+        stored = *block;
+        if (!ParseBlockTrailer(&stored, &compressed)) {
+            throw std::runtime_error("Corrupt data block trailer: " + path_);
+        }
+        if (!compressed) {
+            block->resize(stored.size());
+        }
+    }
+    if (compressed) {
+        // stored may point into block, so uncompress into a fresh string
+        auto raw = std::make_shared<std::string>();
+        if (!compressor_->Uncompress(stored, raw.get())) {
+            throw std::runtime_error("Corrupt compressed data block: " + path_);
+        }
+        block = std::move(raw);
+    }
+
+    if (cache && fill_cache) {
+        cache->Insert(cache_id_, entry.offset, block);
+    }
+    *contents = *block;
+    *holder = std::move(block);
+}
+
+void SSTable::CheckBlockEnd(std::string_view block, size_t pos) const {
+    if (pos != block.size()) {
+        throw std::runtime_error("Corrupt entry in data block: " + path_);
+    }
+}
+
+std::vector<std::string> SSTable::GetIndexKeys() const {
+    Load();
+    std::vector<std::string> keys;
+    keys.reserve(index_.size());
+    for (const auto& entry : index_) {
+        keys.push_back(entry.key);
+    }
+    return keys;
+}
+
+std::unique_ptr<Iterator> SSTable::NewIterator(bool fill_cache) const {
+    Load();
+    return std::make_unique<TableIterator>(this, fill_cache);
+}
+
+bool SSTable::KeyMayMatch(const std::string& key) const {
+    if (filter_) {
+        return filter_->MightContain(key);
+    }
+    if (format_version_ < kBlockedFilterFormatVersion) {
+        return BloomFilter::LegacyMightContain(legacy_filter_, key);
+    }
+    return true;
+}
+
+bool SSTable::PrefixMayMatch(std::string_view prefix) const {
+    Load();
+    if (!filter_ || !prefix_filtered_) {
+        return true;
+    }
+    return filter_->MightContain(std::string(prefix));
+}
+
+bool SSTable::Get(const std::string& key, std::string* value, uint64_t sequence) const {
+    ValueType type;
+    uint64_t found_sequence;
+    return Find(key, sequence, value, &type, &found_sequence) && type == ValueType::kValue;
+}
+
+bool SSTable::Find(const std::string& key, uint64_t sequence, std::string* value,
+                   ValueType* type, uint64_t* found_sequence) const {
+    Load();
+    if (!KeyMayMatch(key)) {
         return false;
     }
+    return BinarySearch(key, sequence, value, type, found_sequence);
+}
 
+bool SSTable::BinarySearch(const std::string& key, uint64_t sequence, std::string* value,
+                           ValueType* type, uint64_t* found_sequence) const {
+    // The key starts in the first block ending at or after it; its versions
+    // may run on into the following blocks
     auto it = std::lower_bound(index_.begin(), index_.end(), key,
         [](const IndexEntry& entry, const std::string& k) {
             return entry.key < k;
         });
 
-    if (it == index_.end() || it->key != key) {
-        return false;
+    std::shared_ptr<const std::string> holder;
+    std::string_view block;
+    for (; it != index_.end(); ++it) {
+        ReadDataBlock(*it, &holder, &block);
+
+        size_t pos = 0;
+        std::string_view entry_key, entry_value;
+        uint64_t entry_sequence;
+        ValueType entry_type;
+        while (DecodeEntry(block, format_version_, &pos, &entry_key, &entry_sequence,
+                           &entry_type, &entry_value)) {
+            if (entry_key > key) {
+                return false;
+            }
+            if (entry_key == key && entry_sequence <= sequence) {
+                value->assign(entry_value);
+                *type = entry_type;
+                *found_sequence = entry_sequence;
+                return true;
+            }
+        }
+        CheckBlockEnd(block, pos);
     }
+    return false;
+}
 
-    file.seekg(it->offset);
-    uint32_t key_len, value_len;
-    file.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
-    file.read(reinterpret_cast<char*>(&value_len), sizeof(value_len));
-
-    // Skip key
-    file.seekg(key_len, std::ios::cur);
-
-    // Read value
-    value->resize(value_len);
-    file.read(&(*value)[0], value_len);
+void SSTable::MultiFind(const std::vector<KeyLookup*>& lookups, uint64_t sequence) const {
+    Load();
+    std::vector<KeyLookup*> candidates;
+    for (KeyLookup* lookup : lookups) {
+        if (!lookup->found && KeyMayMatch(*lookup->key)) {
+            candidates.push_back(lookup);
+        }
+    }
 
-    return true;
+    std::shared_ptr<const std::string> holder;
+    std::string_view block;
+    auto block_it = index_.begin();
+    size_t next = 0;
+    while (next < candidates.size()) {
+        // Keys are sorted, so the block of each key is at or after the last one
+        block_it = std::lower_bound(block_it, index_.end(), *candidates[next]->key,
+            [](const IndexEntry& entry, const std::string& k) {
+                return entry.key < k;
+            });
+        if (block_it == index_.end()) {
+            return;
+        }
+
+        // Every key up to the last key of the block is resolved in one pass;
+        // only versions of that last key may run on into the following blocks
+        size_t end = next;
+        while (end < candidates.size() && *candidates[end]->key <= block_it->key) {
+            ++end;
+        }
+        size_t current = next;
+        for (auto it = block_it; it != index_.end() && current < end; ++it) {
+            ReadDataBlock(*it, &holder, &block);
+
+            size_t pos = 0;
+            std::string_view entry_key, entry_value;
+            uint64_t entry_sequence;
+            ValueType entry_type;
+            while (current < end &&
+                   DecodeEntry(block, format_version_, &pos, &entry_key, &entry_sequence,
+                               &entry_type, &entry_value)) {
+                // Keys before this entry have no version in the table
+                while (current < end && *candidates[current]->key < entry_key) {
+                    ++current;
+                }
+                if (current < end && *candidates[current]->key == entry_key &&
+                    entry_sequence <= sequence) {
+                    KeyLookup* lookup = candidates[current++];
+                    lookup->value.assign(entry_value);
+                    lookup->type = entry_type;
+                    lookup->found_sequence = entry_sequence;
+                    lookup->found = true;
+                }
+            }
+            if (current < end) {
+                CheckBlockEnd(block, pos);
+            }
+        }
+        next = end;
+    }
 }
 
 std::vector<std::pair<std::string, std::string>> SSTable::GetRange(
     const std::string& start_key,
     const std::string& end_key) const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    Load();
     std::vector<std::pair<std::string, std::string>> result;
 
-    auto start_it = std::lower_bound(index_.begin(), index_.end(), start_key,
+    auto it = std::lower_bound(index_.begin(), index_.end(), start_key,
         [](const IndexEntry& entry, const std::string& k) {
             return entry.key < k;
         });
 
-    auto end_it = std::upper_bound(index_.begin(), index_.end(), end_key,
-        [](const std::string& k, const IndexEntry& entry) {
-            return k < entry.key;
-        });
-
-    std::ifstream file(path_, std::ios::binary);
-    if (!file) {
-        return result;
+    if (mapped_ && it != index_.end()) {
+        // Ask the kernel to read ahead every block the scan can touch
+        auto last = std::lower_bound(it, index_.end(), end_key,
+            [](const IndexEntry& entry, const std::string& k) {
+                return entry.key < k;
+            });
+        if (last == index_.end()) {
+            --last;
+        }
+        ReadAhead(it->offset, last->offset + last->size - it->offset);
     }
 
-    for (auto it = start_it; it != end_it; ++it) {
-        file.seekg(it->offset);
-        uint32_t key_len, value_len;
-        file.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
-        file.read(reinterpret_cast<char*>(&value_len), sizeof(value_len));
-
-        std::string key(key_len, '\0');
-        std::string value(value_len, '\0');
-        file.read(&key[0], key_len);
-        file.read(&value[0], value_len);
-
-        result.emplace_back(std::move(key), std::move(value));
+    std::shared_ptr<const std::string> holder;
+    std::string_view block;
+    std::string last_key; // Versions of a key may span blocks
+    bool seen = false;
+    for (; it != index_.end(); ++it) {
+        ReadDataBlock(*it, &holder, &block);
+
+        size_t pos = 0;
+        std::string_view key, value;
+        uint64_t sequence;
+        ValueType type;
+        while (DecodeEntry(block, format_version_, &pos, &key, &sequence, &type, &value)) {
+            if (key > end_key) {
+                return result;
+            }
+            // Older versions follow the newest one, which alone decides
+            // whether the key is live
+            if (key >= start_key && (!seen || key != last_key)) {
+                seen = true;
+                last_key.assign(key);
+                if (type == ValueType::kValue) {
+                    result.emplace_back(key, value);
+                }
+            }
+        }
+        CheckBlockEnd(block, pos);
     }
 
     return result;
 }
 
-} // namespace sstable 
\ No newline at end of file
+} // namespace sstable
\ No newline at end of file
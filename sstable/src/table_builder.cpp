@@ -0,0 +1,212 @@
+#include "table_builder.h"
+#include "table_format.h"
+#include "random_access_file.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+namespace sstable {
+
+TableBuilder::TableBuilder(const std::string& path, int level, const TableOptions& options)
+    : path_(path),
+      level_(level),
+      options_(options),
+      file_(path, std::ios::binary),
+      offset_(0),
+      num_entries_(0),
+      smallest_sequence_(kMaxSequenceNumber),
+      largest_sequence_(0),
+      has_prefix_(false),
+      finished_(false) {
+    if (!file_) {
+        throw std::runtime_error("Failed to open file for writing: " + path_);
+    }
+    compressor_ = ChooseCompressor();
+
+    // The entry count is patched in by Finish()
+    std::string header;
+    PutFixed32(&header, kTableMagic);
+    PutFixed32(&header, kCompressionFormatVersion);
+    PutFixed64(&header, 0);
+    Write(header);
+}
+
+TableBuilder::~TableBuilder() {
+    if (!finished_) {
+        file_.close();
+        std::error_code ec;
+        std::filesystem::remove(path_, ec);
+    }
+}
+
+void TableBuilder::Write(std::string_view data) {
+    file_.write(data.data(), data.size());
+    offset_ += data.size();
+}
+
+void TableBuilder::Add(std::string_view key, std::string_view value, uint64_t sequence,
+                       ValueType type) {
+    if (num_entries_ == 0) {
+        smallest_key_ = key;
+    }
+    EncodeEntry(&block_, key, sequence, type, value);
+    smallest_sequence_ = std::min(smallest_sequence_, sequence);
+    largest_sequence_ = std::max(largest_sequence_, sequence);
+
+    // Versions of a key are adjacent and share one filter entry
+    if (num_entries_ == 0 || key != last_key_) {
+        filter_hashes_.push_back(Hash64(key.data(), key.size()));
+    }
+
+    const PrefixExtractor* extractor = options_.prefix_extractor.get();
+    if (extractor && extractor->InDomain(key)) {
+        // Keys arrive sorted, so equal prefixes are adjacent
+        std::string_view prefix = extractor->Transform(key);
+        if (!has_prefix_ || prefix != last_prefix_) {
+            filter_hashes_.push_back(Hash64(prefix.data(), prefix.size()));
+            last_prefix_ = prefix;
+            has_prefix_ = true;
+        }
+    }
+
+    last_key_ = key;
+    ++num_entries_;
+    if (block_.size() >= options_.block_size) {
+        FlushBlock();
+    }
+}
+
+void TableBuilder::AddRangeTombstone(const RangeTombstone& tombstone) {
+    smallest_sequence_ = std::min(smallest_sequence_, tombstone.sequence);
+    largest_sequence_ = std::max(largest_sequence_, tombstone.sequence);
+    range_tombstones_.push_back(tombstone);
+}
+
+void TableBuilder::FlushBlock() {
+    std::string_view contents = block_;
+    char type = static_cast<char>(kRawBlock);
+    if (compressor_ && compressor_->Compress(block_, &compressed_block_)) {
+        // Blocks that barely shrink are not worth decompressing on every read
+        const size_t savings = std::min<size_t>(options_.min_compression_savings_percent, 100);
+        if (compressed_block_.size() * 100 <= block_.size() * (100 - savings)) {
+            contents = compressed_block_;
+            type = static_cast<char>(kCompressedBlock);
+        }
+    }
+
+    index_.push_back({last_key_, offset_, contents.size() + kBlockTrailerSize});
+    Write(contents);
+    Write(std::string_view(&type, kBlockTrailerSize));
+    block_.clear();
+}
+
+std::shared_ptr<const FilterPolicy> TableBuilder::ChooseFilterPolicy() const {
+    auto it = options_.level_filter_policies.find(level_);
+    if (it != options_.level_filter_policies.end()) {
+        return it->second;
+    }
+    if (options_.filter_policy) {
+        return options_.filter_policy;
+    }
+    if (options_.bloom_bits_per_key > 0) {
+        return NewBloomFilterPolicy(options_.bloom_bits_per_key);
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const Compressor> TableBuilder::ChooseCompressor() const {
+    auto it = options_.level_compressors.find(level_);
+    if (it != options_.level_compressors.end()) {
+        return it->second;
+    }
+    return options_.compressor;
+}
+
+void TableBuilder::Finish() {
+    if (!block_.empty()) {
+        FlushBlock();
+    }
+
+    // Write filter block; it is empty when filtering is disabled
+    std::shared_ptr<const FilterPolicy> policy = ChooseFilterPolicy();
+    std::string filter;
+    if (policy) {
+        filter = policy->CreateFilter(filter_hashes_);
+    }
+    BlockHandle filter_handle{offset_, filter.size()};
+    Write(filter);
+
+    // Write properties block
+    const PrefixExtractor* extractor = options_.prefix_extractor.get();
+    std::string properties;
+    PutLengthPrefixed(&properties, kSmallestKeyProperty);
+    PutLengthPrefixed(&properties, smallest_key_);
+    PutLengthPrefixed(&properties, kLargestKeyProperty);
+    PutLengthPrefixed(&properties, last_key_);
+    PutLengthPrefixed(&properties, kLevelProperty);
+    PutLengthPrefixed(&properties, std::to_string(level_));
+    PutLengthPrefixed(&properties, kLargestSequenceProperty);
+    PutLengthPrefixed(&properties, std::to_string(largest_sequence_));
+    PutLengthPrefixed(&properties, kSmallestSequenceProperty);
+    PutLengthPrefixed(&properties, std::to_string(
+        smallest_sequence_ == kMaxSequenceNumber ? 0 : smallest_sequence_));
+    if (!range_tombstones_.empty()) {
+        PutLengthPrefixed(&properties, kRangeTombstonesProperty);
+        PutLengthPrefixed(&properties, EncodeRangeTombstones(range_tombstones_));
+    }
+    if (compressor_) {
+        PutLengthPrefixed(&properties, kCompressionProperty);
+        PutLengthPrefixed(&properties, compressor_->Name());
+    }
+    if (policy) {
+        PutLengthPrefixed(&properties, kFilterPolicyProperty);
+        PutLengthPrefixed(&properties, policy->Name());
+        if (extractor) {
+            PutLengthPrefixed(&properties, kPrefixExtractorProperty);
+            PutLengthPrefixed(&properties, extractor->Name());
+        }
+    }
+    BlockHandle properties_handle{offset_, properties.size()};
+    Write(properties);
+
+    // Write index block
+    std::string index;
+    for (const auto& entry : index_) {
+        PutLengthPrefixed(&index, entry.key);
+        PutFixed64(&index, entry.offset);
+        PutFixed64(&index, entry.size);
+    }
+    BlockHandle index_handle{offset_, index.size()};
+    Write(index);
+
+    // Write footer
+    std::string footer;
+    for (const auto& handle : {filter_handle, properties_handle, index_handle}) {
+        PutFixed64(&footer, handle.offset);
+        PutFixed64(&footer, handle.size);
+    }
+    PutFixed32(&footer, kTableMagic);
+    PutFixed32(&footer, kCompressionFormatVersion);
+    Write(footer);
+
+    // Patch the entry count into the header
+    std::string num_entries;
+    PutFixed64(&num_entries, num_entries_);
+    file_.seekp(8);
+    file_.write(num_entries.data(), num_entries.size());
+    file_.close();
+
+    if (!file_) {
+        throw std::runtime_error("Failed to write SSTable file: " + path_);
+    }
+
+    // Once Finish returns the table may be listed in the MANIFEST and the
+    // logs holding its writes deleted, so it must survive a crash
+    std::string dir = std::filesystem::path(path_).parent_path().string();
+    if (!SyncPath(path_) || !SyncPath(dir.empty() ? "." : dir)) {
+        throw std::runtime_error("Failed to sync SSTable file: " + path_);
+    }
+    finished_ = true;
+}
+
+} // namespace sstable
\ No newline at end of file
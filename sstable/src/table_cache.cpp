@@ -0,0 +1,54 @@
+#include "table_cache.h"
+#include <algorithm>
+
+namespace sstable {
+
+TableCache::TableCache(size_t max_open_files)
+    : max_open_files_(std::max<size_t>(max_open_files, 1)) {}
+
+std::shared_ptr<RandomAccessFile> TableCache::Open(uint64_t table_id,
+                                                   const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = files_.find(table_id);
+        if (it != files_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->second;
+        }
+    }
+
+    // Open outside the lock so a slow open does not stall hits on other tables
+    auto file = std::make_shared<RandomAccessFile>(path);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(table_id);
+    if (it != files_.end()) {
+        // Another reader opened it first
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->second;
+    }
+
+    lru_.emplace_front(table_id, file);
+    files_[table_id] = lru_.begin();
+    while (lru_.size() > max_open_files_) {
+        files_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+    return file;
+}
+
+void TableCache::Evict(uint64_t table_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(table_id);
+    if (it != files_.end()) {
+        lru_.erase(it->second);
+        files_.erase(it);
+    }
+}
+
+size_t TableCache::GetOpenFiles() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "version_edit.h"
+#include "coding.h"
+#include "table_format.h"
+
+namespace sstable {
+
+namespace {
+
+// Field tags inside a MANIFEST record
+enum EditTag : uint64_t {
+    kLogNumber = 1,
+    kLastSequence = 2,
+    kDeletedFile = 3,
+    kNewFile = 4,
+    kNewFileRangeTombstones = 5, // Of the new file before it
+};
+
+bool GetVarint(const std::string& src, size_t* pos, uint64_t* value) {
+    const char* next = GetVarint64(src.data() + *pos, src.data() + src.size(), value);
+    if (!next) {
+        return false;
+    }
+    *pos = static_cast<size_t>(next - src.data());
+    return true;
+}
+
+} // namespace
+
+void VersionEdit::EncodeTo(std::string* dst) const {
+    if (has_log_number) {
+        PutVarint64(dst, kLogNumber);
+        PutVarint64(dst, log_number);
+    }
+    if (has_last_sequence) {
+        PutVarint64(dst, kLastSequence);
+        PutVarint64(dst, last_sequence);
+    }
+    for (const auto& path : deleted_files) {
+        PutVarint64(dst, kDeletedFile);
+        PutLengthPrefixed(dst, path);
+    }
+    for (const auto& file : new_files) {
+        PutVarint64(dst, kNewFile);
+        PutVarint64(dst, static_cast<uint64_t>(file.level));
+        PutLengthPrefixed(dst, file.path);
+        PutLengthPrefixed(dst, file.smallest_key);
+        PutLengthPrefixed(dst, file.largest_key);
+        PutVarint64(dst, file.size);
+        PutVarint64(dst, file.smallest_sequence);
+        PutVarint64(dst, file.largest_sequence);
+        if (!file.range_tombstones.empty()) {
+            PutVarint64(dst, kNewFileRangeTombstones);
+            PutLengthPrefixed(dst, EncodeRangeTombstones(file.range_tombstones));
+        }
+    }
+}
+
+bool VersionEdit::DecodeFrom(const std::string& src) {
+    *this = VersionEdit();
+    size_t pos = 0;
+    uint64_t tag;
+    while (pos < src.size()) {
+        if (!GetVarint(src, &pos, &tag)) {
+            return false;
+        }
+        switch (tag) {
+            case kLogNumber:
+                if (!GetVarint(src, &pos, &log_number)) {
+                    return false;
+                }
+                has_log_number = true;
+                break;
+            case kLastSequence:
+                if (!GetVarint(src, &pos, &last_sequence)) {
+                    return false;
+                }
+                has_last_sequence = true;
+                break;
+            case kDeletedFile: {
+                std::string path;
+                if (!GetLengthPrefixed(src, &pos, &path)) {
+                    return false;
+                }
+                deleted_files.push_back(std::move(path));
+                break;
+            }
+            case kNewFile: {
+                FileMetaData file;
+                uint64_t level;
+                if (!GetVarint(src, &pos, &level) ||
+                    !GetLengthPrefixed(src, &pos, &file.path) ||
+                    !GetLengthPrefixed(src, &pos, &file.smallest_key) ||
+                    !GetLengthPrefixed(src, &pos, &file.largest_key) ||
+                    !GetVarint(src, &pos, &file.size) ||
+                    !GetVarint(src, &pos, &file.smallest_sequence) ||
+                    !GetVarint(src, &pos, &file.largest_sequence)) {
+                    return false;
+                }
+                file.level = static_cast<int>(level);
+                new_files.push_back(std::move(file));
+                break;
+            }
+            case kNewFileRangeTombstones: {
+                std::string tombstones;
+                if (new_files.empty() || !GetLengthPrefixed(src, &pos, &tombstones) ||
+                    !DecodeRangeTombstones(tombstones, &new_files.back().range_tombstones)) {
+                    return false;
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+} // namespace sstable
\ No newline at end of file
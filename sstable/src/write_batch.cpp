@@ -0,0 +1,127 @@
+#include "write_batch.h"
+#include "coding.h"
+#include <cstring>
+
+namespace sstable {
+
+namespace {
+
+// Operation tags inside a log record
+enum RecordType : char {
+    kTypeDeletion = 0,
+    kTypeValue = 1,
+    kTypeSequence = 2, // Record header: sequence number of the first operation
+    kTypeRangeDeletion = 3, // Key is the start of the range, value its end
+};
+
+constexpr size_t kHeaderSize = 9; // kTypeSequence + sequence number
+
+void EncodeOperation(std::string* dst, RecordType type,
+                     const std::string& key, const std::string& value) {
+    dst->push_back(type);
+    PutFixed32(dst, static_cast<uint32_t>(key.size()));
+    PutFixed32(dst, static_cast<uint32_t>(value.size()));
+    dst->append(key);
+    dst->append(value);
+}
+
+// Decode the operations following the header, passing them to handler
+// unless it is nullptr; false if rep is malformed
+bool DecodeOperations(const std::string& rep, WriteBatch::Handler* handler, size_t* count) {
+    *count = 0;
+    size_t pos = kHeaderSize;
+    while (pos < rep.size()) {
+        if (rep.size() - pos < 9) {
+            return false;
+        }
+        const RecordType type = static_cast<RecordType>(rep[pos]);
+        const uint32_t key_len = DecodeFixed32(rep.data() + pos + 1);
+        const uint32_t value_len = DecodeFixed32(rep.data() + pos + 5);
+        pos += 9;
+        if (rep.size() - pos < static_cast<size_t>(key_len) + value_len) {
+            return false;
+        }
+        if (type != kTypeValue && type != kTypeDeletion && type != kTypeRangeDeletion) {
+            return false;
+        }
+
+        if (handler) {
+            std::string key = rep.substr(pos, key_len);
+            if (type == kTypeValue) {
+                handler->Put(key, rep.substr(pos + key_len, value_len));
+            } else if (type == kTypeRangeDeletion) {
+                handler->DeleteRange(key, rep.substr(pos + key_len, value_len));
+            } else {
+                handler->Delete(key);
+            }
+        }
+        pos += static_cast<size_t>(key_len) + value_len;
+        ++*count;
+    }
+    return true;
+}
+
+} // namespace
+
+WriteBatch::WriteBatch() {
+    Clear();
+}
+
+void WriteBatch::Put(const std::string& key, const std::string& value) {
+    EncodeOperation(&rep_, kTypeValue, key, value);
+    ++count_;
+}
+
+void WriteBatch::Delete(const std::string& key) {
+    EncodeOperation(&rep_, kTypeDeletion, key, "");
+    ++count_;
+}
+
+void WriteBatch::DeleteRange(const std::string& begin_key, const std::string& end_key) {
+    if (begin_key >= end_key) {
+        return;
+    }
+    EncodeOperation(&rep_, kTypeRangeDeletion, begin_key, end_key);
+    ++count_;
+}
+
+void WriteBatch::Append(const WriteBatch& other) {
+    rep_.append(other.rep_, kHeaderSize, std::string::npos);
+    count_ += other.count_;
+}
+
+void WriteBatch::Clear() {
+    rep_.clear();
+    rep_.push_back(kTypeSequence);
+    PutFixed64(&rep_, 0);
+    count_ = 0;
+}
+
+bool WriteBatch::Iterate(Handler* handler) const {
+    size_t count;
+    return DecodeOperations(rep_, handler, &count);
+}
+
+uint64_t WriteBatch::Sequence() const {
+    return DecodeFixed64(rep_.data() + 1);
+}
+
+void WriteBatch::SetSequence(uint64_t sequence) {
+    std::memcpy(&rep_[1], &sequence, sizeof(sequence));
+}
+
+bool WriteBatch::SetContents(const std::string& contents) {
+    if (!contents.empty() && contents[0] == kTypeSequence) {
+        if (contents.size() < kHeaderSize) {
+            return false;
+        }
+        rep_ = contents;
+    } else {
+        // Records logged before sequence numbers existed have no header
+        Clear();
+        rep_.append(contents);
+    }
+    return DecodeOperations(rep_, nullptr, &count_);
+}
+
+} // namespace sstable
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "xor_filter.h"
+#include "coding.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace sstable {
+
+namespace {
+
+// seed (8) + block length (4)
+constexpr size_t kXorHeaderSize = 12;
+
+// Construction fails with small probability for a given seed
+constexpr int kMaxAttempts = 100;
+
+uint64_t Finalize(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t RotateLeft(uint64_t h, int bits) {
+    return (h << bits) | (h >> (64 - bits));
+}
+
+// Map a 32-bit value onto [0, n) without a division
+uint32_t Reduce(uint32_t value, uint32_t n) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(value) * n) >> 32);
+}
+
+} // namespace
+
+XorFilter::XorFilter(uint64_t seed, uint32_t block_length)
+    : seed_(seed),
+      block_length_(block_length),
+      fingerprints_(static_cast<size_t>(block_length) * 3, 0) {}
+
+uint64_t XorFilter::Mix(uint64_t hash) const {
+    return Finalize(hash + seed_);
+}
+
+XorFilter::Slots XorFilter::GetSlots(uint64_t mixed) const {
+    Slots slots;
+    slots.index[0] = Reduce(static_cast<uint32_t>(mixed), block_length_);
+    slots.index[1] = Reduce(static_cast<uint32_t>(RotateLeft(mixed, 21)), block_length_) +
+                     block_length_;
+    slots.index[2] = Reduce(static_cast<uint32_t>(RotateLeft(mixed, 42)), block_length_) +
+                     2 * block_length_;
+    return slots;
+}
+
+uint8_t XorFilter::Fingerprint(uint64_t mixed) {
+    return static_cast<uint8_t>(mixed ^ (mixed >> 32));
+}
+
+std::unique_ptr<XorFilter> XorFilter::Build(std::vector<uint64_t> hashes) {
+    // Two equal hashes would never peel
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+    const size_t capacity = 32 + (hashes.size() * 123 + 99) / 100;
+    const uint32_t block_length = static_cast<uint32_t>((capacity + 2) / 3);
+
+    // For every slot: XOR of the mixed hashes mapped to it, and their count
+    std::vector<uint64_t> xor_masks;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> queue;
+    std::vector<std::pair<uint64_t, uint32_t>> stack; // (mixed hash, slot)
+
+    for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+        std::unique_ptr<XorFilter> filter(
+            new XorFilter(Finalize(0x9E3779B97F4A7C15ull * (attempt + 1)), block_length));
+        const size_t num_slots = filter->fingerprints_.size();
+        xor_masks.assign(num_slots, 0);
+        counts.assign(num_slots, 0);
+        queue.clear();
+        stack.clear();
+
+        for (uint64_t hash : hashes) {
+            const uint64_t mixed = filter->Mix(hash);
+            for (uint32_t slot : filter->GetSlots(mixed).index) {
+                xor_masks[slot] ^= mixed;
+                ++counts[slot];
+            }
+        }
+
+        // Peel slots that hold a single key until none are left
+        for (uint32_t slot = 0; slot < num_slots; ++slot) {
+            if (counts[slot] == 1) {
+                queue.push_back(slot);
+            }
+        }
+        while (!queue.empty()) {
+            const uint32_t slot = queue.back();
+            queue.pop_back();
+            if (counts[slot] != 1) {
+                continue;
+            }
+            const uint64_t mixed = xor_masks[slot];
+            stack.emplace_back(mixed, slot);
+            for (uint32_t other : filter->GetSlots(mixed).index) {
+                xor_masks[other] ^= mixed;
+                if (--counts[other] == 1) {
+                    queue.push_back(other);
+                }
+            }
+        }
+
+        if (stack.size() != hashes.size()) {
+            continue;
+        }
+
+        // Assign in reverse peeling order so each key's slot is the last
+        // of its three to be written
+        for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+            const auto [mixed, slot] = *it;
+            const Slots slots = filter->GetSlots(mixed);
+            filter->fingerprints_[slot] = Fingerprint(mixed) ^
+                                          filter->fingerprints_[slots.index[0]] ^
+                                          filter->fingerprints_[slots.index[1]] ^
+                                          filter->fingerprints_[slots.index[2]];
+        }
+        return filter;
+    }
+
+    throw std::runtime_error("Failed to build XOR filter");
+}
+
+bool XorFilter::MightContain(const std::string& key) const {
+    const uint64_t mixed = Mix(Hash64(key.data(), key.size()));
+    const Slots slots = GetSlots(mixed);
+    return Fingerprint(mixed) == (fingerprints_[slots.index[0]] ^
+                                  fingerprints_[slots.index[1]] ^
+                                  fingerprints_[slots.index[2]]);
+}
+
+std::string XorFilter::Serialize() const {
+    std::string result;
+    result.reserve(kXorHeaderSize + fingerprints_.size());
+    PutFixed64(&result, seed_);
+    PutFixed32(&result, block_length_);
+    result.append(reinterpret_cast<const char*>(fingerprints_.data()), fingerprints_.size());
+    return result;
+}
+
+std::unique_ptr<XorFilter> XorFilter::Deserialize(const std::string& data) {
+    if (data.size() < kXorHeaderSize) {
+        return nullptr;
+    }
+    const uint64_t seed = DecodeFixed64(data.data());
+    const uint32_t block_length = DecodeFixed32(data.data() + 8);
+    if (block_length == 0 ||
+        data.size() != kXorHeaderSize + static_cast<size_t>(block_length) * 3) {
+        return nullptr;
+    }
+
+    std::unique_ptr<XorFilter> filter(new XorFilter(seed, block_length));
+    std::copy(data.begin() + kXorHeaderSize, data.end(), filter->fingerprints_.begin());
+    return filter;
+}
+
+} // namespace sstable
\ No newline at end of file
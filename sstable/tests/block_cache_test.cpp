@@ -0,0 +1,137 @@
+#include "block_cache.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <memory>
+#include <vector>
+#include <thread>
+
+using namespace sstable;
+
+class BlockCacheTest : public ::testing::Test {
+protected:
+    static std::shared_ptr<const std::string> MakeBlock(size_t size, char fill) {
+        return std::make_shared<const std::string>(size, fill);
+    }
+};
+
+TEST_F(BlockCacheTest, InsertAndLookup) {
+    BlockCache cache(1024);
+
+    EXPECT_EQ(cache.Lookup(1, 0), nullptr);
+    cache.Insert(1, 0, MakeBlock(10, 'a'));
+    cache.Insert(2, 0, MakeBlock(10, 'b'));
+
+    auto block = cache.Lookup(1, 0);
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(*block, std::string(10, 'a'));
+    block = cache.Lookup(2, 0);
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(*block, std::string(10, 'b'));
+    EXPECT_EQ(cache.Lookup(1, 10), nullptr);
+
+    EXPECT_EQ(cache.GetHits(), 2);
+    EXPECT_EQ(cache.GetMisses(), 2);
+    EXPECT_EQ(cache.GetUsage(), 20);
+}
+
+TEST_F(BlockCacheTest, ReplaceExisting) {
+    BlockCache cache(1024);
+
+    cache.Insert(1, 0, MakeBlock(10, 'a'));
+    cache.Insert(1, 0, MakeBlock(20, 'b'));
+
+    auto block = cache.Lookup(1, 0);
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(*block, std::string(20, 'b'));
+    EXPECT_EQ(cache.GetUsage(), 20);
+}
+
+TEST_F(BlockCacheTest, EvictsLeastRecentlyUsed) {
+    // A single shard makes the eviction order deterministic
+    BlockCache cache(300, 0);
+
+    cache.Insert(1, 0, MakeBlock(100, 'a'));
+    cache.Insert(1, 100, MakeBlock(100, 'b'));
+    cache.Insert(1, 200, MakeBlock(100, 'c'));
+
+    // Touch the oldest block so the second one becomes the victim
+    EXPECT_NE(cache.Lookup(1, 0), nullptr);
+    cache.Insert(1, 300, MakeBlock(100, 'd'));
+
+    EXPECT_NE(cache.Lookup(1, 0), nullptr);
+    EXPECT_EQ(cache.Lookup(1, 100), nullptr);
+    EXPECT_NE(cache.Lookup(1, 200), nullptr);
+    EXPECT_NE(cache.Lookup(1, 300), nullptr);
+    EXPECT_LE(cache.GetUsage(), cache.GetCapacity());
+}
+
+TEST_F(BlockCacheTest, OversizedBlockIsNotCached) {
+    BlockCache cache(100, 0);
+
+    cache.Insert(1, 0, MakeBlock(50, 'a'));
+    cache.Insert(1, 50, MakeBlock(200, 'b'));
+
+    EXPECT_EQ(cache.Lookup(1, 50), nullptr);
+    EXPECT_NE(cache.Lookup(1, 0), nullptr);
+}
+
+TEST_F(BlockCacheTest, EvictedBlockStaysValidForReader) {
+    BlockCache cache(100, 0);
+
+    cache.Insert(1, 0, MakeBlock(100, 'a'));
+    auto block = cache.Lookup(1, 0);
+    cache.Insert(1, 100, MakeBlock(100, 'b'));
+
+    EXPECT_EQ(cache.Lookup(1, 0), nullptr);
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(*block, std::string(100, 'a'));
+}
+
+TEST_F(BlockCacheTest, Erase) {
+    BlockCache cache(1024);
+
+    cache.Insert(1, 0, MakeBlock(10, 'a'));
+    cache.Erase(1, 0);
+    cache.Erase(2, 0);
+
+    EXPECT_EQ(cache.Lookup(1, 0), nullptr);
+    EXPECT_EQ(cache.GetUsage(), 0);
+}
+
+TEST_F(BlockCacheTest, NewIdIsUnique) {
+    uint64_t first = BlockCache::NewId();
+    uint64_t second = BlockCache::NewId();
+    EXPECT_NE(first, second);
+}
+
+TEST_F(BlockCacheTest, ConcurrentAccess) {
+    BlockCache cache(64 * 1024);
+    const int num_threads = 4;
+    const int num_ops = 2000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&cache, t, num_ops]() {
+            for (int i = 0; i < num_ops; ++i) {
+                uint64_t offset = (i % 128) * 64;
+                auto block = cache.Lookup(t, offset);
+                if (!block) {
+                    cache.Insert(t, offset, MakeBlock(64, 'a' + t));
+                } else {
+                    EXPECT_EQ((*block)[0], 'a' + t);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(cache.GetHits() + cache.GetMisses(), num_threads * num_ops);
+    EXPECT_LE(cache.GetUsage(), cache.GetCapacity());
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
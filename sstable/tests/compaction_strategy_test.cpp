@@ -0,0 +1,142 @@
+#include "compaction_strategy.h"
+#include "compaction.h"
+#include "sstable.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <filesystem>
+#include <vector>
+
+using namespace sstable;
+
+class CompactionStrategyTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = "/tmp/compaction_strategy_test";
+        std::filesystem::create_directories(test_dir_);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(test_dir_);
+    }
+
+    // A table of roughly size_kb kilobytes
+    std::shared_ptr<SSTable> MakeTable(int level, int size_kb) {
+        std::vector<std::pair<std::string, std::string>> entries;
+        for (int i = 0; i < size_kb; ++i) {
+            char key[16];
+            snprintf(key, sizeof(key), "key%06d", i);
+            entries.emplace_back(key, std::string(1024, 'x'));
+        }
+        std::string path = test_dir_ + "/table" + std::to_string(next_table_++) + ".sst";
+        return std::make_shared<SSTable>(path, entries, level);
+    }
+
+    std::string test_dir_;
+    int next_table_ = 0;
+};
+
+TEST_F(CompactionStrategyTest, UniversalWaitsForTrigger) {
+    UniversalCompactionOptions options;
+    options.sorted_run_trigger = 4;
+    auto strategy = NewUniversalCompactionStrategy(options);
+
+    LevelTables levels;
+    for (int i = 0; i < 3; ++i) {
+        levels[0].push_back(MakeTable(0, 10));
+    }
+    CompactionJob job;
+    EXPECT_FALSE(strategy->PickCompaction(levels, {}, &job));
+
+    levels[0].push_back(MakeTable(0, 10));
+    EXPECT_TRUE(strategy->PickCompaction(levels, {}, &job));
+    EXPECT_FALSE(strategy->PickCompaction(levels, {0}, &job));
+}
+
+TEST_F(CompactionStrategyTest, UniversalSizeRatio) {
+    auto strategy = NewUniversalCompactionStrategy(UniversalCompactionOptions());
+
+    // One large old run and four similar new ones: only the new ones merge
+    LevelTables levels;
+    levels[0].push_back(MakeTable(0, 200));
+    for (int i = 0; i < 4; ++i) {
+        levels[0].push_back(MakeTable(0, 10));
+    }
+
+    CompactionJob job;
+    ASSERT_TRUE(strategy->PickCompaction(levels, {}, &job));
+    EXPECT_EQ(job.level, 0);
+    EXPECT_EQ(job.output_level, 0);
+    EXPECT_FALSE(job.split_output);
+    ASSERT_EQ(job.inputs.size(), 4);
+    EXPECT_EQ(job.inputs.front(), levels[0][1]);
+    EXPECT_EQ(job.inputs.back(), levels[0][4]);
+}
+
+TEST_F(CompactionStrategyTest, UniversalSpaceAmplification) {
+    auto strategy = NewUniversalCompactionStrategy(UniversalCompactionOptions());
+
+    // The newer runs are over twice the size of the oldest: merge everything
+    LevelTables levels;
+    levels[0].push_back(MakeTable(0, 10));
+    levels[0].push_back(MakeTable(0, 100));
+    levels[0].push_back(MakeTable(0, 40));
+    levels[0].push_back(MakeTable(0, 5));
+
+    CompactionJob job;
+    ASSERT_TRUE(strategy->PickCompaction(levels, {}, &job));
+    EXPECT_EQ(job.inputs, levels[0]);
+}
+
+TEST_F(CompactionStrategyTest, UniversalRunCount) {
+    auto strategy = NewUniversalCompactionStrategy(UniversalCompactionOptions());
+
+    // Each run is much smaller than the one before it, so no size ratio
+    // group forms; the newest runs merge to get back under the trigger
+    LevelTables levels;
+    for (int size_kb : {1000, 300, 100, 30, 10}) {
+        levels[0].push_back(MakeTable(0, size_kb));
+    }
+
+    CompactionJob job;
+    ASSERT_TRUE(strategy->PickCompaction(levels, {}, &job));
+    ASSERT_EQ(job.inputs.size(), 3);
+    EXPECT_EQ(job.inputs.front(), levels[0][2]);
+    EXPECT_EQ(job.inputs.back(), levels[0][4]);
+}
+
+TEST_F(CompactionStrategyTest, LeveledPicksOverfullLevel) {
+    auto strategy = NewLeveledCompactionStrategy();
+
+    LevelTables levels;
+    levels[0].push_back(MakeTable(0, 100));
+    CompactionJob job;
+    EXPECT_FALSE(strategy->PickCompaction(levels, {}, &job));
+
+    // Over the 2MB limit of level 0
+    levels[0].push_back(MakeTable(0, 2100));
+    levels[1].push_back(MakeTable(1, 10));
+    ASSERT_TRUE(strategy->PickCompaction(levels, {}, &job));
+    EXPECT_EQ(job.level, 0);
+    EXPECT_EQ(job.output_level, 1);
+    EXPECT_TRUE(job.split_output);
+
+    // The overlapping level-1 file comes first, as the oldest input
+    ASSERT_EQ(job.inputs.size(), 3);
+    EXPECT_EQ(job.inputs[0], levels[1][0]);
+    EXPECT_EQ(job.inputs[1], levels[0][0]);
+    EXPECT_EQ(job.inputs[2], levels[0][1]);
+
+    EXPECT_FALSE(strategy->PickCompaction(levels, {1}, &job));
+}
+
+TEST_F(CompactionStrategyTest, SelectedByOptions) {
+    Options options;
+    EXPECT_STREQ(NewCompactionStrategy(options)->Name(), "Leveled");
+    options.compaction_style = CompactionStyle::kUniversal;
+    EXPECT_STREQ(NewCompactionStrategy(options)->Name(), "Universal");
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
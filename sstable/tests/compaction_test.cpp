@@ -1,8 +1,10 @@
 #include "compaction.h"
 #include "sstable.h"
+#include "table_builder.h"
 #include <gtest/gtest.h>
 #include <string>
 #include <filesystem>
+#include <iterator>
 #include <vector>
 
 using namespace sstable;
@@ -114,14 +116,13 @@ TEST_F(CompactionTest, TombstoneHandling) {
         0));
     
     // Second SSTable with tombstone
-    std::vector<std::pair<std::string, std::string>> entries2 = {
-        {"key2", ""}, // Tombstone
-        {"key3", "value3"}
-    };
-    input_tables.push_back(std::make_unique<SSTable>(
-        test_dir_ + "/table2.sst",
-        entries2,
-        0));
+    {
+        TableBuilder builder(test_dir_ + "/table2.sst", 0, TableOptions());
+        builder.Add("key2", "", 0, ValueType::kDeletion);
+        builder.Add("key3", "value3", 0);
+        builder.Finish();
+    }
+    input_tables.push_back(std::make_unique<SSTable>(test_dir_ + "/table2.sst"));
     
     // Compact to level 1
     auto new_table = compaction_->Compact(input_tables, 1);
@@ -135,6 +136,259 @@ TEST_F(CompactionTest, TombstoneHandling) {
     EXPECT_EQ(value, "value3");
 }
 
+TEST_F(CompactionTest, StreamingMergeOfManyInputs) {
+    // Overlapping inputs with small blocks, so the merge crosses many block
+    // boundaries in every input at once
+    TableOptions options;
+    options.block_size = 128;
+    Compaction compaction(test_dir_, options);
+
+    const int kNumTables = 8;
+    const int kNumKeys = 400;
+    std::vector<std::shared_ptr<SSTable>> input_tables;
+    for (int t = 0; t < kNumTables; ++t) {
+        std::vector<std::pair<std::string, std::string>> entries;
+        for (int i = t; i < kNumKeys; i += t + 1) {
+            char key[16];
+            snprintf(key, sizeof(key), "key%04d", i);
+            entries.emplace_back(key, "table" + std::to_string(t));
+        }
+        input_tables.push_back(std::make_shared<SSTable>(
+            test_dir_ + "/table" + std::to_string(t) + ".sst", entries, 0, options));
+    }
+
+    auto new_table = compaction.Compact(input_tables, 2);
+    EXPECT_EQ(new_table->GetLevel(), 2);
+    EXPECT_EQ(new_table->GetSmallestKey(), "key0000");
+    EXPECT_EQ(new_table->GetLargestKey(), "key0399");
+
+    // Every key appears once, with the value of the newest table holding it
+    auto it = new_table->NewIterator();
+    int count = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", count);
+        ASSERT_EQ(it->Key(), key);
+        int newest = -1;
+        for (int t = 0; t < kNumTables; ++t) {
+            if (count >= t && (count - t) % (t + 1) == 0) {
+                newest = t;
+            }
+        }
+        EXPECT_EQ(it->Value(), "table" + std::to_string(newest));
+        ++count;
+    }
+    EXPECT_EQ(count, kNumKeys);
+}
+
+TEST_F(CompactionTest, CompactToLevelSplitsOutput) {
+    TableOptions options;
+    options.block_size = 256;
+    Compaction compaction(test_dir_, options, 4 * 1024);
+
+    std::vector<std::shared_ptr<SSTable>> input_tables;
+    for (int t = 0; t < 2; ++t) {
+        std::vector<std::pair<std::string, std::string>> entries;
+        for (int i = t; i < 1000; i += 2) {
+            char key[16];
+            snprintf(key, sizeof(key), "key%04d", i);
+            entries.emplace_back(key, std::string(50, 'a' + t));
+        }
+        input_tables.push_back(std::make_shared<SSTable>(
+            test_dir_ + "/table" + std::to_string(t) + ".sst", entries, 0, options));
+    }
+
+    auto outputs = compaction.CompactToLevel(input_tables, 1);
+    ASSERT_GT(outputs.size(), 5);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        EXPECT_EQ(outputs[i]->GetLevel(), 1);
+        if (i > 0) {
+            EXPECT_LT(outputs[i - 1]->GetLargestKey(), outputs[i]->GetSmallestKey());
+        }
+    }
+    EXPECT_EQ(outputs.front()->GetSmallestKey(), "key0000");
+    EXPECT_EQ(outputs.back()->GetLargestKey(), "key0999");
+
+    std::vector<std::shared_ptr<SSTable>> level(std::make_move_iterator(outputs.begin()),
+                                                std::make_move_iterator(outputs.end()));
+    auto overlapping = Compaction::GetOverlappingTables(
+        level, level[1]->GetLargestKey(), level[2]->GetSmallestKey());
+    ASSERT_EQ(overlapping.size(), 2);
+    EXPECT_EQ(overlapping[0], level[1]);
+    EXPECT_EQ(overlapping[1], level[2]);
+    EXPECT_TRUE(Compaction::GetOverlappingTables(level, "a", "b").empty());
+
+    // Empty inputs produce no files
+    std::vector<std::shared_ptr<SSTable>> empty_inputs = {
+        std::make_shared<SSTable>(test_dir_ + "/empty.sst",
+                                  std::vector<std::pair<std::string, std::string>>(), 0)};
+    EXPECT_TRUE(compaction.CompactToLevel(empty_inputs, 1).empty());
+}
+
+TEST_F(CompactionTest, ParallelSubcompactions) {
+    TableOptions options;
+    options.block_size = 512;
+
+    // Overlapping inputs, the later ones overwriting part of the earlier ones
+    std::vector<std::shared_ptr<SSTable>> input_tables;
+    for (int t = 0; t < 4; ++t) {
+        std::vector<std::pair<std::string, std::string>> entries;
+        for (int i = t * 500; i < 4000; i += t + 1) {
+            char key[16];
+            snprintf(key, sizeof(key), "key%05d", i);
+            entries.emplace_back(key, std::string(100, 'a' + t));
+        }
+        input_tables.push_back(std::make_shared<SSTable>(
+            test_dir_ + "/table" + std::to_string(t) + ".sst", entries, 0, options));
+    }
+
+    auto contents = [](const std::vector<std::unique_ptr<SSTable>>& tables) {
+        std::vector<std::pair<std::string, std::string>> result;
+        for (size_t i = 0; i < tables.size(); ++i) {
+            if (i > 0) {
+                EXPECT_LT(tables[i - 1]->GetLargestKey(), tables[i]->GetSmallestKey());
+            }
+            auto it = tables[i]->NewIterator();
+            for (it->SeekToFirst(); it->Valid(); it->Next()) {
+                result.emplace_back(it->Key(), it->Value());
+            }
+        }
+        return result;
+    };
+
+    Compaction serial(test_dir_ + "/serial", options, 32 * 1024, 1);
+    auto expected = contents(serial.CompactToLevel(input_tables, 1));
+
+    // Split into key ranges merged on several threads, with the same result
+    Compaction parallel(test_dir_ + "/parallel", options, 32 * 1024, 4);
+    auto outputs = parallel.CompactToLevel(input_tables, 1);
+    EXPECT_EQ(contents(outputs), expected);
+    EXPECT_EQ(expected.size(), 4000);
+
+    // Small inputs are not worth splitting
+    Compaction small(test_dir_ + "/small", options, 64 * 1024 * 1024, 4);
+    EXPECT_EQ(small.CompactToLevel(input_tables, 1).size(), 1);
+}
+
+TEST_F(CompactionTest, SnapshotsKeepVersions) {
+    TableOptions options;
+    options.block_size = 256;
+    Compaction compaction(test_dir_, options, 1024);
+
+    // Every key has versions at sequence numbers 10, 20 and 30, split over
+    // an older and a newer table
+    auto build = [&](const std::string& name, std::vector<uint64_t> sequences) {
+        std::string path = test_dir_ + "/" + name + ".sst";
+        TableBuilder builder(path, 0, options);
+        for (int i = 0; i < 100; ++i) {
+            char key[16];
+            snprintf(key, sizeof(key), "key%04d", i);
+            for (uint64_t sequence : sequences) {
+                builder.Add(key, std::string(20, 'a') + std::to_string(sequence), sequence);
+            }
+        }
+        builder.Finish();
+        return std::make_shared<SSTable>(path, options);
+    };
+    std::vector<std::shared_ptr<SSTable>> inputs = {build("old", {20, 10}), build("new", {30})};
+
+    // A snapshot at 25 reads version 20; nothing reads version 10
+    auto outputs = compaction.CompactToLevel(inputs, 1, {25});
+    ASSERT_GT(outputs.size(), 2);
+    size_t entries = 0;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (i > 0) {
+            // Versions of a key never straddle two files
+            EXPECT_LT(outputs[i - 1]->GetLargestKey(), outputs[i]->GetSmallestKey());
+        }
+        auto it = outputs[i]->NewIterator();
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            EXPECT_TRUE(it->Sequence() == 30 || it->Sequence() == 20);
+            ++entries;
+        }
+        EXPECT_EQ(outputs[i]->GetLargestSequence(), 30);
+    }
+    EXPECT_EQ(entries, 200);
+
+    std::string value;
+    EXPECT_TRUE(outputs.front()->Get("key0000", &value, 25));
+    EXPECT_EQ(value, std::string(20, 'a') + "20");
+    EXPECT_FALSE(outputs.front()->Get("key0000", &value, 15));
+
+    // Without snapshots only the newest version survives
+    auto latest = compaction.Compact(inputs, 1);
+    auto it = latest->NewIterator();
+    entries = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        EXPECT_EQ(it->Sequence(), 30);
+        ++entries;
+    }
+    EXPECT_EQ(entries, 100);
+}
+
+TEST_F(CompactionTest, RangeTombstones) {
+    TableOptions options;
+    Compaction compaction(test_dir_, options);
+
+    // key0000-key0099 at sequence 10, and a newer table deleting
+    // [key0020, key0050) at 20 plus key0060 at 30
+    std::string old_path = test_dir_ + "/old.sst";
+    {
+        TableBuilder builder(old_path, 0, options);
+        for (int i = 0; i < 100; ++i) {
+            char key[16];
+            snprintf(key, sizeof(key), "key%04d", i);
+            builder.Add(key, "value", 10);
+        }
+        builder.Finish();
+    }
+    std::string new_path = test_dir_ + "/new.sst";
+    {
+        TableBuilder builder(new_path, 0, options);
+        builder.Add("key0060", "", 30, ValueType::kDeletion);
+        builder.AddRangeTombstone({"key0020", "key0050", 20});
+        builder.Finish();
+    }
+    std::vector<std::shared_ptr<SSTable>> inputs = {
+        std::make_shared<SSTable>(old_path, options), std::make_shared<SSTable>(new_path, options)};
+    ASSERT_EQ(inputs[1]->GetRangeTombstones().size(), 1);
+    EXPECT_EQ(inputs[1]->GetSmallestSequence(), 20);
+    EXPECT_EQ(inputs[1]->GetLargestSequence(), 30);
+
+    auto count = [](const SSTable& table, size_t* deletions) {
+        size_t entries = 0;
+        *deletions = 0;
+        auto it = table.NewIterator();
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            ++entries;
+            *deletions += it->Type() == ValueType::kDeletion;
+        }
+        return entries;
+    };
+
+    // Covered entries go, but the deletions are kept for tables below
+    size_t deletions;
+    auto kept = compaction.Compact(inputs, 1);
+    EXPECT_EQ(count(*kept, &deletions), 70);
+    EXPECT_EQ(deletions, 1);
+    ASSERT_EQ(kept->GetRangeTombstones().size(), 1);
+    EXPECT_EQ(kept->GetRangeTombstones()[0].sequence, 20);
+
+    // A snapshot taken before the range deletion still reads what it hides
+    auto snapshot = compaction.Compact(inputs, 1, {15});
+    EXPECT_EQ(count(*snapshot, &deletions), 101);
+    std::string value;
+    EXPECT_TRUE(snapshot->Get("key0030", &value, 15));
+
+    // With nothing older below, deletions go too
+    auto bottommost = compaction.Compact(inputs, 1, {}, true);
+    EXPECT_EQ(count(*bottommost, &deletions), 69);
+    EXPECT_EQ(deletions, 0);
+    EXPECT_TRUE(bottommost->GetRangeTombstones().empty());
+    EXPECT_FALSE(bottommost->Get("key0060", &value));
+    EXPECT_TRUE(bottommost->Get("key0050", &value));
+}
+
 TEST_F(CompactionTest, ShouldCompact) {
     // Create a large SSTable
     std::vector<std::pair<std::string, std::string>> entries;
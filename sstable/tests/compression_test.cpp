@@ -0,0 +1,122 @@
+#include "compression.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace sstable;
+
+class CompressionTest : public ::testing::Test {
+protected:
+    // JSON documents sharing their field names, like typical values
+    static std::string JsonBlock(size_t size) {
+        std::string block;
+        for (int i = 0; block.size() < size; ++i) {
+            block += "{\"id\":" + std::to_string(i) + ",\"name\":\"user" + std::to_string(i) +
+                     "\",\"email\":\"user" + std::to_string(i) +
+                     "@example.com\",\"active\":true,\"tags\":[\"a\",\"b\"]}";
+        }
+        return block;
+    }
+
+    static std::string RandomBlock(size_t size) {
+        std::mt19937 rng(301);
+        std::string block(size, '\0');
+        for (char& c : block) {
+            c = static_cast<char>(rng());
+        }
+        return block;
+    }
+
+    static void ExpectRoundTrip(const Compressor& compressor, const std::string& input) {
+        std::string compressed, output;
+        ASSERT_TRUE(compressor.Compress(input, &compressed));
+        ASSERT_TRUE(compressor.Uncompress(compressed, &output));
+        EXPECT_EQ(output, input);
+    }
+
+    // Every compressor compiled into the library
+    static std::vector<std::shared_ptr<const Compressor>> Compressors() {
+        std::vector<std::shared_ptr<const Compressor>> compressors = {NewLZCompressor()};
+        if (auto lz4 = NewLZ4Compressor()) {
+            compressors.push_back(lz4);
+        }
+        if (auto zstd = NewZstdCompressor()) {
+            compressors.push_back(zstd);
+        }
+        return compressors;
+    }
+};
+
+TEST_F(CompressionTest, RoundTrip) {
+    for (const auto& compressor : Compressors()) {
+        SCOPED_TRACE(compressor->Name());
+        ExpectRoundTrip(*compressor, "");
+        ExpectRoundTrip(*compressor, "a");
+        ExpectRoundTrip(*compressor, "abcabcabcabcabcabc");
+        ExpectRoundTrip(*compressor, std::string(100000, 'x'));
+        ExpectRoundTrip(*compressor, JsonBlock(4096));
+        ExpectRoundTrip(*compressor, JsonBlock(200000));
+        ExpectRoundTrip(*compressor, RandomBlock(4096));
+    }
+}
+
+TEST_F(CompressionTest, JsonCompresses) {
+    const std::string input = JsonBlock(4096);
+    for (const auto& compressor : Compressors()) {
+        SCOPED_TRACE(compressor->Name());
+        std::string compressed;
+        ASSERT_TRUE(compressor->Compress(input, &compressed));
+        EXPECT_LT(compressed.size(), input.size() / 2);
+    }
+}
+
+TEST_F(CompressionTest, RandomDataDoesNotGrowMuch) {
+    const std::string input = RandomBlock(4096);
+    std::string compressed;
+    ASSERT_TRUE(NewLZCompressor()->Compress(input, &compressed));
+    EXPECT_LT(compressed.size(), input.size() + input.size() / 64 + 16);
+}
+
+TEST_F(CompressionTest, CorruptInputIsRejected) {
+    auto compressor = NewLZCompressor();
+    std::string compressed, output;
+    ASSERT_TRUE(compressor->Compress(JsonBlock(4096), &compressed));
+
+    // Every truncation fails cleanly instead of reading past the input
+    for (size_t size = 0; size < compressed.size(); ++size) {
+        EXPECT_FALSE(compressor->Uncompress(std::string_view(compressed.data(), size), &output))
+            << "truncated to " << size;
+    }
+
+    // An implausible raw length is refused before anything is allocated
+    std::string huge = "\xff\xff\xff\xff\xff\xff\xff\x7f";
+    huge += compressed.substr(2);
+    EXPECT_FALSE(compressor->Uncompress(huge, &output));
+
+    // One literal repeated by an overlapping match, then the same match
+    // reaching before the start of the output
+    ASSERT_TRUE(compressor->Uncompress(std::string("\x05\x10" "a\x01\x00", 5), &output));
+    EXPECT_EQ(output, "aaaaa");
+    EXPECT_FALSE(compressor->Uncompress(std::string("\x05\x10" "a\x05\x00", 5), &output));
+
+    // Matches ending right at the bytes they produce, and one byte into them
+    ASSERT_TRUE(compressor->Uncompress(std::string("\x08\x40" "abcd\x04\x00", 8), &output));
+    EXPECT_EQ(output, "abcdabcd");
+    ASSERT_TRUE(compressor->Uncompress(std::string("\x09\x41" "abcd\x03\x00", 8), &output));
+    EXPECT_EQ(output, "abcdbcdbc");
+}
+
+TEST_F(CompressionTest, FindBuiltinCompressor) {
+    for (const auto& compressor : Compressors()) {
+        const Compressor* found = FindBuiltinCompressor(compressor->Name());
+        ASSERT_NE(found, nullptr);
+        EXPECT_STREQ(found->Name(), compressor->Name());
+
+        std::string compressed, output;
+        ASSERT_TRUE(compressor->Compress(JsonBlock(1000), &compressed));
+        ASSERT_TRUE(found->Uncompress(compressed, &output));
+        EXPECT_EQ(output, JsonBlock(1000));
+    }
+    EXPECT_EQ(FindBuiltinCompressor("unknown"), nullptr);
+}
@@ -0,0 +1,103 @@
+#include "filter_policy.h"
+#include "bloom_filter.h"
+#include "xor_filter.h"
+#include "coding.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace sstable;
+
+class FilterPolicyTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (int i = 0; i < kNumKeys; ++i) {
+            keys_.push_back("key" + std::to_string(i));
+        }
+        key_hashes_ = Hashes(keys_);
+    }
+
+    static std::vector<uint64_t> Hashes(const std::vector<std::string>& keys) {
+        std::vector<uint64_t> hashes;
+        for (const auto& key : keys) {
+            hashes.push_back(Hash64(key.data(), key.size()));
+        }
+        return hashes;
+    }
+
+    // Fraction of absent keys the filter lets through
+    double FalsePositiveRate(const Filter& filter) const {
+        int false_positives = 0;
+        for (int i = 0; i < kNumKeys; ++i) {
+            if (filter.MightContain("missing" + std::to_string(i))) {
+                ++false_positives;
+            }
+        }
+        return static_cast<double>(false_positives) / kNumKeys;
+    }
+
+    static constexpr int kNumKeys = 20000;
+    std::vector<std::string> keys_;
+    std::vector<uint64_t> key_hashes_;
+};
+
+TEST_F(FilterPolicyTest, XorFilterHasNoFalseNegatives) {
+    auto policy = NewXorFilterPolicy();
+    auto filter = policy->LoadFilter(policy->CreateFilter(key_hashes_));
+    ASSERT_NE(filter, nullptr);
+
+    for (const auto& key : keys_) {
+        EXPECT_TRUE(filter->MightContain(key));
+    }
+    EXPECT_LT(FalsePositiveRate(*filter), 0.01);
+}
+
+TEST_F(FilterPolicyTest, XorFilterIsSmallerThanBloomAtSameRate) {
+    auto xor_policy = NewXorFilterPolicy();
+    std::string xor_data = xor_policy->CreateFilter(key_hashes_);
+    double xor_rate = FalsePositiveRate(*xor_policy->LoadFilter(xor_data));
+
+    // A bloom filter needs about 14 bits per key to match a 1/256 rate
+    auto bloom_policy = NewBloomFilterPolicy(14);
+    std::string bloom_data = bloom_policy->CreateFilter(key_hashes_);
+    double bloom_rate = FalsePositiveRate(*bloom_policy->LoadFilter(bloom_data));
+
+    EXPECT_LT(xor_data.size() * 8.0 / kNumKeys, 10.5);
+    EXPECT_LT(xor_data.size(), bloom_data.size() * 3 / 4);
+    EXPECT_LT(xor_rate, bloom_rate * 2);
+}
+
+TEST_F(FilterPolicyTest, XorFilterEdgeCases) {
+    auto policy = NewXorFilterPolicy();
+
+    // Empty and duplicated key sets still build
+    auto empty = policy->LoadFilter(policy->CreateFilter({}));
+    ASSERT_NE(empty, nullptr);
+    auto duplicates = policy->LoadFilter(policy->CreateFilter(Hashes({"a", "a", "b"})));
+    ASSERT_NE(duplicates, nullptr);
+    EXPECT_TRUE(duplicates->MightContain("a"));
+    EXPECT_TRUE(duplicates->MightContain("b"));
+
+    EXPECT_EQ(policy->LoadFilter("short"), nullptr);
+    EXPECT_EQ(XorFilter::Deserialize(std::string(40, '\0')), nullptr);
+}
+
+TEST_F(FilterPolicyTest, BuiltinPoliciesByName) {
+    auto bloom = NewBloomFilterPolicy(10);
+    auto xor_policy = NewXorFilterPolicy();
+    EXPECT_STRNE(bloom->Name(), xor_policy->Name());
+
+    const FilterPolicy* found = FindBuiltinFilterPolicy(bloom->Name());
+    ASSERT_NE(found, nullptr);
+    auto filter = found->LoadFilter(bloom->CreateFilter(key_hashes_));
+    ASSERT_NE(filter, nullptr);
+    EXPECT_TRUE(filter->MightContain(keys_[42]));
+
+    EXPECT_NE(FindBuiltinFilterPolicy(xor_policy->Name()), nullptr);
+    EXPECT_EQ(FindBuiltinFilterPolicy("unknown"), nullptr);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,10 +1,18 @@
 #include "lsm_tree.h"
+#include "block_cache.h"
+#include "compression.h"
+#include "prefix_extractor.h"
 #include <gtest/gtest.h>
 #include <string>
 #include <filesystem>
+#include <fstream>
 #include <vector>
+#include <algorithm>
 #include <thread>
+#include <atomic>
 #include <chrono>
+#include <csignal>
+#include <sys/resource.h>
 
 using namespace sstable;
 
@@ -83,6 +91,68 @@ TEST_F(LSMTreeTest, Compaction) {
     EXPECT_EQ(value, std::string(1024, 'x'));
 }
 
+TEST_F(LSMTreeTest, BackgroundFlush) {
+    Options options;
+    options.memtable_size = 16 * 1024; // 16KB MemTable
+    options.max_immutable_memtables = 2;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/flush", options);
+
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(tree->Put("key" + std::to_string(i), std::string(100, 'a' + i % 26)));
+    }
+
+    // Every key is readable whether it is in a MemTable or already flushed
+    for (int i = 0; i < 1000; ++i) {
+        std::string value;
+        EXPECT_TRUE(tree->Get("key" + std::to_string(i), &value));
+        EXPECT_EQ(value, std::string(100, 'a' + i % 26));
+    }
+
+    // A manual flush drains the queue and retires the flushed logs
+    tree->FlushMemTable();
+    size_t num_logs = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(test_dir_ + "/flush")) {
+        if (entry.path().extension() == ".log") {
+            ++num_logs;
+        }
+    }
+    EXPECT_EQ(num_logs, 1);
+    EXPECT_FALSE(std::filesystem::is_empty(test_dir_ + "/flush/level-0"));
+
+    std::string value;
+    EXPECT_TRUE(tree->Get("key999", &value));
+    EXPECT_EQ(value, std::string(100, 'a' + 999 % 26));
+}
+
+TEST_F(LSMTreeTest, BackgroundCompaction) {
+    Options options;
+    options.memtable_size = 256 * 1024; // 256KB MemTable
+    options.max_background_compactions = 4;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/compact", options);
+
+    // 3MB of data pushes level 0 over its 2MB limit
+    const int num_keys = 3000;
+    for (int i = 0; i < num_keys; ++i) {
+        EXPECT_TRUE(tree->Put("key" + std::to_string(i), std::string(1024, 'a' + i % 26)));
+    }
+
+    // Reads keep working while compactions run
+    std::string value;
+    EXPECT_TRUE(tree->Get("key0", &value));
+    EXPECT_EQ(value, std::string(1024, 'a'));
+
+    tree->FlushMemTable();
+    tree->WaitForCompactions();
+    EXPECT_FALSE(std::filesystem::is_empty(test_dir_ + "/compact/level-1"));
+
+    for (int i = 0; i < num_keys; ++i) {
+        EXPECT_TRUE(tree->Get("key" + std::to_string(i), &value));
+        EXPECT_EQ(value, std::string(1024, 'a' + i % 26));
+    }
+}
+
 TEST_F(LSMTreeTest, ConcurrentAccess) {
     const int num_threads = 4;
     const int num_ops = 1000;
@@ -139,6 +209,881 @@ TEST_F(LSMTreeTest, Recovery) {
     EXPECT_EQ(value, "value2");
 }
 
+TEST_F(LSMTreeTest, PrefixScan) {
+    Options options;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    options.table_options.prefix_extractor = NewDelimitedPrefixExtractor('/');
+    options.table_options.block_cache = std::make_shared<BlockCache>(1024 * 1024);
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/prefix", options);
+
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(tree->Put("tenant1/entity" + std::to_string(i), "value1"));
+        EXPECT_TRUE(tree->Put("tenant3/entity" + std::to_string(i), "value3"));
+    }
+    tree->FlushMemTable();
+
+    // The table spans tenant2's key range but its filter rules the prefix out
+    auto missing = tree->GetRange("tenant2/", "tenant2/\xff");
+    EXPECT_TRUE(missing.empty());
+    EXPECT_EQ(options.table_options.block_cache->GetMisses(), 0);
+
+    auto found = tree->GetRange("tenant1/", "tenant1/\xff");
+    ASSERT_EQ(found.size(), 10);
+    for (const auto& [key, value] : found) {
+        EXPECT_EQ(key.compare(0, 8, "tenant1/"), 0);
+        EXPECT_EQ(value, "value1");
+    }
+
+    // Unflushed writes are still found
+    EXPECT_TRUE(tree->Put("tenant2/entity0", "value2"));
+    found = tree->GetRange("tenant2/", "tenant2/\xff");
+    ASSERT_EQ(found.size(), 1);
+    EXPECT_EQ(found[0].second, "value2");
+}
+
+TEST_F(LSMTreeTest, LeveledCompaction) {
+    Options options;
+    options.memtable_size = 256 * 1024; // 256KB MemTable
+    options.target_file_size = 64 * 1024;
+    options.max_subcompactions = 4;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/leveled", options);
+
+    auto key = [](int i) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "key%05d", i);
+        return std::string(buf);
+    };
+    auto write = [&](int begin, int end, char fill) {
+        for (int i = begin; i < end; ++i) {
+            EXPECT_TRUE(tree->Put(key(i), std::string(1024, fill)));
+        }
+        tree->FlushMemTable();
+        tree->WaitForCompactions();
+    };
+    auto expect_disjoint = [&]() {
+        auto tables = tree->GetLevelMetadata(1);
+        for (size_t i = 0; i < tables.size(); ++i) {
+            EXPECT_LE(tables[i].smallest_key, tables[i].largest_key);
+            if (i > 0) {
+                EXPECT_LT(tables[i - 1].largest_key, tables[i].smallest_key);
+            }
+        }
+        return tables;
+    };
+
+    auto contains = [](const std::vector<TableMetadata>& tables, const std::string& path) {
+        return std::any_of(tables.begin(), tables.end(),
+            [&path](const TableMetadata& table) { return table.path == path; });
+    };
+
+    // 3MB pushes level 0 over its limit and splits into many level-1 files
+    write(0, 3000, 'a');
+    auto first = expect_disjoint();
+    EXPECT_GT(first.size(), 10);
+
+    // Keys past the end of level 1 overlap none of its files, which are kept
+    write(10000, 12500, 'b');
+    auto second = expect_disjoint();
+    EXPECT_GT(second.size(), first.size());
+    for (const auto& table : first) {
+        EXPECT_TRUE(contains(second, table.path));
+    }
+
+    // Overwrites are merged with only the files covering their range
+    write(10000, 12500, 'c');
+    auto third = expect_disjoint();
+    size_t rewritten = 0;
+    for (const auto& table : second) {
+        if (table.largest_key < key(10000)) {
+            EXPECT_TRUE(contains(third, table.path));
+        } else if (!contains(third, table.path)) {
+            ++rewritten;
+        }
+    }
+    EXPECT_GT(rewritten, 0);
+
+    std::string value;
+    for (int i = 0; i < 3000; ++i) {
+        ASSERT_TRUE(tree->Get(key(i), &value));
+        EXPECT_EQ(value, std::string(1024, 'a'));
+    }
+    for (int i = 10000; i < 12500; ++i) {
+        ASSERT_TRUE(tree->Get(key(i), &value));
+        EXPECT_EQ(value, std::string(1024, 'c'));
+    }
+}
+
+
+TEST_F(LSMTreeTest, GetProbesOneTablePerLevel) {
+    // Without filters, probing a table whose range starts after the key
+    // would read its first block, so block cache misses count table probes
+    Options options;
+    options.memtable_size = 256 * 1024; // 256KB MemTable
+    options.target_file_size = 64 * 1024;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    options.table_options.bloom_bits_per_key = 0;
+    options.table_options.block_cache = std::make_shared<BlockCache>(64 * 1024 * 1024);
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/probes", options);
+
+    for (int i = 0; i < 3000; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%05d", i);
+        EXPECT_TRUE(tree->Put(key, std::string(1024, 'a' + i % 26)));
+    }
+    tree->FlushMemTable();
+    tree->WaitForCompactions();
+    ASSERT_GT(tree->GetLevelMetadata(1).size(), 10);
+
+    const BlockCache& cache = *options.table_options.block_cache;
+    std::string value;
+    for (int i : {0, 1500, 2999}) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%05d", i);
+        size_t misses = cache.GetMisses();
+        ASSERT_TRUE(tree->Get(key, &value));
+        EXPECT_EQ(value, std::string(1024, 'a' + i % 26));
+        EXPECT_EQ(cache.GetMisses() - misses, 1);
+    }
+
+    // Keys outside every table's range touch no blocks at all
+    size_t misses = cache.GetMisses();
+    EXPECT_FALSE(tree->Get("a", &value));
+    EXPECT_FALSE(tree->Get("key99999", &value));
+    EXPECT_EQ(cache.GetMisses(), misses);
+}
+
+
+TEST_F(LSMTreeTest, UniversalCompaction) {
+    Options options;
+    options.memtable_size = 128 * 1024; // 128KB MemTable
+    options.compaction_style = CompactionStyle::kUniversal;
+    options.universal_compaction.sorted_run_trigger = 4;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/universal", options);
+
+    auto key = [](int i) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "key%05d", i);
+        return std::string(buf);
+    };
+
+    // Overwrite half the keys so newer runs must keep shadowing older ones
+    for (int i = 0; i < 2000; ++i) {
+        EXPECT_TRUE(tree->Put(key(i), std::string(512, 'a')));
+    }
+    for (int i = 0; i < 2000; i += 2) {
+        EXPECT_TRUE(tree->Put(key(i), std::string(512, 'b')));
+    }
+    tree->FlushMemTable();
+    tree->WaitForCompactions();
+
+    // Every run stays in level 0, and compaction keeps their number down
+    EXPECT_TRUE(tree->GetLevelMetadata(1).empty());
+    auto runs = tree->GetLevelMetadata(0);
+    EXPECT_GE(runs.size(), 1);
+    EXPECT_LT(runs.size(), 4);
+
+    std::string value;
+    for (int i = 0; i < 2000; ++i) {
+        ASSERT_TRUE(tree->Get(key(i), &value));
+        EXPECT_EQ(value, std::string(512, i % 2 == 0 ? 'b' : 'a'));
+    }
+}
+
+TEST_F(LSMTreeTest, Iterator) {
+    auto key = [](int i) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "key%03d", i);
+        return std::string(buf);
+    };
+
+    // Spread versions of each key over two tables and the MemTable
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(lsm_tree_->Put(key(i), "v1"));
+    }
+    lsm_tree_->FlushMemTable();
+    for (int i = 0; i < 100; i += 2) {
+        EXPECT_TRUE(lsm_tree_->Put(key(i), "v2"));
+    }
+    lsm_tree_->FlushMemTable();
+    for (int i = 0; i < 100; i += 10) {
+        EXPECT_TRUE(lsm_tree_->Delete(key(i)));
+    }
+    EXPECT_TRUE(lsm_tree_->Put(key(5), "v3"));
+
+    auto expected_value = [](int i) {
+        return i == 5 ? "v3" : (i % 2 == 0 ? "v2" : "v1");
+    };
+
+    auto it = lsm_tree_->NewIterator();
+    int count = 0;
+    int previous = -1;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        int i = std::stoi(std::string(it->Key().substr(3)));
+        EXPECT_GT(i, previous);
+        EXPECT_NE(i % 10, 0) << "Deleted key " << it->Key() << " was returned";
+        EXPECT_EQ(it->Value(), expected_value(i));
+        previous = i;
+        ++count;
+    }
+    EXPECT_EQ(count, 90);
+
+    // Seeking to a deleted key lands on the next live one
+    it->Seek(key(50));
+    ASSERT_TRUE(it->Valid());
+    EXPECT_EQ(it->Key(), key(51));
+    it->Seek("key1000");
+    EXPECT_FALSE(it->Valid());
+
+    auto entries = lsm_tree_->GetRange(key(0), key(12));
+    ASSERT_EQ(entries.size(), 11);
+    EXPECT_EQ(entries[0].first, key(1));
+    EXPECT_EQ(entries[4].first, key(5));
+    EXPECT_EQ(entries[4].second, "v3");
+    EXPECT_EQ(entries.back().first, key(12));
+}
+
+TEST_F(LSMTreeTest, IteratorReadsOnlyWhatItReturns) {
+    Options options;
+    options.memtable_size = 256 * 1024; // 256KB MemTable
+    options.target_file_size = 64 * 1024;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    options.table_options.block_cache = std::make_shared<BlockCache>(64 * 1024 * 1024);
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/pagination", options);
+
+    for (int i = 0; i < 3000; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%05d", i);
+        EXPECT_TRUE(tree->Put(key, std::string(1024, 'a' + i % 26)));
+    }
+    tree->FlushMemTable();
+    tree->WaitForCompactions();
+
+    // The first page touches a few dozen of the ~750 data blocks
+    const BlockCache& cache = *options.table_options.block_cache;
+    size_t misses = cache.GetMisses();
+    auto it = tree->NewIterator();
+    it->SeekToFirst();
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(it->Valid());
+        char key[16];
+        snprintf(key, sizeof(key), "key%05d", i);
+        EXPECT_EQ(it->Key(), key);
+        it->Next();
+    }
+    EXPECT_LT(cache.GetMisses() - misses, 60);
+}
+
+TEST_F(LSMTreeTest, IteratorOutlivesCompaction) {
+    Options options;
+    options.memtable_size = 128 * 1024; // 128KB MemTable
+    options.target_file_size = 64 * 1024;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/pinned", options);
+
+    auto key = [](int i) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "key%05d", i);
+        return std::string(buf);
+    };
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(tree->Put(key(i), std::string(512, 'a')));
+    }
+    tree->FlushMemTable();
+    tree->WaitForCompactions();
+
+    auto it = tree->NewIterator();
+    it->SeekToFirst();
+
+    // Replace every table the iterator reads from
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(tree->Put(key(i), std::string(512, 'b')));
+    }
+    tree->FlushMemTable();
+    tree->WaitForCompactions();
+
+    // Writes to a MemTable the iterator holds may show through
+    int count = 0;
+    for (; it->Valid(); it->Next()) {
+        EXPECT_EQ(it->Key(), key(count));
+        EXPECT_TRUE(it->Value() == std::string(512, 'a') ||
+                    it->Value() == std::string(512, 'b'));
+        ++count;
+    }
+    EXPECT_EQ(count, 1000);
+}
+
+TEST_F(LSMTreeTest, Snapshots) {
+    Options options;
+    options.memtable_size = 128 * 1024; // 128KB MemTable
+    options.target_file_size = 64 * 1024;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/snapshots", options);
+
+    auto key = [](int i) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "key%05d", i);
+        return std::string(buf);
+    };
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(tree->Put(key(i), "old" + std::to_string(i)));
+    }
+    const Snapshot* snapshot = tree->GetSnapshot();
+    auto snapshot_iterator = tree->NewIterator(snapshot);
+
+    // Overwrite and delete under the snapshot, and push every version
+    // through flushes and compactions
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 1000; ++i) {
+            EXPECT_TRUE(tree->Put(key(i), std::string(256, 'a' + round)));
+        }
+    }
+    EXPECT_TRUE(tree->Delete(key(7)));
+    tree->FlushMemTable();
+    tree->WaitForCompactions();
+
+    std::string value;
+    ASSERT_TRUE(tree->Get(key(7), &value, snapshot));
+    EXPECT_EQ(value, "old7");
+    for (int i = 0; i < 1000; i += 97) {
+        ASSERT_TRUE(tree->Get(key(i), &value, snapshot));
+        EXPECT_EQ(value, "old" + std::to_string(i));
+        if (i != 7) {
+            ASSERT_TRUE(tree->Get(key(i), &value));
+            EXPECT_EQ(value, std::string(256, 'c'));
+        }
+    }
+
+    // Iterators see the state as of their snapshot, whenever they are created
+    auto later_iterator = tree->NewIterator(snapshot);
+    for (auto* it : {snapshot_iterator.get(), later_iterator.get()}) {
+        int count = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            EXPECT_EQ(it->Value(), "old" + std::to_string(count));
+            ++count;
+        }
+        EXPECT_EQ(count, 1000);
+    }
+    EXPECT_EQ(tree->GetRange(key(5), key(8), snapshot).size(), 4);
+    EXPECT_EQ(tree->GetRange(key(5), key(8)).size(), 3);
+
+    // Once released, compactions drop the versions only the snapshot read
+    snapshot_iterator.reset();
+    later_iterator.reset();
+    tree->ReleaseSnapshot(snapshot);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(tree->Put(key(i), std::string(256, 'd')));
+    }
+    tree->FlushMemTable();
+    tree->WaitForCompactions();
+    ASSERT_TRUE(tree->Get(key(0), &value));
+    EXPECT_EQ(value, std::string(256, 'd'));
+}
+
+TEST_F(LSMTreeTest, SequenceNumbersSurviveReopen) {
+    Options options;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    const std::string path = test_dir_ + "/reopen";
+    {
+        LSMTree tree(path, options);
+        EXPECT_TRUE(tree.Put("key", "flushed"));
+        tree.FlushMemTable();
+        EXPECT_TRUE(tree.Put("key", "logged"));
+        const Snapshot* snapshot = tree.GetSnapshot();
+        EXPECT_EQ(snapshot->GetSequenceNumber(), 2);
+        tree.ReleaseSnapshot(snapshot);
+    }
+
+    // New writes continue after the recovered sequence numbers, so they
+    // shadow both the table and the replayed log
+    LSMTree tree(path, options);
+    std::string value;
+    ASSERT_TRUE(tree.Get("key", &value));
+    EXPECT_EQ(value, "logged");
+    EXPECT_TRUE(tree.Put("key", "latest"));
+    tree.FlushMemTable();
+    tree.WaitForCompactions();
+    ASSERT_TRUE(tree.Get("key", &value));
+    EXPECT_EQ(value, "latest");
+
+    const Snapshot* snapshot = tree.GetSnapshot();
+    EXPECT_EQ(snapshot->GetSequenceNumber(), 3);
+    tree.ReleaseSnapshot(snapshot);
+}
+
+
+TEST_F(LSMTreeTest, EmptyValuesAreNotDeletions) {
+    EXPECT_TRUE(lsm_tree_->Put("empty", ""));
+    EXPECT_TRUE(lsm_tree_->Put("deleted", "value"));
+    EXPECT_TRUE(lsm_tree_->Delete("deleted"));
+
+    auto check = [&]() {
+        std::string value = "unchanged";
+        EXPECT_TRUE(lsm_tree_->Get("empty", &value));
+        EXPECT_EQ(value, "");
+        EXPECT_FALSE(lsm_tree_->Get("deleted", &value));
+        auto entries = lsm_tree_->GetRange("a", "z");
+        ASSERT_EQ(entries.size(), 1);
+        EXPECT_EQ(entries[0].first, "empty");
+    };
+    check();
+    lsm_tree_->FlushMemTable();
+    check();
+}
+
+TEST_F(LSMTreeTest, DeleteRange) {
+    Options options;
+    options.memtable_size = 64 * 1024; // 64KB MemTable
+    options.wal_sync_mode = WalSyncMode::kNone;
+    // Every flush adds a run and runs are merged after a few flushes
+    options.compaction_style = CompactionStyle::kUniversal;
+    auto tree = std::make_unique<LSMTree>(test_dir_ + "/delete_range", options);
+
+    auto key = [](const std::string& tenant, int i) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%05d", i);
+        return tenant + "/" + buf;
+    };
+    for (int i = 0; i < 500; ++i) {
+        EXPECT_TRUE(tree->Put(key("a", i), std::string(100, 'a')));
+        EXPECT_TRUE(tree->Put(key("b", i), std::string(100, 'b')));
+    }
+    tree->FlushMemTable();
+
+    // Drop tenant a with one write, then recreate one of its keys
+    const Snapshot* snapshot = tree->GetSnapshot();
+    EXPECT_TRUE(tree->DeleteRange("a/", "a0"));
+    EXPECT_TRUE(tree->Put(key("a", 3), "recreated"));
+
+    auto check = [&]() {
+        std::string value;
+        EXPECT_FALSE(tree->Get(key("a", 0), &value));
+        EXPECT_FALSE(tree->Get(key("a", 499), &value));
+        ASSERT_TRUE(tree->Get(key("a", 3), &value));
+        EXPECT_EQ(value, "recreated");
+        ASSERT_TRUE(tree->Get(key("b", 0), &value));
+        EXPECT_EQ(value, std::string(100, 'b'));
+        ASSERT_TRUE(tree->Get(key("a", 0), &value, snapshot));
+        EXPECT_EQ(value, std::string(100, 'a'));
+        std::vector<std::string> values;
+        EXPECT_EQ(tree->MultiGet({key("a", 0), key("a", 3), key("b", 0)}, &values),
+                  std::vector<bool>({false, true, true}));
+
+        EXPECT_EQ(tree->GetRange("a/", "a0").size(), 1);
+        EXPECT_EQ(tree->GetRange("a/", "b0").size(), 501);
+        EXPECT_EQ(tree->GetRange("a/", "a0", snapshot).size(), 500);
+        auto it = tree->NewIterator();
+        it->SeekToFirst();
+        ASSERT_TRUE(it->Valid());
+        EXPECT_EQ(it->Key(), key("a", 3));
+    };
+    check();
+
+    // Push the tombstone through flushes and compactions
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 500; ++i) {
+            EXPECT_TRUE(tree->Put(key("b", i), std::string(100, 'b')));
+        }
+        tree->FlushMemTable();
+        tree->WaitForCompactions();
+        check();
+    }
+    tree->ReleaseSnapshot(snapshot);
+
+    // The range deletion and the write after it are recovered from the log
+    EXPECT_TRUE(tree->Put(key("c", 1), "logged"));
+    EXPECT_TRUE(tree->DeleteRange(key("c", 0), key("c", 5)));
+    EXPECT_TRUE(tree->Put(key("c", 2), "logged"));
+    tree.reset();
+    tree = std::make_unique<LSMTree>(test_dir_ + "/delete_range", options);
+    std::string value;
+    EXPECT_FALSE(tree->Get(key("c", 1), &value));
+    EXPECT_TRUE(tree->Get(key("c", 2), &value));
+    EXPECT_FALSE(tree->Get(key("a", 0), &value));
+    EXPECT_EQ(tree->GetRange("a/", "a0").size(), 1);
+
+    // An empty range deletes nothing
+    EXPECT_TRUE(tree->DeleteRange(key("c", 2), key("c", 2)));
+    EXPECT_TRUE(tree->Get(key("c", 2), &value));
+}
+
+TEST_F(LSMTreeTest, WriteBatch) {
+    EXPECT_TRUE(lsm_tree_->Put("stale", "value"));
+
+    WriteBatch batch;
+    for (int i = 0; i < 100; ++i) {
+        batch.Put("key" + std::to_string(i), "value" + std::to_string(i));
+    }
+    batch.Delete("stale");
+    batch.DeleteRange("key5", "key6");
+    EXPECT_TRUE(lsm_tree_->Write(batch));
+    EXPECT_TRUE(lsm_tree_->Write(WriteBatch()));
+
+    std::string value;
+    EXPECT_FALSE(lsm_tree_->Get("stale", &value));
+    ASSERT_TRUE(lsm_tree_->Get("key42", &value));
+    EXPECT_EQ(value, "value42");
+    EXPECT_FALSE(lsm_tree_->Get("key5", &value));
+    EXPECT_FALSE(lsm_tree_->Get("key57", &value));
+    EXPECT_EQ(lsm_tree_->GetRange("key", "key9~").size(), 89);
+
+    // The batch took one sequence number per operation
+    const Snapshot* snapshot = lsm_tree_->GetSnapshot();
+    EXPECT_EQ(snapshot->GetSequenceNumber(), 103);
+    lsm_tree_->ReleaseSnapshot(snapshot);
+
+    // The batch is recovered from the log as a whole
+    lsm_tree_.reset();
+    lsm_tree_ = std::make_unique<LSMTree>(test_dir_, 64 * 1024 * 1024);
+    EXPECT_FALSE(lsm_tree_->Get("stale", &value));
+    ASSERT_TRUE(lsm_tree_->Get("key99", &value));
+    EXPECT_EQ(value, "value99");
+    EXPECT_FALSE(lsm_tree_->Get("key50", &value));
+}
+
+TEST_F(LSMTreeTest, WriteBatchIsAtomic) {
+    // Each batch rewrites both keys; a reader must never see them differ
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        for (int i = 0; i < 2000; ++i) {
+            WriteBatch batch;
+            batch.Put("left", std::to_string(i));
+            batch.Put("right", std::to_string(i));
+            EXPECT_TRUE(lsm_tree_->Write(batch));
+        }
+        done = true;
+    });
+
+    while (!done) {
+        const Snapshot* snapshot = lsm_tree_->GetSnapshot();
+        std::string left, right;
+        bool has_left = lsm_tree_->Get("left", &left, snapshot);
+        bool has_right = lsm_tree_->Get("right", &right, snapshot);
+        EXPECT_EQ(has_left, has_right);
+        EXPECT_EQ(left, right);
+        lsm_tree_->ReleaseSnapshot(snapshot);
+    }
+    writer.join();
+}
+
+TEST_F(LSMTreeTest, MultiGet) {
+    for (size_t threads : {1, 4}) {
+        Options options;
+        options.memtable_size = 256 * 1024;
+        options.target_file_size = 64 * 1024;
+        options.max_multiget_threads = threads;
+        options.wal_sync_mode = WalSyncMode::kNone;
+        const std::string path = test_dir_ + "/multi_get" + std::to_string(threads);
+        LSMTree tree(path, options);
+
+        // Older rounds end up in sorted levels, the last ones in level 0 and
+        // the MemTable
+        auto key = [](int i) { return "key" + std::to_string(10000 + i); };
+        for (int round = 0; round < 4; ++round) {
+            for (int i = round; i < 2000; i += 4) {
+                EXPECT_TRUE(tree.Put(key(i), std::to_string(round) + std::string(1024, 'v')));
+            }
+            tree.FlushMemTable();
+            tree.WaitForCompactions();
+        }
+        const Snapshot* snapshot = tree.GetSnapshot();
+        for (int i = 0; i < 2000; i += 10) {
+            EXPECT_TRUE(tree.Put(key(i), "updated"));
+        }
+        EXPECT_TRUE(tree.Delete(key(3)));
+        EXPECT_TRUE(tree.DeleteRange(key(100), key(120)));
+        ASSERT_FALSE(tree.GetLevelMetadata(1).empty());
+
+        std::vector<std::string> keys;
+        for (int i = 1999; i >= 0; i -= 3) {
+            keys.push_back(key(i));
+        }
+        keys.push_back(key(3));
+        keys.push_back(key(3)); // Duplicate
+        keys.push_back("missing");
+
+        for (const Snapshot* read_at : {static_cast<const Snapshot*>(nullptr), snapshot}) {
+            std::vector<std::string> values;
+            std::vector<bool> found = tree.MultiGet(keys, &values, read_at);
+            ASSERT_EQ(found.size(), keys.size());
+            ASSERT_EQ(values.size(), keys.size());
+            for (size_t i = 0; i < keys.size(); ++i) {
+                std::string value;
+                ASSERT_EQ(found[i], tree.Get(keys[i], &value, read_at)) << keys[i];
+                EXPECT_EQ(values[i], found[i] ? value : "") << keys[i];
+            }
+        }
+
+        std::vector<std::string> values;
+        EXPECT_TRUE(tree.MultiGet({}, &values).empty());
+        EXPECT_TRUE(values.empty());
+        tree.ReleaseSnapshot(snapshot);
+    }
+}
+
+TEST_F(LSMTreeTest, UnreadableTableIsNotSkipped) {
+    Options options;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    const std::string path = test_dir_ + "/unreadable";
+    std::string newest_path;
+    {
+        LSMTree tree(path, options);
+        EXPECT_TRUE(tree.Put("key", "old"));
+        tree.FlushMemTable();
+        EXPECT_TRUE(tree.Put("key", "new"));
+        tree.FlushMemTable();
+        tree.WaitForCompactions();
+        auto tables = tree.GetLevelMetadata(0);
+        ASSERT_EQ(tables.size(), 2);
+        newest_path = tables.back().path;
+    }
+
+    // Give the single data block of the newest table an unknown block type.
+    // It ends right before the filter block, which the footer locates
+    {
+        std::fstream file(newest_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(-56, std::ios::end);
+        uint64_t filter_offset;
+        file.read(reinterpret_cast<char*>(&filter_offset), sizeof(filter_offset));
+        file.seekp(filter_offset - 1);
+        file.put(7);
+    }
+
+    // The older value must not show through
+    LSMTree tree(path, options);
+    std::string value;
+    EXPECT_THROW(tree.Get("key", &value), std::runtime_error);
+    std::vector<std::string> values;
+    EXPECT_THROW(tree.MultiGet({"key"}, &values), std::runtime_error);
+}
+
+TEST_F(LSMTreeTest, ManifestRestoresLevels) {
+    Options options;
+    options.memtable_size = 256 * 1024;
+    options.target_file_size = 64 * 1024;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    const std::string path = test_dir_ + "/manifest";
+    auto key = [](int i) { return "key" + std::to_string(10000 + i); };
+
+    auto tree = std::make_unique<LSMTree>(path, options);
+    for (int i = 0; i < 3000; ++i) {
+        EXPECT_TRUE(tree->Put(key(i), std::string(1024, 'a' + i % 26)));
+    }
+    tree->FlushMemTable();
+    tree->WaitForCompactions();
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(tree->Put(key(i), "level0"));
+    }
+    tree->FlushMemTable();
+    EXPECT_TRUE(tree->Put(key(0), "logged"));
+
+    auto describe = [&]() {
+        std::vector<std::vector<TableMetadata>> levels;
+        for (int level = 0; level < 4; ++level) {
+            levels.push_back(tree->GetLevelMetadata(level));
+        }
+        return levels;
+    };
+    auto same_layout = [](const std::vector<std::vector<TableMetadata>>& a,
+                          const std::vector<std::vector<TableMetadata>>& b) {
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t level = 0; level < a.size(); ++level) {
+            ASSERT_EQ(a[level].size(), b[level].size()) << "level " << level;
+            for (size_t i = 0; i < a[level].size(); ++i) {
+                EXPECT_EQ(a[level][i].path, b[level][i].path);
+                EXPECT_EQ(a[level][i].smallest_key, b[level][i].smallest_key);
+                EXPECT_EQ(a[level][i].largest_key, b[level][i].largest_key);
+                EXPECT_EQ(a[level][i].size, b[level][i].size);
+            }
+        }
+    };
+    auto check = [&]() {
+        std::string value;
+        ASSERT_TRUE(tree->Get(key(0), &value));
+        EXPECT_EQ(value, "logged");
+        ASSERT_TRUE(tree->Get(key(50), &value));
+        EXPECT_EQ(value, "level0");
+        ASSERT_TRUE(tree->Get(key(2999), &value));
+        EXPECT_EQ(value, std::string(1024, 'a' + 2999 % 26));
+        EXPECT_EQ(tree->GetRange(key(0), key(2999)).size(), 3000);
+    };
+    const auto layout = describe();
+    ASSERT_FALSE(layout[0].empty());
+    ASSERT_GT(layout[1].size(), 1);
+    const Snapshot* snapshot = tree->GetSnapshot();
+    const uint64_t sequence = snapshot->GetSequenceNumber();
+    tree->ReleaseSnapshot(snapshot);
+
+    // Compaction outputs in level directories are restored into their levels
+    tree.reset();
+    tree = std::make_unique<LSMTree>(path, options);
+    same_layout(layout, describe());
+    check();
+    snapshot = tree->GetSnapshot();
+    EXPECT_EQ(snapshot->GetSequenceNumber(), sequence);
+    tree->ReleaseSnapshot(snapshot);
+
+    // A table the MANIFEST does not list is left over from a crash
+    tree.reset();
+    const std::string orphan = path + "/level-1/orphan.sst";
+    std::filesystem::copy_file(layout[1][0].path, orphan);
+    tree = std::make_unique<LSMTree>(path, options);
+    EXPECT_FALSE(std::filesystem::exists(orphan));
+    same_layout(layout, describe());
+
+    // A tree written before the MANIFEST existed is scanned once
+    tree.reset();
+    std::filesystem::remove(path + "/MANIFEST");
+    tree = std::make_unique<LSMTree>(path, options);
+    EXPECT_TRUE(std::filesystem::exists(path + "/MANIFEST"));
+    same_layout(layout, describe());
+    check();
+}
+
+TEST_F(LSMTreeTest, TablesOpenLazily) {
+    Options options;
+    options.memtable_size = 64 * 1024;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    const std::string path = test_dir_ + "/lazy";
+    auto key = [](int i) { return "key" + std::to_string(10000 + i); };
+    {
+        LSMTree tree(path, options);
+        for (int i = 0; i < 1000; ++i) {
+            EXPECT_TRUE(tree.Put(key(i), std::string(256, 'a' + i % 26)));
+        }
+        tree.FlushMemTable();
+        tree.WaitForCompactions();
+    }
+
+    // Every table loads on first use, or up front with warmup threads
+    for (size_t threads : {0, 4}) {
+        options.table_warmup_threads = threads;
+        LSMTree tree(path, options);
+        std::string value;
+        ASSERT_TRUE(tree.Get(key(500), &value));
+        EXPECT_EQ(value, std::string(256, 'a' + 500 % 26));
+        EXPECT_EQ(tree.GetRange(key(0), key(999)).size(), 1000);
+    }
+
+    // Opening reads no table, so a damaged one is only found when read,
+    // unless warmup loads it
+    std::string table_path, table_key;
+    {
+        LSMTree tree(path, options);
+        for (int level = 0; level < 4 && table_path.empty(); ++level) {
+            auto tables = tree.GetLevelMetadata(level);
+            if (!tables.empty()) {
+                table_path = tables.front().path;
+                table_key = tables.front().smallest_key;
+            }
+        }
+    }
+    ASSERT_FALSE(table_path.empty());
+    std::filesystem::resize_file(table_path, 16);
+    options.table_warmup_threads = 0;
+    EXPECT_NO_THROW(LSMTree(path, options));
+    options.table_warmup_threads = 4;
+    EXPECT_THROW(LSMTree(path, options), std::runtime_error);
+
+    // Every read that needs the table fails, not just the first
+    options.table_warmup_threads = 0;
+    LSMTree tree(path, options);
+    std::string value;
+    std::vector<std::string> values;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        EXPECT_THROW(tree.Get(table_key, &value), std::runtime_error);
+        EXPECT_THROW(tree.MultiGet({table_key}, &values), std::runtime_error);
+        EXPECT_THROW(tree.GetRange(key(0), key(999)), std::runtime_error);
+    }
+}
+
+TEST_F(LSMTreeTest, CompressedTables) {
+    Options options;
+    options.memtable_size = 64 * 1024;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    auto key = [](int i) { return "key" + std::to_string(10000 + i); };
+    auto value = [](int i) {
+        return "{\"id\":" + std::to_string(i) + ",\"state\":\"active\",\"owner\":\"team-" +
+               std::to_string(i % 7) + "\",\"labels\":[\"x\",\"y\",\"z\"]}";
+    };
+    auto table_bytes = [](const LSMTree& tree) {
+        size_t total = 0;
+        for (int level = 0; level < 7; ++level) {
+            for (const auto& table : tree.GetLevelMetadata(level)) {
+                total += table.size;
+            }
+        }
+        return total;
+    };
+
+    size_t raw_bytes = 0;
+    {
+        LSMTree tree(test_dir_ + "/raw", options);
+        for (int i = 0; i < 5000; ++i) {
+            EXPECT_TRUE(tree.Put(key(i), value(i)));
+        }
+        tree.FlushMemTable();
+        tree.WaitForCompactions();
+        raw_bytes = table_bytes(tree);
+    }
+
+    // Flushes and compactions both write compressed tables
+    options.table_options.compressor = NewLZCompressor();
+    const std::string path = test_dir_ + "/compressed";
+    {
+        LSMTree tree(path, options);
+        for (int i = 0; i < 5000; ++i) {
+            EXPECT_TRUE(tree.Put(key(i), value(i)));
+        }
+        tree.FlushMemTable();
+        tree.WaitForCompactions();
+        EXPECT_LT(table_bytes(tree) * 2, raw_bytes);
+    }
+
+    // Tables name their compressor, so they read back whatever the options say
+    options.table_options.compressor = nullptr;
+    LSMTree tree(path, options);
+    for (int i = 0; i < 5000; i += 37) {
+        std::string found;
+        ASSERT_TRUE(tree.Get(key(i), &found));
+        EXPECT_EQ(found, value(i));
+    }
+    EXPECT_EQ(tree.GetRange(key(0), key(4999)).size(), 5000);
+}
+
+TEST_F(LSMTreeTest, LogWriteFailureStopsWrites) {
+    Options options;
+    options.wal_sync_mode = WalSyncMode::kNone;
+    const std::string path = test_dir_ + "/log_failure";
+    {
+        LSMTree tree(path, options);
+        EXPECT_TRUE(tree.Put("before", "value"));
+
+        // A file size limit tears the next record halfway through
+        std::signal(SIGXFSZ, SIG_IGN);
+        rlimit original;
+        getrlimit(RLIMIT_FSIZE, &original);
+        rlimit limited = original;
+        limited.rlim_cur = 64 * 1024;
+        setrlimit(RLIMIT_FSIZE, &limited);
+        EXPECT_FALSE(tree.Put("torn", std::string(128 * 1024, 'x')));
+        setrlimit(RLIMIT_FSIZE, &original);
+
+        // Anything appended after the torn record would be lost on recovery
+        EXPECT_FALSE(tree.Put("after", "value"));
+        std::string value;
+        EXPECT_FALSE(tree.Get("after", &value));
+    }
+
+    LSMTree tree(path, options);
+    std::string value;
+    EXPECT_TRUE(tree.Get("before", &value));
+    EXPECT_FALSE(tree.Get("torn", &value));
+    EXPECT_FALSE(tree.Get("after", &value));
+    EXPECT_TRUE(tree.Put("after", "value"));
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -1,5 +1,6 @@
 #include "memtable.h"
 #include <gtest/gtest.h>
+#include <random>
 #include <string>
 #include <thread>
 #include <vector>
@@ -113,10 +114,177 @@ TEST_F(MemTableTest, TombstoneHandling) {
     std::string value;
     EXPECT_FALSE(memtable_->Get("key1", &value));
     
+    // A deleted key is left out, and an empty value is kept
+    EXPECT_TRUE(memtable_->Put("key2", ""));
     auto entries = memtable_->GetAllEntries();
-    EXPECT_EQ(entries.size(), 1);
-    EXPECT_EQ(entries[0].first, "key1");
-    EXPECT_TRUE(entries[0].second.empty()); // Tombstone value
+    ASSERT_EQ(entries.size(), 1);
+    EXPECT_EQ(entries[0].first, "key2");
+    EXPECT_TRUE(entries[0].second.empty());
+}
+
+TEST_F(MemTableTest, SizeReflectsMemoryUsage) {
+    MemTable memtable(1024 * 1024);
+    size_t empty_size = memtable.GetSize();
+    EXPECT_TRUE(memtable.IsEmpty());
+
+    std::string value(100, 'v');
+    EXPECT_TRUE(memtable.Put("key1", value));
+    EXPECT_FALSE(memtable.IsEmpty());
+    size_t one_entry = memtable.GetSize() - empty_size;
+    EXPECT_GE(one_entry, 4 + value.size()); // Key, value and node overhead
+
+    // Overwrites keep the old value allocated until the MemTable is dropped
+    EXPECT_TRUE(memtable.Put("key1", value));
+    EXPECT_GE(memtable.GetSize() - empty_size, one_entry + value.size());
+}
+
+TEST_F(MemTableTest, PrefixMayMatch) {
+    MemTable memtable(1024 * 1024, NewDelimitedPrefixExtractor('/'));
+    EXPECT_FALSE(memtable.PrefixMayMatch("tenant1/"));
+
+    EXPECT_TRUE(memtable.Put("tenant1/entity1", "value1"));
+    EXPECT_TRUE(memtable.Delete("tenant2/entity1"));
+    EXPECT_TRUE(memtable.Put("no-delimiter", "value"));
+
+    EXPECT_TRUE(memtable.PrefixMayMatch("tenant1/"));
+    EXPECT_TRUE(memtable.PrefixMayMatch("tenant2/"));
+    EXPECT_FALSE(memtable.PrefixMayMatch("tenant3/"));
+
+    // Without an extractor every prefix might match
+    EXPECT_TRUE(memtable_->PrefixMayMatch("tenant3/"));
+}
+TEST_F(MemTableTest, Iterator) {
+    MemTable memtable(1024 * 1024);
+    EXPECT_TRUE(memtable.Put("key3", "value3"));
+    EXPECT_TRUE(memtable.Put("key1", "value1"));
+    EXPECT_TRUE(memtable.Put("key2", "value2"));
+    EXPECT_TRUE(memtable.Put("key1", "value1_updated"));
+    EXPECT_TRUE(memtable.Delete("key2"));
+
+    auto it = memtable.NewIterator();
+    EXPECT_FALSE(it->Valid());
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        entries.emplace_back(it->Key(), it->Value());
+    }
+    std::vector<std::pair<std::string, std::string>> expected = {
+        {"key1", "value1_updated"}, {"key2", ""}, {"key3", "value3"}};
+    EXPECT_EQ(entries, expected);
+
+    it->Seek("key11");
+    ASSERT_TRUE(it->Valid());
+    EXPECT_EQ(it->Key(), "key2");
+    it->Seek("key4");
+    EXPECT_FALSE(it->Valid());
+}
+
+
+TEST_F(MemTableTest, EmptyValuesAreNotDeletions) {
+    MemTable memtable(1024 * 1024);
+    EXPECT_TRUE(memtable.Put("empty", "", 1));
+    EXPECT_TRUE(memtable.Put("deleted", "value", 2));
+    EXPECT_TRUE(memtable.Delete("deleted", 3));
+
+    std::string value = "unchanged";
+    EXPECT_TRUE(memtable.Get("empty", &value));
+    EXPECT_EQ(value, "");
+    EXPECT_FALSE(memtable.Get("deleted", &value));
+
+    // Find tells a deletion from a missing key
+    ValueType type;
+    uint64_t sequence;
+    ASSERT_TRUE(memtable.Find("deleted", kMaxSequenceNumber, &value, &type, &sequence));
+    EXPECT_EQ(type, ValueType::kDeletion);
+    EXPECT_EQ(sequence, 3);
+    ASSERT_TRUE(memtable.Find("deleted", 2, &value, &type, &sequence));
+    EXPECT_EQ(type, ValueType::kValue);
+    EXPECT_EQ(value, "value");
+    EXPECT_FALSE(memtable.Find("missing", kMaxSequenceNumber, &value, &type, &sequence));
+}
+
+TEST_F(MemTableTest, DeleteRange) {
+    MemTable memtable(1024 * 1024);
+    EXPECT_TRUE(memtable.IsEmpty());
+    EXPECT_TRUE(memtable.DeleteRange("m", "p", 5));
+    EXPECT_TRUE(memtable.DeleteRange("a", "c", 7));
+    EXPECT_FALSE(memtable.IsEmpty());
+
+    auto tombstones = memtable.GetRangeTombstones();
+    ASSERT_EQ(tombstones.size(), 2);
+    EXPECT_EQ(tombstones[0].begin, "a");
+    EXPECT_EQ(tombstones[0].end, "c");
+    EXPECT_EQ(tombstones[0].sequence, 7);
+    EXPECT_EQ(tombstones[1].begin, "m");
+
+    EXPECT_EQ(MaxCoveringSequence(tombstones, "n", kMaxSequenceNumber), 5);
+    EXPECT_EQ(MaxCoveringSequence(tombstones, "n", 4), 0);
+    EXPECT_EQ(MaxCoveringSequence(tombstones, "p", kMaxSequenceNumber), 0);
+    EXPECT_EQ(NextCoveringSequence(tombstones, "b", 3), 7);
+    EXPECT_EQ(NextCoveringSequence(tombstones, "b", 7), kMaxSequenceNumber);
+    EXPECT_EQ(memtable.MaxCoveringSequence("n", kMaxSequenceNumber), 5);
+    EXPECT_EQ(memtable.MaxCoveringSequence("b", 6), 0);
+    EXPECT_EQ(memtable.MaxCoveringSequence("c", kMaxSequenceNumber), 0);
+
+    // Range tombstones are not point entries
+    auto it = memtable.NewIterator();
+    it->SeekToFirst();
+    EXPECT_FALSE(it->Valid());
+}
+
+TEST_F(MemTableTest, FragmentedRangeTombstones) {
+    // Overlapping, nested, adjacent, duplicate and empty ranges
+    std::mt19937 rng(42);
+    auto random_key = [&rng] { return std::string(1, static_cast<char>('a' + rng() % 20)); };
+    std::vector<RangeTombstone> tombstones;
+    for (int i = 0; i < 200; ++i) {
+        tombstones.push_back({random_key(), random_key(), rng() % 50 + 1});
+    }
+    tombstones.push_back(tombstones.front());
+
+    FragmentedRangeTombstones index(tombstones);
+    EXPECT_FALSE(index.IsEmpty());
+    for (char c = 'a' - 1; c <= 'a' + 20; ++c) {
+        const std::string key(1, c);
+        for (uint64_t sequence = 0; sequence <= 51; ++sequence) {
+            EXPECT_EQ(index.MaxCoveringSequence(key, sequence),
+                      MaxCoveringSequence(tombstones, key, sequence)) << key << " " << sequence;
+        }
+        EXPECT_EQ(index.MaxCoveringSequence(key, kMaxSequenceNumber),
+                  MaxCoveringSequence(tombstones, key, kMaxSequenceNumber));
+    }
+
+    EXPECT_TRUE(FragmentedRangeTombstones({}).IsEmpty());
+    EXPECT_TRUE(FragmentedRangeTombstones({{"b", "b", 3}}).IsEmpty());
+}
+
+TEST_F(MemTableTest, ApplyWriteBatch) {
+    MemTable memtable(1024 * 1024);
+    WriteBatch batch;
+    batch.Put("a", "1");
+    batch.Put("b", "2");
+    batch.Delete("a");
+    batch.DeleteRange("c", "e");
+    batch.DeleteRange("e", "e"); // Empty, not added
+    EXPECT_EQ(batch.Count(), 4);
+    EXPECT_TRUE(memtable.Apply(batch, 10));
+
+    // Operations are numbered from the given sequence in order
+    std::string value;
+    EXPECT_FALSE(memtable.Get("a", &value));
+    ASSERT_TRUE(memtable.Get("a", &value, 10));
+    EXPECT_EQ(value, "1");
+    ASSERT_TRUE(memtable.Get("b", &value));
+    EXPECT_EQ(value, "2");
+    auto tombstones = memtable.GetRangeTombstones();
+    ASSERT_EQ(tombstones.size(), 1);
+    EXPECT_EQ(tombstones[0].sequence, 13);
+
+    // A cleared batch applies nothing
+    batch.Clear();
+    EXPECT_EQ(batch.Count(), 0);
+    MemTable empty(1024 * 1024);
+    EXPECT_TRUE(empty.Apply(batch, 1));
+    EXPECT_TRUE(empty.IsEmpty());
 }
 
 int main(int argc, char** argv) {
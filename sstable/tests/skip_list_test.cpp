@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 using namespace sstable;
 
@@ -101,6 +103,77 @@ TEST_F(SkipListTest, LargeNumberOfEntries) {
     }
 }
 
+TEST_F(SkipListTest, ConcurrentReadersWithOneWriter) {
+    const int num_entries = 5000;
+    const int num_readers = 4;
+    std::atomic<int> inserted{0};
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < num_readers; ++r) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                // Every key published before this point must be visible
+                int limit = inserted.load(std::memory_order_acquire);
+                for (int i = 0; i < limit; i += 97) {
+                    std::string value;
+                    EXPECT_TRUE(skip_list_->Get("key" + std::to_string(i), &value));
+                    EXPECT_EQ(value.substr(0, 5), "value");
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < num_entries; ++i) {
+        skip_list_->Insert("key" + std::to_string(i), "value" + std::to_string(i));
+        if (i % 10 == 0) {
+            // Overwrites must never expose a torn value
+            skip_list_->Insert("key" + std::to_string(i / 2), "value_updated");
+        }
+        inserted.store(i + 1, std::memory_order_release);
+    }
+    done = true;
+
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(skip_list_->GetAllEntries().size(), num_entries);
+}
+
+TEST_F(SkipListTest, Versions) {
+    EXPECT_TRUE(skip_list_->Insert("key1", "v1", 1));
+    EXPECT_TRUE(skip_list_->Insert("key1", "v3", 3));
+    EXPECT_TRUE(skip_list_->Insert("key1", "v2", 2));
+    EXPECT_TRUE(skip_list_->Insert("key0", "other", 4));
+
+    // Reads see the newest version at or below their sequence number
+    std::string value;
+    EXPECT_TRUE(skip_list_->Get("key1", &value));
+    EXPECT_EQ(value, "v3");
+    EXPECT_TRUE(skip_list_->Get("key1", &value, 2));
+    EXPECT_EQ(value, "v2");
+    EXPECT_TRUE(skip_list_->Get("key1", &value, 1));
+    EXPECT_EQ(value, "v1");
+    EXPECT_FALSE(skip_list_->Get("key1", &value, 0));
+    EXPECT_FALSE(skip_list_->Get("key0", &value, 3));
+
+    // Versions are visited newest first
+    auto it = skip_list_->NewIterator();
+    std::vector<std::pair<std::string, uint64_t>> versions;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        versions.emplace_back(it->Key(), it->Sequence());
+    }
+    std::vector<std::pair<std::string, uint64_t>> expected = {
+        {"key0", 4}, {"key1", 3}, {"key1", 2}, {"key1", 1}};
+    EXPECT_EQ(versions, expected);
+
+    // Rewriting a version replaces it
+    EXPECT_TRUE(skip_list_->Insert("key1", "v2_updated", 2));
+    EXPECT_TRUE(skip_list_->Get("key1", &value, 2));
+    EXPECT_EQ(value, "v2_updated");
+    EXPECT_EQ(skip_list_->GetAllEntries().size(), 4);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -1,8 +1,23 @@
 #include "sstable.h"
+#include "bloom_filter.h"
+#include "block_cache.h"
+#include "compression.h"
+#include "table_cache.h"
+#include "filter_policy.h"
+#include "prefix_extractor.h"
+#include "table_builder.h"
+#include "table_format.h"
 #include <gtest/gtest.h>
 #include <string>
 #include <filesystem>
+#include <fstream>
+#include <random>
 #include <vector>
+#include <thread>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 using namespace sstable;
 
@@ -144,6 +159,979 @@ TEST_F(SSTableTest, LoadExisting) {
     EXPECT_EQ(value, "value2");
 }
 
+TEST_F(SSTableTest, MultipleBlocks) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        entries.emplace_back(key, "value" + std::to_string(i));
+    }
+
+    TableOptions options;
+    options.block_size = 256;
+    std::string path = test_dir_ + "/test.sst";
+    {
+        SSTable sstable(path, entries, 0, options);
+        EXPECT_EQ(sstable.GetFormatVersion(), 6);
+    }
+
+    // Reopening reads only the sparse index: one key per block
+    SSTable loaded(path);
+    EXPECT_EQ(loaded.GetFormatVersion(), 6);
+    EXPECT_GT(loaded.GetIndexSize(), 1);
+    EXPECT_LT(loaded.GetIndexSize(), entries.size() / 10);
+    EXPECT_EQ(loaded.GetSmallestKey(), "key0000");
+    EXPECT_EQ(loaded.GetLargestKey(), "key0999");
+
+    for (const auto& [key, expected] : entries) {
+        std::string value;
+        EXPECT_TRUE(loaded.Get(key, &value));
+        EXPECT_EQ(value, expected);
+    }
+    std::string value;
+    EXPECT_FALSE(loaded.Get("key0500x", &value));
+    EXPECT_FALSE(loaded.Get("key9999", &value));
+
+    // Range crossing several block boundaries
+    auto range = loaded.GetRange("key0095", "key0305");
+    ASSERT_EQ(range.size(), 211);
+    EXPECT_EQ(range.front().first, "key0095");
+    EXPECT_EQ(range.back().first, "key0305");
+}
+
+TEST_F(SSTableTest, EmptyTable) {
+    std::string path = test_dir_ + "/test.sst";
+    {
+        SSTable sstable(path, {}, 0);
+    }
+
+    SSTable loaded(path);
+    std::string value;
+    EXPECT_FALSE(loaded.Get("key1", &value));
+    EXPECT_TRUE(loaded.GetRange("a", "z").empty());
+}
+
+TEST_F(SSTableTest, ReadsVersion1Files) {
+    std::vector<std::pair<std::string, std::string>> entries = {
+        {"key1", "value1"},
+        {"key2", "value2"},
+        {"key3", "value3"}
+    };
+
+    // Hand-write the original flat layout: header, entries, bloom filter
+    std::string path = test_dir_ + "/legacy.sst";
+    {
+        std::ofstream file(path, std::ios::binary);
+        const uint32_t magic = 0x53535442;
+        const uint32_t version = 1;
+        const uint64_t num_entries = entries.size();
+        file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        file.write(reinterpret_cast<const char*>(&num_entries), sizeof(num_entries));
+
+        // Original filter: 3 DJB2 hashes over a flat bit array
+        const uint64_t num_hashes = 3;
+        std::vector<uint64_t> words((entries.size() * 10 + 63) / 64);
+        for (const auto& [key, value] : entries) {
+            uint32_t key_len = key.size();
+            uint32_t value_len = value.size();
+            file.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+            file.write(reinterpret_cast<const char*>(&value_len), sizeof(value_len));
+            file.write(key.data(), key_len);
+            file.write(value.data(), value_len);
+            for (uint64_t i = 0; i < num_hashes; ++i) {
+                size_t hash = 5381;
+                for (char c : key) {
+                    hash = ((hash << 5) + hash) + c + i;
+                }
+                size_t bit = hash % (words.size() * 64);
+                words[bit / 64] |= uint64_t{1} << (bit % 64);
+            }
+        }
+
+        std::string bloom_data;
+        const uint64_t num_words = words.size();
+        bloom_data.append(reinterpret_cast<const char*>(&num_hashes), sizeof(num_hashes));
+        bloom_data.append(reinterpret_cast<const char*>(&num_words), sizeof(num_words));
+        bloom_data.append(reinterpret_cast<const char*>(words.data()), words.size() * 8);
+        uint32_t bloom_size = bloom_data.size();
+        file.write(reinterpret_cast<const char*>(&bloom_size), sizeof(bloom_size));
+        file.write(bloom_data.data(), bloom_size);
+    }
+
+    SSTable loaded(path);
+    EXPECT_EQ(loaded.GetFormatVersion(), 1);
+    EXPECT_EQ(loaded.GetSmallestKey(), "key1");
+    EXPECT_EQ(loaded.GetLargestKey(), "key3");
+
+    std::string value;
+    EXPECT_TRUE(loaded.Get("key2", &value));
+    EXPECT_EQ(value, "value2");
+    EXPECT_FALSE(loaded.Get("key4", &value));
+
+    auto range = loaded.GetRange("key2", "key3");
+    ASSERT_EQ(range.size(), 2);
+    EXPECT_EQ(range[0].second, "value2");
+    EXPECT_EQ(range[1].second, "value3");
+}
+
+TEST_F(SSTableTest, BlockCache) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 100; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        entries.emplace_back(key, "value" + std::to_string(i));
+    }
+
+    TableOptions options;
+    options.block_size = 256;
+    options.block_cache = std::make_shared<BlockCache>(1024 * 1024);
+    std::string path = test_dir_ + "/test.sst";
+    SSTable sstable(path, entries, 0, options);
+
+    std::string value;
+    EXPECT_TRUE(sstable.Get("key0042", &value));
+    EXPECT_EQ(options.block_cache->GetMisses(), 1);
+    EXPECT_EQ(options.block_cache->GetHits(), 0);
+
+    // Later reads of the same block never touch the file
+    std::filesystem::remove(path);
+    EXPECT_TRUE(sstable.Get("key0042", &value));
+    EXPECT_EQ(value, "value42");
+    EXPECT_EQ(options.block_cache->GetHits(), 1);
+    EXPECT_GT(options.block_cache->GetUsage(), 0);
+}
+
+
+TEST_F(SSTableTest, MmapReads) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        entries.emplace_back(key, "value" + std::to_string(i));
+    }
+
+    TableOptions options;
+    options.block_size = 256;
+    options.use_mmap_reads = true;
+    options.block_cache = std::make_shared<BlockCache>(1024 * 1024);
+    std::string path = test_dir_ + "/test.sst";
+    {
+        SSTable sstable(path, entries, 0, options);
+        std::string value;
+        EXPECT_TRUE(sstable.Get("key0123", &value));
+        EXPECT_EQ(value, "value123");
+    }
+
+    SSTable loaded(path, options);
+    for (const auto& [key, expected] : entries) {
+        std::string value;
+        EXPECT_TRUE(loaded.Get(key, &value));
+        EXPECT_EQ(value, expected);
+    }
+    std::string value;
+    EXPECT_FALSE(loaded.Get("key0500x", &value));
+
+    auto range = loaded.GetRange("key0095", "key0305");
+    ASSERT_EQ(range.size(), 211);
+    EXPECT_EQ(range.front().first, "key0095");
+    EXPECT_EQ(range.back().first, "key0305");
+    EXPECT_EQ(loaded.GetRange("key0995", "zzz").size(), 5);
+
+    // Mapped reads never go through the block cache
+    EXPECT_EQ(options.block_cache->GetHits() + options.block_cache->GetMisses(), 0);
+}
+
+
+TEST_F(SSTableTest, MmapScansReadAhead) {
+    // About 4MB in 4KB blocks of a few entries each
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 4000; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%05d", i);
+        entries.emplace_back(key, std::string(1000, 'a' + i % 26));
+    }
+    TableOptions options;
+    options.block_size = 4096;
+    options.use_mmap_reads = true;
+    const std::string path = test_dir_ + "/readahead.sst";
+    {
+        SSTable table(path, entries, 0, options);
+    }
+
+    // Watch which pages of the file are in the page cache through a mapping
+    // of our own, which never faults them in
+    const int fd = open(path.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    const size_t size = std::filesystem::file_size(path);
+    void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ASSERT_NE(view, MAP_FAILED);
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto resident = [&](size_t offset) {
+        unsigned char page = 0;
+        mincore(static_cast<char*>(view) + offset / page_size * page_size, 1, &page);
+        return (page & 1) != 0;
+    };
+    auto eventually_resident = [&](size_t offset) {
+        for (int i = 0; i < 200 && !resident(offset); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return resident(offset);
+    };
+    auto evict = [&] { posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED); };
+    evict();
+    if (resident(0)) {
+        munmap(view, size);
+        close(fd);
+        GTEST_SKIP() << "The page cache cannot be dropped here";
+    }
+
+    // Well past the blocks the scans below read, but within one readahead
+    const size_t ahead = 128 * 1024;
+    const size_t far = 2 * 1024 * 1024;
+
+    // A bulk scan reads ahead from its first block
+    {
+        SSTable table(path, options);
+        auto it = table.NewIterator(false);
+        it->SeekToFirst();
+        ASSERT_TRUE(it->Valid());
+        EXPECT_TRUE(eventually_resident(ahead));
+        EXPECT_FALSE(resident(far));
+    }
+
+    // Any other scan once it steps into the next block; positioning alone
+    // is a point read
+    evict();
+    {
+        SSTable table(path, options);
+        auto it = table.NewIterator();
+        it->SeekToFirst();
+        ASSERT_TRUE(it->Valid());
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_FALSE(resident(ahead));
+        for (int i = 0; i < 10; ++i) {
+            it->Next();
+            ASSERT_TRUE(it->Valid());
+        }
+        EXPECT_TRUE(eventually_resident(ahead));
+        EXPECT_FALSE(resident(far));
+    }
+
+    munmap(view, size);
+    close(fd);
+}
+
+TEST_F(SSTableTest, SharedTableCache) {
+    TableOptions options;
+    options.table_cache = std::make_shared<TableCache>(2);
+
+    std::vector<std::unique_ptr<SSTable>> tables;
+    for (int t = 0; t < 5; ++t) {
+        std::vector<std::pair<std::string, std::string>> entries = {
+            {"key" + std::to_string(t), "value" + std::to_string(t)}
+        };
+        tables.push_back(std::make_unique<SSTable>(
+            test_dir_ + "/table" + std::to_string(t) + ".sst", entries, 0, options));
+    }
+
+    // Every table stays readable while only two descriptors are kept open
+    for (int round = 0; round < 2; ++round) {
+        for (int t = 0; t < 5; ++t) {
+            std::string value;
+            EXPECT_TRUE(tables[t]->Get("key" + std::to_string(t), &value));
+            EXPECT_EQ(value, "value" + std::to_string(t));
+            EXPECT_LE(options.table_cache->GetOpenFiles(), 2);
+        }
+    }
+
+    tables.clear();
+    EXPECT_EQ(options.table_cache->GetOpenFiles(), 0);
+}
+
+TEST_F(SSTableTest, ConcurrentReaders) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        entries.emplace_back(key, "value" + std::to_string(i));
+    }
+
+    TableOptions options;
+    options.block_size = 256;
+    SSTable sstable(test_dir_ + "/test.sst", entries, 0, options);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&sstable, &entries, t]() {
+            for (size_t i = t; i < entries.size(); i += 3) {
+                std::string value;
+                EXPECT_TRUE(sstable.Get(entries[i].first, &value));
+                EXPECT_EQ(value, entries[i].second);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+
+TEST_F(SSTableTest, BloomFilterFalsePositiveRate) {
+    const int num_keys = 10000;
+    const size_t bits_per_key = 10;
+    BloomFilter filter(num_keys * bits_per_key, BloomFilter::OptimalNumHashes(bits_per_key));
+    for (int i = 0; i < num_keys; ++i) {
+        filter.Add("key" + std::to_string(i));
+    }
+
+    auto loaded = BloomFilter::Deserialize(filter.Serialize());
+    ASSERT_NE(loaded, nullptr);
+    for (int i = 0; i < num_keys; ++i) {
+        EXPECT_TRUE(loaded->MightContain("key" + std::to_string(i)));
+    }
+
+    int false_positives = 0;
+    for (int i = 0; i < num_keys; ++i) {
+        if (loaded->MightContain("missing" + std::to_string(i))) {
+            ++false_positives;
+        }
+    }
+    EXPECT_LT(false_positives, num_keys / 50);
+
+    EXPECT_EQ(BloomFilter::Deserialize("garbage"), nullptr);
+}
+
+TEST_F(SSTableTest, NoBloomFilter) {
+    std::vector<std::pair<std::string, std::string>> entries = {
+        {"key1", "value1"},
+        {"key2", "value2"}
+    };
+
+    TableOptions options;
+    options.bloom_bits_per_key = 0;
+    std::string path = test_dir_ + "/test.sst";
+    {
+        SSTable sstable(path, entries, 0, options);
+    }
+
+    SSTable loaded(path);
+    std::string value;
+    EXPECT_TRUE(loaded.Get("key2", &value));
+    EXPECT_EQ(value, "value2");
+    EXPECT_FALSE(loaded.Get("key3", &value));
+}
+
+
+TEST_F(SSTableTest, PerLevelFilterPolicy) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        entries.emplace_back(key, "value" + std::to_string(i));
+    }
+
+    TableOptions options;
+    options.level_filter_policies[2] = NewXorFilterPolicy();
+    {
+        SSTable bloom_table(test_dir_ + "/level0.sst", entries, 0, options);
+        SSTable xor_table(test_dir_ + "/level2.sst", entries, 2, options);
+    }
+
+    // Each table records its policy, so default options can read both
+    for (const char* name : {"/level0.sst", "/level2.sst"}) {
+        SSTable loaded(test_dir_ + name);
+        for (const auto& [key, expected] : entries) {
+            std::string value;
+            EXPECT_TRUE(loaded.Get(key, &value));
+            EXPECT_EQ(value, expected);
+        }
+        std::string value;
+        EXPECT_FALSE(loaded.Get("nonexistent_key", &value));
+    }
+}
+
+
+TEST_F(SSTableTest, PrefixFilter) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (const char* tenant : {"tenant1/", "tenant3/"}) {
+        for (int i = 0; i < 100; ++i) {
+            char entity[16];
+            snprintf(entity, sizeof(entity), "entity%03d", i);
+            entries.emplace_back(tenant + std::string(entity), "value");
+        }
+    }
+
+    TableOptions options;
+    options.prefix_extractor = NewDelimitedPrefixExtractor('/');
+    std::string path = test_dir_ + "/test.sst";
+    {
+        SSTable sstable(path, entries, 0, options);
+        EXPECT_TRUE(sstable.PrefixMayMatch("tenant1/"));
+        EXPECT_FALSE(sstable.PrefixMayMatch("tenant2/"));
+    }
+
+    SSTable loaded(path, options);
+    EXPECT_TRUE(loaded.PrefixMayMatch("tenant1/"));
+    EXPECT_TRUE(loaded.PrefixMayMatch("tenant3/"));
+    EXPECT_FALSE(loaded.PrefixMayMatch("tenant2/"));
+    std::string value;
+    EXPECT_TRUE(loaded.Get("tenant3/entity042", &value));
+
+    // A filter built for another extractor cannot rule out prefixes
+    TableOptions other;
+    other.prefix_extractor = NewFixedPrefixExtractor(7);
+    SSTable mismatched(path, other);
+    EXPECT_TRUE(mismatched.PrefixMayMatch("tenant2"));
+}
+
+TEST_F(SSTableTest, ScanPrefix) {
+    auto delimited = NewDelimitedPrefixExtractor('/');
+    std::string_view prefix;
+    EXPECT_TRUE(GetScanPrefix(*delimited, "tenant1/", "tenant1/\xff", &prefix));
+    EXPECT_EQ(prefix, "tenant1/");
+    EXPECT_FALSE(GetScanPrefix(*delimited, "tenant1/", "tenant2/", &prefix));
+    EXPECT_FALSE(GetScanPrefix(*delimited, "tenant1", "tenant1/a", &prefix));
+
+    auto fixed = NewFixedPrefixExtractor(3);
+    EXPECT_TRUE(GetScanPrefix(*fixed, "abc1", "abc9", &prefix));
+    EXPECT_EQ(prefix, "abc");
+    EXPECT_FALSE(GetScanPrefix(*fixed, "ab", "abc9", &prefix));
+    EXPECT_STRNE(fixed->Name(), NewFixedPrefixExtractor(4)->Name());
+}
+
+
+TEST_F(SSTableTest, Iterator) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 500; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i * 2);
+        entries.emplace_back(key, "value" + std::to_string(i));
+    }
+
+    TableOptions options;
+    options.block_size = 256;
+    SSTable sstable(test_dir_ + "/test.sst", entries, 0, options);
+    ASSERT_GT(sstable.GetIndexSize(), 1);
+
+    // A full scan crosses every block boundary in order
+    auto it = sstable.NewIterator();
+    EXPECT_FALSE(it->Valid());
+    size_t count = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        ASSERT_LT(count, entries.size());
+        EXPECT_EQ(it->Key(), entries[count].first);
+        EXPECT_EQ(it->Value(), entries[count].second);
+        ++count;
+    }
+    EXPECT_EQ(count, entries.size());
+
+    // Seek lands on the first key at or after the target
+    it->Seek("key0500");
+    ASSERT_TRUE(it->Valid());
+    EXPECT_EQ(it->Key(), "key0500");
+    it->Seek("key0501");
+    ASSERT_TRUE(it->Valid());
+    EXPECT_EQ(it->Key(), "key0502");
+    it->Seek("");
+    ASSERT_TRUE(it->Valid());
+    EXPECT_EQ(it->Key(), "key0000");
+    it->Seek("key9999");
+    EXPECT_FALSE(it->Valid());
+
+    SSTable empty(test_dir_ + "/empty.sst", {}, 0);
+    auto empty_it = empty.NewIterator();
+    empty_it->SeekToFirst();
+    EXPECT_FALSE(empty_it->Valid());
+}
+
+TEST_F(SSTableTest, IteratorWithoutFillingCache) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 200; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        entries.emplace_back(key, std::string(100, 'v'));
+    }
+
+    TableOptions options;
+    options.block_size = 512;
+    options.block_cache = std::make_shared<BlockCache>(1 << 20);
+    SSTable sstable(test_dir_ + "/test.sst", entries, 0, options);
+
+    auto it = sstable.NewIterator(false);
+    size_t count = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        ++count;
+    }
+    EXPECT_EQ(count, entries.size());
+    EXPECT_EQ(options.block_cache->GetUsage(), 0);
+
+    it = sstable.NewIterator();
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    }
+    EXPECT_GT(options.block_cache->GetUsage(), 0);
+}
+
+TEST_F(SSTableTest, TableBuilder) {
+    TableOptions options;
+    options.block_size = 256;
+    options.prefix_extractor = NewFixedPrefixExtractor(4);
+    std::string path = test_dir_ + "/built.sst";
+    {
+        TableBuilder builder(path, 2, options);
+        for (int i = 0; i < 300; ++i) {
+            char key[16];
+            snprintf(key, sizeof(key), "k%03d%04d", i / 100, i);
+            builder.Add(key, "value" + std::to_string(i));
+        }
+        EXPECT_EQ(builder.GetNumEntries(), 300);
+        builder.Finish();
+        EXPECT_EQ(builder.GetFileSize(), std::filesystem::file_size(path));
+    }
+
+    // The level and prefix filter survive a reopen
+    SSTable loaded(path, options);
+    EXPECT_EQ(loaded.GetLevel(), 2);
+    EXPECT_EQ(loaded.GetSmallestKey(), "k0000000");
+    EXPECT_EQ(loaded.GetLargestKey(), "k0020299");
+    EXPECT_GT(loaded.GetIndexSize(), 1);
+    std::string value;
+    EXPECT_TRUE(loaded.Get("k0010150", &value));
+    EXPECT_EQ(value, "value150");
+    EXPECT_TRUE(loaded.PrefixMayMatch("k001"));
+    EXPECT_FALSE(loaded.PrefixMayMatch("k999"));
+
+    // An unfinished builder removes its partial file
+    std::string abandoned = test_dir_ + "/abandoned.sst";
+    {
+        TableBuilder builder(abandoned, 0, options);
+        builder.Add("key", "value");
+    }
+    EXPECT_FALSE(std::filesystem::exists(abandoned));
+}
+TEST_F(SSTableTest, SequenceNumbers) {
+    TableOptions options;
+    options.block_size = 64;
+    std::string path = test_dir_ + "/versions.sst";
+    {
+        // Versions of key2 span several blocks
+        TableBuilder builder(path, 0, options);
+        builder.Add("key1", "v1", 5);
+        for (uint64_t sequence = 40; sequence > 10; --sequence) {
+            builder.Add("key2", "value_at_" + std::to_string(sequence), sequence);
+        }
+        builder.Add("key3", "v3", 2);
+        builder.Finish();
+    }
+
+    SSTable table(path, options);
+    EXPECT_EQ(table.GetLargestSequence(), 40);
+    EXPECT_GT(table.GetIndexSize(), 3);
+
+    std::string value;
+    EXPECT_TRUE(table.Get("key2", &value));
+    EXPECT_EQ(value, "value_at_40");
+    EXPECT_TRUE(table.Get("key2", &value, 12));
+    EXPECT_EQ(value, "value_at_12");
+    EXPECT_FALSE(table.Get("key2", &value, 10));
+    EXPECT_FALSE(table.Get("key3", &value, 1));
+
+    // Range scans return only the newest version of each key
+    auto range = table.GetRange("key1", "key3");
+    ASSERT_EQ(range.size(), 3);
+    EXPECT_EQ(range[1].second, "value_at_40");
+
+    auto it = table.NewIterator();
+    it->Seek("key2");
+    ASSERT_TRUE(it->Valid());
+    EXPECT_EQ(it->Sequence(), 40);
+    size_t versions = 0;
+    for (; it->Valid() && it->Key() == "key2"; it->Next()) {
+        ++versions;
+    }
+    EXPECT_EQ(versions, 30);
+
+    // Tables built from plain entries carry sequence number 0
+    SSTable plain(test_dir_ + "/plain.sst", {{"key", "value"}}, 0);
+    EXPECT_EQ(plain.GetLargestSequence(), 0);
+}
+
+TEST_F(SSTableTest, TypedEntriesAndRangeTombstones) {
+    std::string path = test_dir_ + "/typed.sst";
+    {
+        TableBuilder builder(path, 0, TableOptions());
+        builder.Add("deleted", "", 9, ValueType::kDeletion);
+        builder.Add("deleted", "old", 4);
+        builder.Add("empty", "", 6);
+        builder.AddRangeTombstone({"x", "z", 8});
+        builder.AddRangeTombstone({"a", "c", 3});
+        builder.Finish();
+    }
+
+    SSTable table(path);
+    EXPECT_EQ(table.GetFormatVersion(), 6);
+    EXPECT_EQ(table.GetSmallestSequence(), 3);
+    EXPECT_EQ(table.GetLargestSequence(), 9);
+    // Range tombstones do not widen the key range
+    EXPECT_EQ(table.GetSmallestKey(), "deleted");
+    EXPECT_EQ(table.GetLargestKey(), "empty");
+
+    std::string value;
+    EXPECT_TRUE(table.Get("empty", &value));
+    EXPECT_EQ(value, "");
+    EXPECT_FALSE(table.Get("deleted", &value));
+    EXPECT_TRUE(table.Get("deleted", &value, 8));
+    EXPECT_EQ(value, "old");
+
+    ValueType type;
+    uint64_t sequence;
+    ASSERT_TRUE(table.Find("deleted", kMaxSequenceNumber, &value, &type, &sequence));
+    EXPECT_EQ(type, ValueType::kDeletion);
+    EXPECT_EQ(sequence, 9);
+
+    const auto& tombstones = table.GetRangeTombstones();
+    ASSERT_EQ(tombstones.size(), 2);
+    EXPECT_EQ(tombstones[0].begin, "x");
+    EXPECT_EQ(tombstones[0].end, "z");
+    EXPECT_EQ(tombstones[0].sequence, 8);
+    EXPECT_EQ(tombstones[1].begin, "a");
+
+    // Deleted keys are left out of ranges, empty values are not
+    auto range = table.GetRange("a", "z");
+    ASSERT_EQ(range.size(), 1);
+    EXPECT_EQ(range[0].first, "empty");
+
+    // Plain entries are all values, empty ones included
+    SSTable plain(test_dir_ + "/plain.sst", {{"a", ""}, {"b", "value"}}, 0);
+    ASSERT_TRUE(plain.Get("a", &value));
+    EXPECT_EQ(value, "");
+    EXPECT_TRUE(plain.Get("b", &value));
+    EXPECT_EQ(plain.GetRange("a", "b").size(), 2);
+}
+
+TEST_F(SSTableTest, MultiFind) {
+    TableOptions options;
+    options.block_size = 512;
+    options.block_cache = std::make_shared<BlockCache>(1024 * 1024);
+    std::string path = test_dir_ + "/multi.sst";
+    {
+        // Three versions of every key, the newest a deletion for multiples of 7
+        TableBuilder builder(path, 0, options);
+        for (int i = 0; i < 1000; ++i) {
+            std::string key = "key" + std::to_string(10000 + i);
+            for (uint64_t sequence = 30; sequence >= 10; sequence -= 10) {
+                if (sequence == 30 && i % 7 == 0) {
+                    builder.Add(key, "", sequence, ValueType::kDeletion);
+                } else {
+                    builder.Add(key, key + "@" + std::to_string(sequence), sequence);
+                }
+            }
+        }
+        builder.Finish();
+    }
+    SSTable table(path, options);
+    ASSERT_GT(table.GetIndexSize(), 50);
+
+    // Every other key, plus keys between, before and after the table's keys
+    std::vector<std::string> keys = {"a"};
+    for (int i = 0; i < 1000; i += 2) {
+        keys.push_back("key" + std::to_string(10000 + i));
+        keys.push_back("key" + std::to_string(10000 + i) + "x");
+    }
+    keys.push_back("z");
+
+    for (uint64_t sequence : {kMaxSequenceNumber, uint64_t{25}, uint64_t{5}}) {
+        std::vector<KeyLookup> lookups(keys.size());
+        std::vector<KeyLookup*> pointers;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            lookups[i].key = &keys[i];
+            pointers.push_back(&lookups[i]);
+        }
+        const uint64_t reads_before = options.block_cache->GetHits() +
+                                      options.block_cache->GetMisses();
+        table.MultiFind(pointers, sequence);
+        const uint64_t reads = options.block_cache->GetHits() +
+                               options.block_cache->GetMisses() - reads_before;
+
+        // Keys sharing a block share its read
+        EXPECT_LE(reads, table.GetIndexSize() * 2);
+        EXPECT_LT(reads, keys.size() / 4);
+
+        for (const auto& lookup : lookups) {
+            std::string value;
+            ValueType type;
+            uint64_t found_sequence;
+            const bool found = table.Find(*lookup.key, sequence, &value, &type, &found_sequence);
+            ASSERT_EQ(lookup.found, found) << *lookup.key;
+            if (found) {
+                EXPECT_EQ(lookup.value, value);
+                EXPECT_EQ(lookup.type, type);
+                EXPECT_EQ(lookup.found_sequence, found_sequence);
+            }
+        }
+    }
+}
+
+TEST_F(SSTableTest, LazyOpen) {
+    std::string path = test_dir_ + "/lazy.sst";
+    TableOptions options;
+    options.block_size = 256;
+    {
+        TableBuilder builder(path, 2, options);
+        for (int i = 0; i < 500; ++i) {
+            builder.Add("key" + std::to_string(1000 + i), "value" + std::to_string(i), 100 + i);
+        }
+        builder.AddRangeTombstone({"a", "b", 700});
+        builder.Finish();
+    }
+
+    FileMetaData metadata;
+    {
+        SSTable eager(path, options);
+        metadata.level = eager.GetLevel();
+        metadata.smallest_key = eager.GetSmallestKey();
+        metadata.largest_key = eager.GetLargestKey();
+        metadata.size = eager.GetSize();
+        metadata.smallest_sequence = eager.GetSmallestSequence();
+        metadata.largest_sequence = eager.GetLargestSequence();
+        metadata.range_tombstones = eager.GetRangeTombstones();
+        EXPECT_TRUE(eager.IsLoaded());
+    }
+
+    // The description answers everything but lookups
+    SSTable table(path, metadata, options);
+    EXPECT_FALSE(table.IsLoaded());
+    EXPECT_EQ(table.GetLevel(), 2);
+    EXPECT_EQ(table.GetSmallestKey(), "key1000");
+    EXPECT_EQ(table.GetLargestKey(), "key1499");
+    EXPECT_EQ(table.GetSmallestSequence(), 100);
+    EXPECT_EQ(table.GetLargestSequence(), 700);
+    ASSERT_EQ(table.GetRangeTombstones().size(), 1);
+    EXPECT_EQ(table.GetSize(), std::filesystem::file_size(path));
+    EXPECT_FALSE(table.IsLoaded());
+
+    // Concurrent first lookups load the table once
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&table, t]() {
+            for (int i = t; i < 500; i += 4) {
+                std::string value;
+                EXPECT_TRUE(table.Get("key" + std::to_string(1000 + i), &value));
+                EXPECT_EQ(value, "value" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_TRUE(table.IsLoaded());
+    EXPECT_GT(table.GetIndexSize(), 10);
+
+    // A mapping is only made over a file of the described size
+    TableOptions mapped = options;
+    mapped.use_mmap_reads = true;
+    FileMetaData oversized = metadata;
+    oversized.size += 4096;
+    SSTable mismatched(path, oversized, mapped);
+    std::string value;
+    EXPECT_THROW(mismatched.Get("key1000", &value), std::runtime_error);
+    SSTable described(path, metadata, mapped);
+    EXPECT_TRUE(described.Get("key1000", &value));
+
+    // A lazy table only fails once it is read
+    std::filesystem::resize_file(path, 16);
+    SSTable broken(path, metadata, options);
+    EXPECT_EQ(broken.GetLargestKey(), "key1499");
+    EXPECT_THROW(broken.Get("key1000", &value), std::runtime_error);
+    EXPECT_FALSE(broken.IsLoaded());
+}
+
+TEST_F(SSTableTest, CompressedBlocks) {
+    // JSON values repeat their field names, so they compress well
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 2000; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        entries.emplace_back(key, "{\"id\":" + std::to_string(i) +
+                                  ",\"status\":\"active\",\"region\":\"eu-west\"," +
+                                  "\"tags\":[\"alpha\",\"beta\",\"gamma\"]}");
+    }
+
+    TableOptions raw_options;
+    TableOptions options;
+    options.compressor = NewLZCompressor();
+    const std::string raw_path = test_dir_ + "/raw.sst";
+    const std::string path = test_dir_ + "/compressed.sst";
+    {
+        SSTable raw(raw_path, entries, 0, raw_options);
+        SSTable compressed(path, entries, 0, options);
+        EXPECT_LT(compressed.GetSize() * 2, raw.GetSize());
+    }
+
+    // The table names its compressor, so it reads back without one
+    // configured, through the block cache and through a mapping
+    TableOptions cached;
+    cached.block_cache = std::make_shared<BlockCache>(1024 * 1024);
+    TableOptions mapped;
+    mapped.use_mmap_reads = true;
+    mapped.block_cache = std::make_shared<BlockCache>(1024 * 1024);
+    for (const TableOptions& read_options : {TableOptions(), cached, mapped}) {
+        SSTable loaded(path, read_options);
+        EXPECT_EQ(loaded.GetFormatVersion(), 6);
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const auto& [key, expected] : entries) {
+                std::string value;
+                EXPECT_TRUE(loaded.Get(key, &value));
+                EXPECT_EQ(value, expected);
+            }
+        }
+        std::string value;
+        EXPECT_FALSE(loaded.Get("key1000x", &value));
+        EXPECT_EQ(loaded.GetRange("key0100", "key0199").size(), 100);
+
+        auto it = loaded.NewIterator();
+        size_t count = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            ++count;
+        }
+        EXPECT_EQ(count, entries.size());
+    }
+
+    // Mapped compressed blocks are cached uncompressed
+    EXPECT_GT(mapped.block_cache->GetHits(), 0);
+}
+
+TEST_F(SSTableTest, IncompressibleBlocksAreStoredRaw) {
+    std::mt19937 rng(7);
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 500; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        std::string value(100, '\0');
+        for (char& c : value) {
+            c = static_cast<char>(rng());
+        }
+        entries.emplace_back(key, value);
+    }
+
+    TableOptions options;
+    options.compressor = NewLZCompressor();
+    SSTable raw(test_dir_ + "/raw.sst", entries, 0, TableOptions());
+    SSTable table(test_dir_ + "/random.sst", entries, 0, options);
+
+    // Only the compressor's name in the properties is added
+    EXPECT_LE(table.GetSize(), raw.GetSize() + 32);
+    for (const auto& [key, expected] : entries) {
+        std::string value;
+        EXPECT_TRUE(table.Get(key, &value));
+        EXPECT_EQ(value, expected);
+    }
+}
+
+TEST_F(SSTableTest, PerLevelCompressor) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 1000; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        entries.emplace_back(key, std::string(100, 'a' + i % 26));
+    }
+
+    TableOptions options;
+    options.compressor = NewLZCompressor();
+    options.level_compressors[0] = nullptr;
+    SSTable level0(test_dir_ + "/level0.sst", entries, 0, options);
+    SSTable level2(test_dir_ + "/level2.sst", entries, 2, options);
+    EXPECT_LT(level2.GetSize() * 4, level0.GetSize());
+
+    std::string value;
+    EXPECT_TRUE(level0.Get("key0001", &value));
+    EXPECT_EQ(value, std::string(100, 'b'));
+    EXPECT_TRUE(level2.Get("key0001", &value));
+    EXPECT_EQ(value, std::string(100, 'b'));
+}
+
+TEST_F(SSTableTest, CustomCompressor) {
+    // Stores blocks reversed, which is enough to tell it was applied
+    class ReverseCompressor : public Compressor {
+    public:
+        const char* Name() const override { return "test.Reverse"; }
+        bool Compress(std::string_view input, std::string* output) const override {
+            output->assign(input.rbegin(), input.rend());
+            return true;
+        }
+        bool Uncompress(std::string_view input, std::string* output) const override {
+            output->assign(input.rbegin(), input.rend());
+            return true;
+        }
+    };
+
+    std::vector<std::pair<std::string, std::string>> entries = {
+        {"key1", "value1"}, {"key2", "value2"}};
+    TableOptions options;
+    options.compressor = std::make_shared<ReverseCompressor>();
+    options.min_compression_savings_percent = 0;
+    const std::string path = test_dir_ + "/custom.sst";
+    {
+        SSTable table(path, entries, 0, options);
+    }
+
+    // Data blocks cannot be read without the compressor that wrote them
+    EXPECT_THROW(SSTable(path, TableOptions()), std::runtime_error);
+    SSTable loaded(path, options);
+    std::string value;
+    EXPECT_TRUE(loaded.Get("key2", &value));
+    EXPECT_EQ(value, "value2");
+}
+
+TEST_F(SSTableTest, CorruptBlocksThrow) {
+    std::vector<std::pair<std::string, std::string>> entries = {
+        {"key1", "value1"}, {"key2", "value2"}, {"key3", "value3"}};
+    const std::string path = test_dir_ + "/corrupt.sst";
+    {
+        SSTable table(path, entries, 0);
+    }
+
+    // The only data block ends right before the filter block, which the
+    // first handle of the footer locates
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(-56, std::ios::end);
+    uint64_t filter_offset;
+    file.read(reinterpret_cast<char*>(&filter_offset), sizeof(filter_offset));
+
+    const uint64_t trailer_offset = filter_offset - 1;
+    auto expect_corrupt = [&]() {
+        SSTable table(path);
+        std::string value;
+        EXPECT_THROW(table.Get("key3", &value), std::runtime_error);
+        EXPECT_THROW(table.GetRange("key1", "key3"), std::runtime_error);
+        KeyLookup lookup;
+        const std::string key = "key3";
+        lookup.key = &key;
+        EXPECT_THROW(table.MultiFind({&lookup}, kMaxSequenceNumber), std::runtime_error);
+        auto it = table.NewIterator();
+        EXPECT_THROW({
+            for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            }
+        }, std::runtime_error);
+    };
+
+    // An unknown block type
+    file.seekp(trailer_offset);
+    file.put(7);
+    file.flush();
+    expect_corrupt();
+
+    // A raw block whose last entry claims a longer value than the block holds.
+    // Each entry is key length, value length and tag (one byte each), then
+    // the 4-byte key and the 6-byte value
+    file.seekp(trailer_offset);
+    file.put(static_cast<char>(kRawBlock));
+    file.seekp(trailer_offset - 6 - 4 - 2);
+    file.put(100);
+    file.flush();
+    expect_corrupt();
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
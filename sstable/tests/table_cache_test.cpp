@@ -0,0 +1,124 @@
+#include "table_cache.h"
+#include "random_access_file.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <thread>
+
+using namespace sstable;
+
+class TableCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = "/tmp/table_cache_test";
+        std::filesystem::create_directories(test_dir_);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(test_dir_);
+    }
+
+    std::string WriteFile(const std::string& name, const std::string& contents) {
+        std::string path = test_dir_ + "/" + name;
+        std::ofstream file(path, std::ios::binary);
+        file << contents;
+        return path;
+    }
+
+    std::string test_dir_;
+};
+
+TEST_F(TableCacheTest, PositionalReads) {
+    std::string path = WriteFile("file", "0123456789");
+    RandomAccessFile file(path);
+
+    std::string contents;
+    EXPECT_TRUE(file.Read(3, 4, &contents));
+    EXPECT_EQ(contents, "3456");
+    EXPECT_TRUE(file.Read(0, 10, &contents));
+    EXPECT_EQ(contents, "0123456789");
+
+    // Reads past the end fail instead of returning short data
+    EXPECT_FALSE(file.Read(8, 4, &contents));
+}
+
+TEST_F(TableCacheTest, MissingFileThrows) {
+    EXPECT_THROW(RandomAccessFile(test_dir_ + "/missing"), std::runtime_error);
+
+    TableCache cache(2);
+    EXPECT_THROW(cache.Open(1, test_dir_ + "/missing"), std::runtime_error);
+    EXPECT_EQ(cache.GetOpenFiles(), 0);
+}
+
+TEST_F(TableCacheTest, ReusesOpenFile) {
+    std::string path = WriteFile("file", "data");
+    TableCache cache(2);
+
+    auto first = cache.Open(1, path);
+    auto second = cache.Open(1, path);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(cache.GetOpenFiles(), 1);
+}
+
+TEST_F(TableCacheTest, EvictsLeastRecentlyUsed) {
+    TableCache cache(2);
+    std::vector<std::string> paths;
+    for (int i = 0; i < 3; ++i) {
+        paths.push_back(WriteFile("file" + std::to_string(i), "data" + std::to_string(i)));
+    }
+
+    auto file0 = cache.Open(0, paths[0]);
+    auto file1 = cache.Open(1, paths[1]);
+    cache.Open(0, paths[0]);
+    cache.Open(2, paths[2]);
+    EXPECT_EQ(cache.GetOpenFiles(), 2);
+
+    // File 1 was the coldest and must be reopened
+    EXPECT_NE(cache.Open(1, paths[1]), file1);
+    // A reader still holding an evicted file can keep using it
+    std::string contents;
+    EXPECT_TRUE(file1->Read(0, 5, &contents));
+    EXPECT_EQ(contents, "data1");
+}
+
+TEST_F(TableCacheTest, Evict) {
+    std::string path = WriteFile("file", "data");
+    TableCache cache(2);
+
+    cache.Open(1, path);
+    cache.Evict(1);
+    cache.Evict(2);
+    EXPECT_EQ(cache.GetOpenFiles(), 0);
+}
+
+TEST_F(TableCacheTest, ConcurrentReaders) {
+    std::string contents;
+    for (int i = 0; i < 1000; ++i) {
+        contents += static_cast<char>('a' + i % 26);
+    }
+    std::string path = WriteFile("file", contents);
+    TableCache cache(1);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, &path, &contents]() {
+            for (int i = 0; i < 500; ++i) {
+                std::string block;
+                uint64_t offset = (i * 7) % 990;
+                EXPECT_TRUE(cache.Open(1, path)->Read(offset, 10, &block));
+                EXPECT_EQ(block, contents.substr(offset, 10));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(cache.GetOpenFiles(), 1);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,173 @@
+#include "wal.h"
+#include "lsm_tree.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <thread>
+
+using namespace sstable;
+
+class WriteAheadLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = "/tmp/wal_test";
+        std::filesystem::create_directories(test_dir_);
+        log_path_ = test_dir_ + "/test.log";
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(test_dir_);
+    }
+
+    std::vector<std::string> ReadAll() {
+        std::vector<std::string> records;
+        WriteAheadLog::Replay(log_path_, [&records](const std::string& record) {
+            records.push_back(record);
+        });
+        return records;
+    }
+
+    std::string test_dir_;
+    std::string log_path_;
+};
+
+TEST_F(WriteAheadLogTest, AppendAndReplay) {
+    {
+        WriteAheadLog wal(log_path_, WalSyncMode::kEveryWrite,
+                          std::chrono::milliseconds(100));
+        EXPECT_TRUE(wal.AddRecord("record1"));
+        EXPECT_TRUE(wal.AddRecord(""));
+        EXPECT_TRUE(wal.AddRecord(std::string(10000, 'x')));
+    }
+
+    auto records = ReadAll();
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(records[0], "record1");
+    EXPECT_EQ(records[1], "");
+    EXPECT_EQ(records[2], std::string(10000, 'x'));
+}
+
+TEST_F(WriteAheadLogTest, ReopenAppends) {
+    {
+        WriteAheadLog wal(log_path_, WalSyncMode::kNone, std::chrono::milliseconds(100));
+        EXPECT_TRUE(wal.AddRecord("first"));
+    }
+    {
+        WriteAheadLog wal(log_path_, WalSyncMode::kInterval, std::chrono::milliseconds(1));
+        EXPECT_TRUE(wal.AddRecord("second"));
+    }
+
+    auto records = ReadAll();
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0], "first");
+    EXPECT_EQ(records[1], "second");
+}
+
+TEST_F(WriteAheadLogTest, TruncatedTailIsIgnored) {
+    {
+        WriteAheadLog wal(log_path_, WalSyncMode::kNone, std::chrono::milliseconds(100));
+        EXPECT_TRUE(wal.AddRecord("intact"));
+        EXPECT_TRUE(wal.AddRecord("torn record"));
+    }
+
+    // Simulate a crash in the middle of the last write
+    auto size = std::filesystem::file_size(log_path_);
+    std::filesystem::resize_file(log_path_, size - 3);
+
+    auto records = ReadAll();
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_EQ(records[0], "intact");
+}
+
+TEST_F(WriteAheadLogTest, CorruptRecordStopsReplay) {
+    {
+        WriteAheadLog wal(log_path_, WalSyncMode::kNone, std::chrono::milliseconds(100));
+        EXPECT_TRUE(wal.AddRecord("good"));
+        EXPECT_TRUE(wal.AddRecord("bad"));
+    }
+
+    // Flip a payload byte of the second record
+    std::fstream file(log_path_, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(8 + 4 + 8);
+    file.put('X');
+    file.close();
+
+    auto records = ReadAll();
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_EQ(records[0], "good");
+}
+
+TEST_F(WriteAheadLogTest, LSMTreeRecoversUnflushedWrites) {
+    {
+        LSMTree tree(test_dir_, 64 * 1024 * 1024);
+        EXPECT_TRUE(tree.Put("key1", "value1"));
+        EXPECT_TRUE(tree.Put("key2", "value2"));
+        EXPECT_TRUE(tree.Put("key1", "value1_updated"));
+        EXPECT_TRUE(tree.Delete("key2"));
+    }
+
+    LSMTree recovered(test_dir_, 64 * 1024 * 1024);
+    std::string value;
+    EXPECT_TRUE(recovered.Get("key1", &value));
+    EXPECT_EQ(value, "value1_updated");
+}
+
+TEST_F(WriteAheadLogTest, GroupCommitFromConcurrentWriters) {
+    const int num_threads = 8;
+    const int num_ops = 200;
+    {
+        Options options;
+        options.wal_sync_mode = WalSyncMode::kEveryWrite;
+        LSMTree tree(test_dir_, options);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&tree, t, num_ops]() {
+                for (int i = 0; i < num_ops; ++i) {
+                    std::string suffix = std::to_string(t) + "_" + std::to_string(i);
+                    EXPECT_TRUE(tree.Put("key" + suffix, "value" + suffix));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    LSMTree recovered(test_dir_, 64 * 1024 * 1024);
+    for (int t = 0; t < num_threads; ++t) {
+        for (int i = 0; i < num_ops; ++i) {
+            std::string suffix = std::to_string(t) + "_" + std::to_string(i);
+            std::string value;
+            EXPECT_TRUE(recovered.Get("key" + suffix, &value));
+            EXPECT_EQ(value, "value" + suffix);
+        }
+    }
+}
+
+TEST_F(WriteAheadLogTest, WriteBatchIsOneRecord) {
+    {
+        LSMTree tree(test_dir_, 64 * 1024 * 1024);
+        WriteBatch batch;
+        for (int i = 0; i < 500; ++i) {
+            batch.Put("key" + std::to_string(i), "value");
+        }
+        EXPECT_TRUE(tree.Write(batch));
+    }
+
+    size_t num_records = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(test_dir_)) {
+        if (entry.path().extension() == ".log") {
+            num_records += WriteAheadLog::Replay(entry.path().string(),
+                                                 [](const std::string&) {});
+        }
+    }
+    EXPECT_EQ(num_records, 1);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
\ No newline at end of file